@@ -0,0 +1,104 @@
+/// Benchmark of batched vs. single Path Cache updates
+///
+/// Creates a hash map with the key and value layout of the Path Cache and
+/// fills it once element by element, once with a single BPF_MAP_UPDATE_BATCH
+/// and once in batches of the size PathService::flush() typically sees after
+/// a ring buffer poll. Requires CAP_BPF (or root).
+///
+/// Usage: bench_batch_update [entries...]
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <endian.h>
+#include <functional>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "bpf.h"
+#include "libbpf.h"
+
+#include "bpf/scion_types.h"
+#include "bpf/scion.h"
+
+// Number of runs per measurement, the fastest one is reported
+static constexpr int RUNS = 5;
+
+// Requests drained by a single ring buffer poll under load
+static constexpr std::size_t POLL_BATCH = 256;
+
+static int createMap(std::size_t entries)
+{
+	int fd = bpf_map_create(BPF_MAP_TYPE_HASH, "bench_paths", sizeof(scion_addr),
+		sizeof(struct path_map_entry), entries, nullptr);
+	if (fd < 0) {
+		std::fprintf(stderr, "Could not create map: %s\n", strerror(errno));
+		std::exit(1);
+	}
+	return fd;
+}
+
+/// Time `fill` on a fresh map, returns the best run in ns per entry
+static double measure(std::size_t entries, const std::function<void(int)> &fill)
+{
+	double best = 0;
+	for (int run = 0; run < RUNS; ++run) {
+		int fd = createMap(entries);
+		auto start = std::chrono::steady_clock::now();
+		fill(fd);
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		close(fd);
+
+		double ns = std::chrono::duration<double, std::nano>(elapsed).count() / entries;
+		if (run == 0 || ns < best)
+			best = ns;
+	}
+	return best;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::size_t> sizes = { 4096, 65536 };
+	if (argc > 1) {
+		sizes.clear();
+		for (int i = 1; i < argc; ++i)
+			sizes.push_back(std::stoul(argv[i]));
+	}
+
+	std::printf("%8s %14s %14s %14s\n", "entries", "single ns/op", "batch ns/op", "256-batch ns/op");
+	for (auto entries : sizes) {
+		std::vector<scion_addr> keys(entries);
+		std::vector<struct path_map_entry> values(entries);
+		for (std::size_t i = 0; i < entries; ++i) {
+			keys[i] = { .ia = (1ull << 48) | i, .subnet = 0, .rsv = 0 };
+			values[i].header.dst.dst = htobe64(keys[i].ia);
+			values[i].path_len = 9; // path meta, one info field, two hop fields
+			values[i].router_port = 30042;
+		}
+
+		auto single = measure(entries, [&](int fd) {
+			for (std::size_t i = 0; i < entries; ++i)
+				bpf_map_update_elem(fd, &keys[i], &values[i], BPF_ANY);
+		});
+
+		auto batch = [&](int fd, std::size_t size) {
+			LIBBPF_OPTS(bpf_map_batch_opts, opts, .elem_flags = BPF_ANY);
+			for (std::size_t i = 0; i < entries; i += size) {
+				__u32 count = std::min(size, entries - i);
+				if (bpf_map_update_batch(fd, &keys[i], &values[i], &count, &opts) < 0) {
+					std::fprintf(stderr, "Batch update failed: %s\n", strerror(errno));
+					std::exit(1);
+				}
+			}
+		};
+		auto full = measure(entries, [&](int fd) { batch(fd, entries); });
+		auto polled = measure(entries, [&](int fd) { batch(fd, POLL_BATCH); });
+
+		std::printf("%8zu %14.0f %14.0f %14.0f\n", entries, single, full, polled);
+	}
+	return 0;
+}
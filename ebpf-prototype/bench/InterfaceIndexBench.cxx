@@ -0,0 +1,124 @@
+/// Benchmark of the interface index used to react to interface failures
+///
+/// Builds the candidate paths of many destinations through a synthetic
+/// topology and compares finding the destinations affected by a failed
+/// interface with InterfaceIndex::lookup() against scanning all candidates,
+/// which is what PathService::onInterfaceDown() would have to do without the
+/// index. Runs without privileges.
+///
+/// Usage: bench_interface_index [destinations...]
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Address.hxx"
+#include "InterfaceIndex.hxx"
+
+// Number of runs per measurement, the fastest one is reported
+static constexpr int RUNS = 5;
+
+// Candidate paths per destination, as returned by a typical path lookup
+static constexpr unsigned PATHS = 3;
+// Core ASes and interfaces per core AS of the synthetic topology
+static constexpr unsigned CORE_ASES = 50;
+static constexpr unsigned CORE_IFS = 40;
+// Failed interfaces looked up per run
+static constexpr unsigned FAILURES = 100;
+
+static constexpr std::uint64_t LOCAL_IA = 0x0001'ff00'0000'0001;
+
+/// Time `fn` RUNS times, returns the best run in ns
+template <typename Fn>
+static double measure(Fn &&fn)
+{
+	double best = 0;
+	for (int run = 0; run < RUNS; ++run) {
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+		if (run == 0 || ns < best)
+			best = ns;
+	}
+	return best;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::size_t> sizes = { 10'000, 100'000 };
+	if (argc > 1) {
+		sizes.clear();
+		for (int i = 1; i < argc; ++i)
+			sizes.push_back(std::stoul(argv[i]));
+	}
+
+	std::printf("%8s %14s %14s %14s %10s\n", "dsts", "add ns/dst", "lookup ns/op", "scan ns/op", "affected");
+	for (auto count : sizes) {
+		// Up to the local core, across two core ASes, down to the destination
+		std::mt19937_64 rng(42);
+		std::uniform_int_distribution<unsigned> core(0, CORE_ASES - 1), coreIf(1, CORE_IFS);
+		auto coreIa = [](unsigned i) { return 0x0002'ff00'0000'0000ull | i; };
+
+		std::unordered_map<scion_addr, PathInfoVec> candidates;
+		for (std::size_t i = 0; i < count; ++i) {
+			auto dst = toScionAddr(0x0003'0000'0000'0000ull | i);
+			auto &paths = candidates[dst];
+			for (unsigned p = 0; p < PATHS; ++p) {
+				PathInfo path;
+				path.src = LOCAL_IA;
+				path.dst = dst.ia;
+				auto c1 = coreIa(core(rng)), c2 = coreIa(core(rng));
+				path.interfaces = { { LOCAL_IA, 1 + p }, { c1, coreIf(rng) }, { c1, coreIf(rng) },
+					{ c2, coreIf(rng) }, { c2, coreIf(rng) }, { dst.ia, 1 } };
+				paths.push_back(std::move(path));
+			}
+		}
+
+		InterfaceIndex index;
+		auto add = measure([&] {
+			index = InterfaceIndex();
+			for (const auto &[dst, paths] : candidates) {
+				for (const auto &path : paths)
+					index.add(dst, path);
+			}
+		});
+
+		std::vector<std::pair<std::uint64_t, std::uint64_t>> failures;
+		for (unsigned i = 0; i < FAILURES; ++i)
+			failures.emplace_back(coreIa(core(rng)), coreIf(rng));
+
+		// Both variants check the candidates of each destination found, like onInterfaceDown()
+		std::size_t affected = 0;
+		auto lookup = measure([&] {
+			affected = 0;
+			for (auto [ia, ifid] : failures) {
+				for (auto dst : index.lookup(ia, ifid)) {
+					for (const auto &path : candidates[dst])
+						affected += InterfaceIndex::traverses(path, ia, ifid);
+				}
+			}
+		});
+		std::size_t scanned = 0;
+		auto scan = measure([&] {
+			scanned = 0;
+			for (auto [ia, ifid] : failures) {
+				for (const auto &[dst, paths] : candidates) {
+					for (const auto &path : paths)
+						scanned += InterfaceIndex::traverses(path, ia, ifid);
+				}
+			}
+		});
+		if (affected != scanned) {
+			std::fprintf(stderr, "Index found %zu paths, scan %zu\n", affected, scanned);
+			return 1;
+		}
+
+		std::printf("%8zu %14.0f %14.0f %14.0f %10zu\n", count, add / count, lookup / FAILURES, scan / FAILURES,
+			affected / FAILURES);
+	}
+	return 0;
+}
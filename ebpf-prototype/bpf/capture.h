@@ -0,0 +1,67 @@
+#ifndef CAPTURE_H_GUARD
+#define CAPTURE_H_GUARD
+
+#include <linux/bpf.h>
+#include <linux/types.h>
+#include <bpf/bpf_helpers.h>
+
+#include "scion.h"
+
+// Packet sampling shared by the ingress and egress programs, see capture_record.
+// Each program only provides capture_packet(), which copies the packet from
+// its own context type.
+
+/// Sample one in capture_rate translated packets, 0 disables sampling
+/// Written by the loader at runtime through the memory-mapped .bss section.
+volatile __u32 capture_rate = 0;
+
+/// Sampled packets before and after translation
+/// Written to a pcapng file by the loader.
+struct {
+	__uint(type, BPF_MAP_TYPE_RINGBUF);
+	__uint(max_entries, CAPTURE_RING_SIZE);
+} capture SEC(".maps");
+
+/// Decide whether to capture the current packet
+///
+/// Returns the capture ID of the packet, 0 if it is not sampled.
+static inline __u32 capture_sample(void)
+{
+	__u32 rate = capture_rate, id;
+
+	if (!rate)
+		return 0;
+	id = bpf_get_prandom_u32();
+	if (id % rate)
+		return 0;
+	return id | 1;
+}
+
+/// Reserve a record for a packet of `len` bytes and fill in everything but the data
+///
+/// caplen: set to the number of bytes to copy into the record, at most CAPTURE_SNAPLEN
+/// Returns NULL if nothing is to be captured or the ring buffer is full.
+static inline struct capture_record *capture_reserve(__u32 id, enum capture_point point, __u32 len,
+	__u32 *caplen)
+{
+	struct capture_record *record;
+
+	*caplen = len > CAPTURE_SNAPLEN ? CAPTURE_SNAPLEN : len;
+	if (*caplen == 0)
+		return NULL;
+
+	record = bpf_ringbuf_reserve(&capture, sizeof(*record), 0);
+	if (!record)
+		return NULL;
+	record->timestamp = bpf_ktime_get_ns();
+	record->id = id;
+	record->cpu = bpf_get_smp_processor_id();
+	record->len = len;
+	record->point = point;
+	return record;
+}
+
+/// Bounds of a copy of `caplen` bytes the verifier accepts, caplen must be non-zero
+#define CAPTURE_COPY_LEN(caplen) ((((caplen)-1) & (CAPTURE_SNAPLEN - 1)) + 1)
+
+#endif // CAPTURE_H_GUARD
@@ -11,11 +11,31 @@ typedef __u32 __wsum;
 #include <bpf/bpf_helpers.h>
 #include <linux/udp.h>
 
+#include "capture.h"
 #include "common.h"
+#include "police.h"
 #include "scion.h"
 
 #define PATH_ENTRIES 4096
 
+/// Length of the subnet ID in SCION-mapped addresses, 0 to key the maps by ISD-AS only
+/// Set by the loader.
+const volatile __u32 subnet_bits = 0;
+
+/// Whether addresses outside of fc00::/8 are looked up in addr_map
+/// Set by the loader if it was given an address map, the lookup is compiled out otherwise.
+const volatile __u8 use_addr_map = 0;
+
+/// SCION addresses of IPv6 prefixes that cannot be SCION-mapped, e.g. ASes with 48-bit ASNs
+/// Filled by the userspace daemon from the address map file.
+struct {
+	__uint(type, BPF_MAP_TYPE_LPM_TRIE);
+	__type(key, struct addr_map_key);
+	__type(value, struct addr_map_entry);
+	__uint(max_entries, ADDR_MAP_ENTRIES);
+	__uint(map_flags, BPF_F_NO_PREALLOC);
+} addr_map SEC(".maps");
+
 /// Map with paths cache
 /// Filled by the userspace daemon with preferred paths
 /// for given destination ISD-AS addresses.
@@ -26,6 +46,38 @@ struct {
 	__uint(max_entries, PATH_ENTRIES);
 } path_map SEC(".maps");
 
+/// Destinations known to be unreachable
+/// Filled by the userspace daemon when a lookup returned no paths.
+/// While an entry is valid, packets are dropped without requesting a path.
+struct {
+	__uint(type, BPF_MAP_TYPE_LRU_HASH);
+	__type(key, scion_addr);
+	__type(value, struct negative_entry);
+	__uint(max_entries, PATH_ENTRIES);
+} neg_map SEC(".maps");
+
+/// Reversed paths of inbound packets per source AS
+/// Filled by the ingress program, the map is shared by the loader.
+/// Used if the Path Cache has no entry, so that replies need not wait for the daemon.
+struct {
+	__uint(type, BPF_MAP_TYPE_LRU_HASH);
+	__type(key, scion_addr);
+	__type(value, struct reply_path);
+	__uint(max_entries, REPLY_ENTRIES);
+} reply_map SEC(".maps");
+
+// Reply paths not refreshed by inbound traffic for this long are not used anymore
+#define REPLY_PATH_TTL (30 * 1000 * 1000 * 1000ull)
+
+/// Usage statistics of the cached paths
+/// Read in bulk by the userspace daemon to decide which destinations are hot.
+struct {
+	__uint(type, BPF_MAP_TYPE_LRU_PERCPU_HASH);
+	__type(key, scion_addr);
+	__type(value, struct path_stats);
+	__uint(max_entries, PATH_ENTRIES);
+} path_stats SEC(".maps");
+
 struct {
 	__uint(type, BPF_MAP_TYPE_RINGBUF);
 	__uint(max_entries, 1024 * sizeof(scion_addr));
@@ -79,6 +131,120 @@ static inline __u32 write_host_addr(void *buf, struct in6_addr *daddr, struct in
 	return 2 * sizeof(struct in6_addr);
 }
 
+/// Rate limits of the policed destinations, split into per-CPU shares
+/// Filled by the userspace daemon, which moves unused shares to the CPUs that need them.
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+	__type(key, scion_addr);
+	__type(value, struct police_share);
+	__uint(max_entries, POLICE_ENTRIES);
+} police_cfg SEC(".maps");
+
+/// Per-CPU token buckets of the policed destinations
+/// Only written by this program, read by the userspace daemon for reconciliation.
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+	__type(key, scion_addr);
+	__type(value, struct police_bucket);
+	__uint(max_entries, POLICE_ENTRIES);
+} police_state SEC(".maps");
+
+/// Whether destinations are rate limited according to police_cfg
+/// Set by the loader, the policer is compiled out otherwise.
+const volatile __u8 use_policing = 0;
+
+/// Number of dropped packets per reason
+/// Read by the userspace daemon.
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__type(key, __u32);
+	__type(value, __u64);
+	__uint(max_entries, DROP_REASONS);
+} drop_stats SEC(".maps");
+
+/// Count a dropped packet
+///
+/// Returns TC_ACT_SHOT
+static inline int drop(enum drop_reason reason)
+{
+	__u32 key = reason;
+	__u64 *count = bpf_map_lookup_elem(&drop_stats, &key);
+	if (count)
+		(*count)++; // Per-CPU map, no atomics required
+	return TC_ACT_SHOT;
+}
+
+/// Take `len` bytes from the token bucket of the destination on this CPU
+///
+/// Returns 0 if the packet conforms to the rate limit or the destination is not policed.
+static inline int police(scion_addr *dst, __u32 len)
+{
+	struct police_share *share;
+	struct police_bucket *bucket;
+
+	if (!use_policing)
+		return 0;
+	share = bpf_map_lookup_elem(&police_cfg, dst);
+	if (!share)
+		return 0;
+
+	bucket = bpf_map_lookup_elem(&police_state, dst);
+	if (!bucket) {
+		// Starts with a full bucket, as the last refill is long ago
+		struct police_bucket init = {};
+		bpf_map_update_elem(&police_state, dst, &init, BPF_NOEXIST);
+		bucket = bpf_map_lookup_elem(&police_state, dst);
+		if (!bucket)
+			return 0;
+	}
+
+	// Per-CPU map, no atomics required
+	return police_take(bucket, share, bpf_ktime_get_ns(), len);
+}
+
+/// Push the start of the packet to the capture ring buffer
+static inline void capture_packet(struct __sk_buff *ctx, __u32 id, enum capture_point point)
+{
+	struct capture_record *record;
+	__u32 caplen;
+
+	record = capture_reserve(id, point, ctx->len, &caplen);
+	if (!record)
+		return;
+	// Loaded in one go, the mask only convinces the verifier of the bounds
+	if (bpf_skb_load_bytes(ctx, 0, record->data, CAPTURE_COPY_LEN(caplen)) < 0)
+		caplen = 0;
+	record->caplen = caplen;
+	bpf_ringbuf_submit(record, 0);
+}
+
+/// Look up the SCION address of an IPv6 address in the address map
+///
+/// Returns NULL if the address map is disabled or has no matching prefix.
+static inline struct addr_map_entry *lookup_addr_map(const struct in6_addr *addr)
+{
+	struct addr_map_key key = { .prefixlen = 128 };
+
+	if (!use_addr_map)
+		return NULL;
+	__builtin_memcpy(&key.addr, addr, sizeof(key.addr));
+	return bpf_map_lookup_elem(&addr_map, &key);
+}
+
+/// Account a packet sent to the given destination in the path statistics
+static inline void count_path_hit(scion_addr *dst, __u32 len)
+{
+	struct path_stats *stats = bpf_map_lookup_elem(&path_stats, dst);
+	if (stats) {
+		// Per-CPU map, no atomics required
+		stats->packets++;
+		stats->bytes += len;
+	} else {
+		struct path_stats init = { .packets = 1, .bytes = len };
+		bpf_map_update_elem(&path_stats, dst, &init, BPF_NOEXIST);
+	}
+}
+
 static inline int adjust_eth(struct __sk_buff *ctx, struct ethhdr *eth, struct ipv6hdr *iph) {
 //  struct bpf_fib_lookup fib_params;
 //  struct in6_addr *src = (struct in6_addr *)fib_params.ipv6_src;
@@ -114,10 +280,11 @@ static inline int adjust_eth(struct __sk_buff *ctx, struct ethhdr *eth, struct i
 SEC("tc/egress")
 int scion_egress(struct __sk_buff *ctx)
 {
-	scion_addr dst, src;
+	scion_addr dst;
+	__u64 dst_ia, src_ia;
   __u16 src_port;
 	__u32 netdev_mtu_len = 0;
-	__u32 new_hdrs_size, scion_header_len;
+	__u32 new_hdrs_size, scion_header_len, capture_id;
 
 	void *data = (void *)(long)ctx->data;
 	void *data_end = (void *)(long)ctx->data_end;
@@ -129,6 +296,8 @@ int scion_egress(struct __sk_buff *ctx)
 	struct scionhdr *sci_hdr = (struct scionhdr *)(udp_hdr + 1);
 
 	struct path_map_entry *path;
+	struct addr_map_entry *mapped = NULL, *src_mapped;
+	struct in6_addr *dst_host;
 
 	// Packet is too small for Ethernet, just forward.
 	if ((void *)(eth_hdr + 1) > data_end)
@@ -147,18 +316,28 @@ int scion_egress(struct __sk_buff *ctx)
   }
 
   //bpf_printk("check prefix");
-	// IP destination address is not in SCION range, just forward.
-	if (!scion_prefix_match(&ip6_hdr->daddr)) {
-		return TC_ACT_OK;
-  }
-
+	// IP destination address is not in SCION range and has no mapping, just forward.
+	if (scion_prefix_match(&ip6_hdr->daddr)) {
+		dst_ia = get_scion_ia(&ip6_hdr->daddr);
+		dst = get_map_key(&ip6_hdr->daddr, subnet_bits);
+	} else {
+		mapped = lookup_addr_map(&ip6_hdr->daddr);
+		if (!mapped)
+			return TC_ACT_OK;
+		dst_ia = mapped->ia;
+		dst = (scion_addr){ .ia = mapped->ia };
+	}
 
-	dst = get_scion_addr(&ip6_hdr->daddr);
-  src = get_scion_addr(&ip6_hdr->saddr);
+	if (scion_prefix_match(&ip6_hdr->saddr))
+		src_ia = get_scion_ia(&ip6_hdr->saddr);
+	else if ((src_mapped = lookup_addr_map(&ip6_hdr->saddr)))
+		src_ia = src_mapped->ia;
+	else
+		src_ia = 0;
 
   //bpf_printk("check intra as");
   // Do not translate intra-AS traffic
-  if (dst == src) {
+  if (dst_ia == src_ia) {
     return TC_ACT_OK;
   }
 
@@ -178,8 +357,6 @@ int scion_egress(struct __sk_buff *ctx)
     // TODO tail call to regular IPv6 translation
   }
 
-  dst = get_map_key(&ip6_hdr->daddr);
-
   //bpf_printk("lookup path");
 	// Lookup path information for given SCION ISD-AS.
 	path = bpf_map_lookup_elem(&path_map, &dst);
@@ -190,15 +367,29 @@ int scion_egress(struct __sk_buff *ctx)
 	// and instead have to either circulate the packet through the netwock stack
 	// or send the packet to userspace and re-send it once the cache is filled.
 	if (!path) {
-		// TODO in order to implement the recirculation
-		// another map counting some kind of TTL might be sensible
-		bpf_ringbuf_output(&path_req, &dst, sizeof(dst), 0);
-    // TODO do not use recirculation but user space buffering
-		//return bpf_redirect(ctx->ifindex, 0);
-    return TC_ACT_SHOT;
+		__u64 now = bpf_ktime_get_ns();
+
+		// Do not ask again for destinations the daemon just had no path for
+		struct negative_entry *neg = bpf_map_lookup_elem(&neg_map, &dst);
+		if (!neg || now >= neg->expires) {
+			// TODO in order to implement the recirculation
+			// another map counting some kind of TTL might be sensible
+			bpf_ringbuf_output(&path_req, &dst, sizeof(dst), 0);
+		}
+
+		// Answer the remote side on the path its packets took until the daemon installed one
+		struct reply_path *reply = bpf_map_lookup_elem(&reply_map, &dst);
+		if (!reply || now - reply->updated > REPLY_PATH_TTL) {
+			// TODO do not use recirculation but user space buffering
+			//return bpf_redirect(ctx->ifindex, 0);
+			return drop(DROP_NO_PATH);
+		}
+		path = &reply->entry;
 	}
   // TODO implement way to check wether no path available or not cached
 
+	count_path_hit(&dst, ctx->len);
+
   //bpf_printk("Path found");
 
 	scion_header_len = 4 * path->header.len;
@@ -206,15 +397,23 @@ int scion_egress(struct __sk_buff *ctx)
 	// We insert a UDP header and the SCION headers
 	new_hdrs_size = sizeof(struct udphdr) + scion_header_len;
 
+	// Rate limits apply to the translated packet as it goes on the wire
+	if (police(&dst, ctx->len + new_hdrs_size))
+		return drop(DROP_POLICED);
+
+	capture_id = capture_sample();
+	if (capture_id)
+		capture_packet(ctx, capture_id, CAPTURE_EGRESS_BEFORE);
+
 	// Check if we can fit the additional header into the packet
 	if (bpf_check_mtu(ctx, 0, &netdev_mtu_len, -new_hdrs_size, 0)) {
 		bpf_printk("MTU check failed");
-		return TC_ACT_SHOT;
+		return drop(DROP_MTU);
 	}
 	// Adjust sk_buffer space so that we can include the SCION header.
 	if (bpf_skb_adjust_room(ctx, new_hdrs_size, BPF_ADJ_ROOM_NET, 0) < 0) {
 		bpf_printk("could not increase packet data size");
-		return TC_ACT_SHOT;
+		return drop(DROP_NO_ROOM);
 	}
 
   //bpf_printk("Packet size adjusted");
@@ -230,16 +429,16 @@ int scion_egress(struct __sk_buff *ctx)
 
 	if ((void *)sci_hdr + scion_header_len > data_end) {
 		bpf_printk("packet is too small for new headers");
-		return TC_ACT_SHOT;
+		return drop(DROP_MALFORMED);
 	}
 
 	if (((void *)(eth_hdr + 1) > data_end))
-		return TC_ACT_SHOT;
+		return drop(DROP_MALFORMED);
 	if (((void *)(ip6_hdr + 1) > data_end))
-		return TC_ACT_SHOT;
+		return drop(DROP_MALFORMED);
 
 	if (((void *)(sci_hdr + 1) > data_end))
-		return TC_ACT_SHOT;
+		return drop(DROP_MALFORMED);
 
   //bpf_printk("Copy path");
 
@@ -254,8 +453,10 @@ int scion_egress(struct __sk_buff *ctx)
 	sci_end += write_scionhdr(sci_hdr, &path->header, ip6_hdr);
 
 	if (((void *)sci_end + 2 * sizeof(struct in6_addr) > data_end))
-		return TC_ACT_SHOT;
-	sci_end += write_host_addr(sci_end, &ip6_hdr->daddr, &ip6_hdr->saddr);
+		return drop(DROP_MALFORMED);
+	// Map values stay valid across bpf_skb_adjust_room, unlike packet pointers
+	dst_host = mapped && !ipv6_unspecified(&mapped->host) ? &mapped->host : &ip6_hdr->daddr;
+	sci_end += write_host_addr(sci_end, dst_host, &ip6_hdr->saddr);
 
 	// This should copy the path from the map to the packet.
 	__u32 *to = (__u32 *)sci_end;
@@ -285,6 +486,8 @@ int scion_egress(struct __sk_buff *ctx)
 
 
   //bpf_printk("Finished packet rewriting");
+	if (capture_id)
+		capture_packet(ctx, capture_id, CAPTURE_EGRESS_AFTER);
 	return adjust_eth(ctx, eth_hdr, ip6_hdr);
 }
 
@@ -5,10 +5,225 @@
 #include <linux/udp.h>
 #include <bpf/bpf_helpers.h>
 
+#include "capture.h"
 #include "common.h"
 #include "scion.h"
 #include "scion_types.h"
 
+/// Length of the subnet ID in SCION-mapped addresses, 0 to key the maps by ISD-AS only
+/// Set by the loader.
+const volatile __u32 subnet_bits = 0;
+
+/// Underlay addresses of the border routers of the local AS
+/// Filled by the loader. SCMP messages are neither authenticated nor is their
+/// source verified by the border router, and a recorded reply path redirects
+/// traffic to the router it came from. Both are only taken from packets
+/// forwarded by one of these routers. This relies on the local network not
+/// allowing hosts to spoof the routers' addresses.
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__type(key, struct in6_addr);
+	__type(value, __u8);
+	__uint(max_entries, TRUSTED_ROUTERS);
+} trusted_routers SEC(".maps");
+
+/// IPv6 addresses of the hosts mapped to an explicit SCION host address
+/// Filled by the loader from the address map of the egress program. Replies
+/// of such hosts carry their SCION host address, which is translated back so
+/// that they reach the socket connected to the mapped address.
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__type(key, struct addr_rmap_key);
+	__type(value, struct in6_addr);
+	__uint(max_entries, ADDR_MAP_ENTRIES);
+} addr_rmap SEC(".maps");
+
+/// Interface failures reported by SCMP messages
+/// Consumed by the userspace daemon to move traffic off the affected paths.
+struct {
+	__uint(type, BPF_MAP_TYPE_RINGBUF);
+	__uint(max_entries, 256 * sizeof(struct scmp_event));
+} scmp_events SEC(".maps");
+
+/// Reversed paths of inbound packets per source AS
+/// Shared with the egress program, which uses them if no path is cached.
+struct {
+	__uint(type, BPF_MAP_TYPE_LRU_HASH);
+	__type(key, scion_addr);
+	__type(value, struct reply_path);
+	__uint(max_entries, REPLY_ENTRIES);
+} reply_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__type(key, __u32);
+	__type(value, struct reply_scratch);
+	__uint(max_entries, 1);
+} reply_scratch SEC(".maps");
+
+// Minimum time between two updates of the reply path of the same source AS
+#define REPLY_PATH_INTERVAL (1000 * 1000 * 1000ull)
+
+/// Copy `len` bytes within the scratch buffer, offsets are clamped for the verifier
+#define SCRATCH_COPY(dst, dst_off, src, src_off, len) \
+	do { \
+		__u32 _d = (dst_off) & 1023, _s = (src_off) & 1023; \
+		if (_d + (len) > sizeof(dst) || _s + (len) > sizeof(src)) \
+			return; \
+		__builtin_memcpy((__u8 *)(dst) + _d, (__u8 *)(src) + _s, (len)); \
+	} while (0)
+
+/// Record the reverse of the path of an inbound packet as reply path to its source AS
+///
+/// Follows the reversal of standard SCION paths: info and hop fields are
+/// reversed, the construction direction of each segment is flipped, and the
+/// current info and hop field are reset.
+///
+/// ctx: XDP context
+/// ip_hdr: underlay IPv6 header, still containing the address of the trusted border router
+/// udp_hdr: underlay UDP header
+/// sci_hdr: SCION header, including the host addresses already checked to be within the packet
+static inline void record_reply_path(struct xdp_md *ctx, struct ipv6hdr *ip_hdr, struct udphdr *udp_hdr,
+	struct scionhdr *sci_hdr)
+{
+	__u32 zero = 0, path_off, path_len, meta, num_inf = 0, num_hops, seg[3], i;
+	struct reply_scratch *scratch;
+	struct reply_path *current;
+	scion_addr key = {};
+	__u8 *out;
+	__u64 now;
+
+	if (sci_hdr->type != SC_PATH_TYPE_SCION || sci_hdr->haddr != 0x33)
+		return;
+	if (sci_hdr->src.src == sci_hdr->dst.dst)
+		return;
+	// Same key the egress program derives from the mapped address of the sender
+	key.ia = bpf_be64_to_cpu(sci_hdr->src.src);
+	// Hosts outside of fc00::/8 can only be reached through the address map, which has no subnets
+	if (scion_prefix_match((void *)(sci_hdr + 1) + sizeof(struct in6_addr)))
+		key.subnet = scion_mapping_subnet(ipv6_hi((void *)(sci_hdr + 1) + sizeof(struct in6_addr)),
+			subnet_bits);
+	key.rsv = 0;
+
+	// Rate limit updates, a flow keeps using the same path most of the time
+	now = bpf_ktime_get_ns();
+	current = bpf_map_lookup_elem(&reply_map, &key);
+	if (current && now - current->updated < REPLY_PATH_INTERVAL)
+		return;
+
+	scratch = bpf_map_lookup_elem(&reply_scratch, &zero);
+	if (!scratch)
+		return;
+
+	path_off = sizeof(struct ethhdr) + sizeof(struct ipv6hdr) + sizeof(struct udphdr) + sizeof(struct scionhdr)
+		+ 2 * sizeof(struct in6_addr);
+	path_len = 4 * (__u32)sci_hdr->len - sizeof(struct scionhdr) - 2 * sizeof(struct in6_addr);
+	if (path_len < 4 || path_len > SC_PATH_MAX_LEN)
+		return;
+	if (bpf_xdp_load_bytes(ctx, path_off, scratch->raw, path_len) < 0)
+		return;
+
+	meta = bpf_ntohl(*(__u32 *)scratch->raw);
+	seg[0] = PATH_GET_SEG0_HOST(meta);
+	seg[1] = PATH_GET_SEG1_HOST(meta);
+	seg[2] = PATH_GET_SEG2_HOST(meta);
+	num_hops = seg[0] + seg[1] + seg[2];
+	if (seg[0])
+		num_inf = seg[1] ? (seg[2] ? 3 : 2) : 1;
+	if (num_inf == 0 || num_hops > SC_PATH_MAX_HOPS || path_len != 4 + 8 * num_inf + 12 * num_hops)
+		return;
+
+	out = (__u8 *)scratch->reply.entry.path;
+
+	// Segment lengths in reverse order, current info and hop field reset to the start
+	meta = 0;
+	if (num_inf == 1)
+		PATH_SET_SEG0_HOST(meta, seg[0]);
+	else if (num_inf == 2) {
+		PATH_SET_SEG0_HOST(meta, seg[1]);
+		PATH_SET_SEG1_HOST(meta, seg[0]);
+	} else {
+		PATH_SET_SEG0_HOST(meta, seg[2]);
+		PATH_SET_SEG1_HOST(meta, seg[1]);
+		PATH_SET_SEG2_HOST(meta, seg[0]);
+	}
+	*(__u32 *)out = bpf_htonl(meta);
+
+	for (i = 0; i < 3 && i < num_inf; i++) {
+		SCRATCH_COPY(scratch->reply.entry.path, 4 + 8 * i, scratch->raw, 4 + 8 * (num_inf - 1 - i), 8);
+		out[4 + 8 * i] ^= 0x01; // flip construction direction
+	}
+
+	for (i = 0; i < SC_PATH_MAX_HOPS && i < num_hops; i++)
+		SCRATCH_COPY(scratch->reply.entry.path, 4 + 8 * num_inf + 12 * i,
+			scratch->raw, 4 + 8 * num_inf + 12 * (num_hops - 1 - i), 12);
+
+	// Addresses are swapped, the egress program fills in the remaining fields
+	scratch->reply.entry.header = (struct scionhdr){
+		.len = sci_hdr->len,
+		.type = SC_PATH_TYPE_SCION,
+		.haddr = 0x33,
+		.dst = { .dst = sci_hdr->src.src },
+		.src = { .src = sci_hdr->dst.dst },
+	};
+	scratch->reply.entry.path_len = path_len / 4;
+
+	// Replies are sent back to the border router the packet came from
+	__builtin_memcpy(scratch->reply.entry.router_addr, &ip_hdr->saddr, sizeof(ip_hdr->saddr));
+	scratch->reply.entry.router_port = bpf_ntohs(udp_hdr->source);
+	scratch->reply.updated = now;
+
+	bpf_map_update_elem(&reply_map, &key, &scratch->reply, BPF_ANY);
+}
+
+/// Push the start of the packet to the capture ring buffer
+static inline void capture_packet(struct xdp_md *ctx, __u32 id, enum capture_point point)
+{
+	struct capture_record *record;
+	__u32 caplen;
+
+	record = capture_reserve(id, point, ctx->data_end - ctx->data, &caplen);
+	if (!record)
+		return;
+	// Loaded in one go, the mask only convinces the verifier of the bounds
+	if (bpf_xdp_load_bytes(ctx, 0, record->data, CAPTURE_COPY_LEN(caplen)) < 0)
+		caplen = 0;
+	record->caplen = caplen;
+	bpf_ringbuf_submit(record, 0);
+}
+
+/// Forward SCMP interface down messages to userspace
+///
+/// sci_hdr: SCION header of a packet carrying SCMP
+/// data_end: end of the packet
+static inline void report_scmp(struct scionhdr *sci_hdr, void *data_end)
+{
+	struct scmp_event event = {};
+	struct scmphdr *scmp = (void *)sci_hdr + 4 * (__u32)sci_hdr->len;
+	__u8 *info = (__u8 *)(scmp + 1);
+	__u64 field;
+
+	// ISD-AS and interface are common to both message types
+	if ((void *)(info + 2 * sizeof(__u64)) > data_end)
+		return;
+	if (scmp->type != SCMP_EXT_IF_DOWN && scmp->type != SCMP_INT_CONN_DOWN)
+		return;
+
+	event.type = scmp->type;
+	__builtin_memcpy(&field, info, sizeof(field));
+	event.ia = bpf_be64_to_cpu(field);
+	__builtin_memcpy(&field, info + sizeof(__u64), sizeof(field));
+	event.ingress = bpf_be64_to_cpu(field);
+
+	if (scmp->type == SCMP_INT_CONN_DOWN) {
+		if ((void *)(info + 3 * sizeof(__u64)) > data_end)
+			return;
+		__builtin_memcpy(&field, info + 2 * sizeof(__u64), sizeof(field));
+		event.egress = bpf_be64_to_cpu(field);
+	}
+
+	bpf_ringbuf_output(&scmp_events, &event, sizeof(event), 0);
+}
 
 SEC("xdp")
 int scion_ingress(struct xdp_md *ctx)
@@ -16,7 +231,8 @@ int scion_ingress(struct xdp_md *ctx)
 	void *data = (void *)(long)ctx->data;
 	void *data_end = (void *)(long)ctx->data_end;
 	void *new_start, *scion_end;
-  scion_addr src, dst;
+	__u32 capture_id;
+  __u64 src, dst;
 
 	struct ethhdr *eth_hdr = data;
 	struct ipv6hdr *ip_hdr = (struct ipv6hdr *)(eth_hdr + 1);
@@ -53,8 +269,8 @@ int scion_ingress(struct xdp_md *ctx)
 		return XDP_PASS;
 
 
-	dst = get_scion_addr(&ip_hdr->daddr);
-  src = get_scion_addr(&ip_hdr->saddr);
+	dst = get_scion_ia(&ip_hdr->daddr);
+  src = get_scion_ia(&ip_hdr->saddr);
 
   // Do not translate intra-AS traffic
   //if (dst == src) {
@@ -72,9 +288,33 @@ int scion_ingress(struct xdp_md *ctx)
 	if ((void *)sci_hdr + sizeof(struct scionhdr) + 2 * sizeof(struct in6_addr) > data_end)
 		return XDP_PASS;
 
+	capture_id = capture_sample();
+	if (capture_id)
+		capture_packet(ctx, capture_id, CAPTURE_INGRESS_BEFORE);
+
+	if (bpf_map_lookup_elem(&trusted_routers, &ip_hdr->saddr)) {
+		// Remember how to get back to the sender before the underlay addresses are overwritten
+		record_reply_path(ctx, ip_hdr, udp_hdr, sci_hdr);
+
+		// Let the daemon react to failures on our paths, the message is still delivered
+		if (sci_hdr->next == SC_PROTO_SCMP)
+			report_scmp(sci_hdr, data_end);
+	}
+
 	__builtin_memcpy(&ip_hdr->daddr, (void *)sci_hdr + sizeof(struct scionhdr), sizeof(struct in6_addr));
 	__builtin_memcpy(&ip_hdr->saddr, (void *)sci_hdr + sizeof(struct scionhdr) + sizeof(struct in6_addr), sizeof(struct in6_addr));
 
+	// Sources outside of fc00::/8 may be hosts the egress program maps to an explicit host address
+	if (!scion_prefix_match(&ip_hdr->saddr)) {
+		struct addr_rmap_key rkey = { .ia = bpf_be64_to_cpu(sci_hdr->src.src) };
+		struct in6_addr *mapped;
+
+		rkey.host = ip_hdr->saddr;
+		mapped = bpf_map_lookup_elem(&addr_rmap, &rkey);
+		if (mapped)
+			ip_hdr->saddr = *mapped;
+	}
+
 	// since we remove part of the payload (from the perspective of the IP header)
 	// we have to update some fields, like the L4 type and the actual payload length
 	ip_hdr->nexthdr = sci_hdr->next;
@@ -102,6 +342,9 @@ int scion_ingress(struct xdp_md *ctx)
 		return XDP_DROP;
 	}
 
+	if (capture_id)
+		capture_packet(ctx, capture_id, CAPTURE_INGRESS_AFTER);
+
 	return XDP_PASS;
 }
 
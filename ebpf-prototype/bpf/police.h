@@ -0,0 +1,50 @@
+#ifndef POLICE_H_GUARD
+#define POLICE_H_GUARD
+
+#include <linux/types.h>
+
+#include "scion.h"
+
+// Token buckets of the rate limits, see police_share and police_bucket.
+// Shared by the egress program and the unit tests of the loader, which
+// simulate the per-CPU buckets.
+
+// Never refill more than a second worth of tokens, keeps the multiplication from overflowing
+#define POLICE_MAX_ELAPSED (1000 * 1000 * 1000ull)
+
+/// Refill `bucket` at time `now` (ns) and take `len` bytes from it
+///
+/// Only the time the credited whole tokens took is consumed, the remainder
+/// counts towards the next refill. Otherwise frequent small packets would
+/// lose a fraction of a token each and a low rate could never refill at all.
+/// Returns 0 if the packet conforms to the rate limit.
+static inline int police_take(struct police_bucket *bucket, const struct police_share *share, __u64 now, __u32 len)
+{
+	__u64 elapsed, credit, tokens;
+
+	elapsed = now - bucket->updated;
+	if (elapsed > POLICE_MAX_ELAPSED) {
+		elapsed = POLICE_MAX_ELAPSED;
+		bucket->updated = now - POLICE_MAX_ELAPSED;
+	}
+	credit = elapsed * share->rate / POLICE_MAX_ELAPSED;
+	tokens = bucket->tokens + credit;
+	if (tokens >= share->burst) {
+		// A full bucket discards the remainder anyway
+		tokens = share->burst;
+		bucket->updated = now;
+	} else if (credit) {
+		bucket->updated += credit * POLICE_MAX_ELAPSED / share->rate;
+	}
+	bucket->offered += len;
+
+	if (tokens < len) {
+		bucket->tokens = tokens;
+		bucket->dropped += len;
+		return -1;
+	}
+	bucket->tokens = tokens - len;
+	return 0;
+}
+
+#endif // POLICE_H_GUARD
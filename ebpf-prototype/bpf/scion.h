@@ -5,22 +5,24 @@
 #include <linux/ipv6.h>
 #include <linux/types.h>
 
+#include "scion_mapping.h"
 #include "scion_types.h"
 
-// 8 bit identifying prefix (currently unassigned ULA range fc00::/8)
-// 12 bit ISD
-// 20 bit AS
-// 24 bit local routing and subnet ID
-// 64 bit Host
 #define IST_PREFIX ((__u32)(0xFC << (32 - 8)))
 #define IST_PREFIX_MASK ((__u32)(0xFF << (32 - 8)))
 
-typedef __u32 scion_addr;
-
-#define SADDR_GET_ISD(k) (((k) >> 20) && 0xFFF)
-#define SADDR_GET_AS(k) ((k)&0xFFFFF)
-#define SADDR_SET_ISD(k, v) (k) = ((k) & 0xFFFFF) | (((v)&0xFFF) << 20)
-#define SADDR_SET_AS(k, v) (k) = ((k) & 0xFFF00000) | ((v)&0xFFFFF)
+/// Key of the per-destination maps
+///
+/// Destinations are identified by their full ISD-AS and, if enabled by the
+/// loader, the subnet ID of their SCION-mapped IPv6 address.
+typedef struct scion_addr {
+	// ISD-AS in host byte order
+	__u64 ia;
+	// Subnet ID, 0 unless the keys include the subnet
+	__u32 subnet;
+	// Reserved, must be zero
+	__u32 rsv;
+} scion_addr;
 
 struct path_map_entry {
 	// SCION header information
@@ -39,23 +41,179 @@ struct path_map_entry {
 	__u16 router_port;
 };
 
+// Maximum length of a standard SCION path (path meta, 3 info fields, 64 hop fields)
+#define SC_PATH_MAX_LEN (4 + 3 * 8 + 64 * 12)
+#define SC_PATH_MAX_HOPS 64
+
+// Number of source ASes a reply path is kept for
+#define REPLY_ENTRIES 4096
+
+// Number of border router addresses the ingress program trusts, see trusted_routers
+#define TRUSTED_ROUTERS 256
+
+/// Reversed path of a packet received from a remote AS, see reply_map
+struct reply_path {
+	// Time the path was recorded (CLOCK_MONOTONIC in ns, see bpf_ktime_get_ns)
+	__u64 updated;
+	// Ready to use in place of a Path Cache entry
+	struct path_map_entry entry;
+};
+
+/// Per-CPU scratch space to reverse a path, too large for the BPF stack
+struct reply_scratch {
+	__u8 raw[1024];
+	struct reply_path reply;
+};
+
+/// Negative Path Cache entry for a destination without paths
+struct negative_entry {
+	// Entry is valid until this time (CLOCK_MONOTONIC in ns, see bpf_ktime_get_ns)
+	__u64 expires;
+};
+
+/// Interface failure reported by an SCMP error message, see scmp_events
+struct scmp_event {
+	// ISD-AS reporting the failure
+	__u64 ia;
+	// Interface that is down (type 5) or ingress interface (type 6)
+	__u64 ingress;
+	// Egress interface the connectivity to is lost (type 6), 0 otherwise
+	__u64 egress;
+	// SCMP type, SCMP_EXT_IF_DOWN or SCMP_INT_CONN_DOWN
+	__u8 type;
+};
+
+// Number of prefixes in the address map
+#define ADDR_MAP_ENTRIES 16384
+
+/// Key of the address map, an IPv6 prefix in the format of BPF_MAP_TYPE_LPM_TRIE
+struct addr_map_key {
+	// Prefix length in bits
+	__u32 prefixlen;
+	// Prefix in network order, bits beyond prefixlen are ignored
+	struct in6_addr addr;
+};
+
+/// SCION address of the hosts in a prefix that has no SCION-mapped encoding
+struct addr_map_entry {
+	// ISD-AS in host byte order
+	__u64 ia;
+	// Host address in the SCION address header, the IPv6 address itself if unspecified (::)
+	struct in6_addr host;
+};
+
+/// Key of the reverse address map, the SCION address of a mapped host
+struct addr_rmap_key {
+	// ISD-AS in host byte order
+	__u64 ia;
+	// Host address in the SCION header
+	struct in6_addr host;
+};
+
+// Number of destinations that can be rate limited
+#define POLICE_ENTRIES 1024
+
+/// Share of a CPU in the rate limit of a destination, see police_cfg
+struct police_share {
+	// Token rate in bytes per second
+	__u64 rate;
+	// Bucket size in bytes
+	__u64 burst;
+};
+
+/// Token bucket of a destination on a CPU, see police_state
+struct police_bucket {
+	// Available tokens in bytes
+	__u64 tokens;
+	// Time of the last refill (CLOCK_MONOTONIC in ns, see bpf_ktime_get_ns)
+	__u64 updated;
+	// Bytes offered, including dropped ones, for the reconciliation in userspace
+	__u64 offered;
+	// Bytes dropped
+	__u64 dropped;
+};
+
+/// Reasons the egress program drops packets for, index of drop_stats
+enum drop_reason {
+	DROP_NO_PATH,
+	DROP_POLICED,
+	DROP_MTU,
+	DROP_NO_ROOM,
+	DROP_MALFORMED,
+	DROP_REASONS,
+};
+
+// Number of bytes captured of a sampled packet, must be a power of two
+#define CAPTURE_SNAPLEN 256
+#define CAPTURE_RING_SIZE (256 * 1024)
+
+/// Point a packet was captured at, see capture_record
+enum capture_point {
+	CAPTURE_EGRESS_BEFORE,
+	CAPTURE_EGRESS_AFTER,
+	CAPTURE_INGRESS_BEFORE,
+	CAPTURE_INGRESS_AFTER,
+	CAPTURE_POINTS,
+};
+
+/// Start of a sampled packet before or after translation, see the capture ring buffers
+struct capture_record {
+	// Time of capture (CLOCK_MONOTONIC in ns, see bpf_ktime_get_ns)
+	__u64 timestamp;
+	// Same for the records before and after translation of a packet
+	__u32 id;
+	__u32 cpu;
+	// Length of the packet
+	__u32 len;
+	// Number of valid bytes in data
+	__u32 caplen;
+	// enum capture_point
+	__u8 point;
+	__u8 data[CAPTURE_SNAPLEN];
+};
+
+/// Per-destination usage counters maintained by the egress program
+struct path_stats {
+	__u64 packets;
+	__u64 bytes;
+};
+
 inline int scion_prefix_match(struct in6_addr *addr)
 {
 	return (addr->in6_u.u6_addr8[0] == 0xFC);
 }
 
-inline __u32 get_scion_addr(struct in6_addr *addr) {
-  return (bpf_ntohl(addr->in6_u.u6_addr32[0]) << 8) | (bpf_ntohl(addr->in6_u.u6_addr32[1]) >> 24);
+/// Upper 64 bits of an IPv6 address in host byte order
+static inline __u64 ipv6_hi(const struct in6_addr *addr)
+{
+	return ((__u64)bpf_ntohl(addr->in6_u.u6_addr32[0]) << 32) | bpf_ntohl(addr->in6_u.u6_addr32[1]);
 }
 
-inline scion_addr get_map_key(struct in6_addr *addr)
+/// Whether an IPv6 address is the unspecified address (::)
+static inline int ipv6_unspecified(const struct in6_addr *addr)
 {
-	//scion_addr addr = bpf_ntohl(hdr->daddr.in6_u.u6_addr32[0]) << 8;
-	// See include/uapi/linux/ipv6.h
-	//addr |= hdr->daddr.in6_u.u6_addr8[4] << 8;
-	//addr |= ((hdr->priority & 0xF) << 4) | ((hdr->flow_lbl[0] & 0xF0) >> 4);
+	return !(addr->in6_u.u6_addr32[0] | addr->in6_u.u6_addr32[1] | addr->in6_u.u6_addr32[2]
+		| addr->in6_u.u6_addr32[3]);
+}
 
-	return get_scion_addr(addr);
+/// ISD-AS of a SCION-mapped IPv6 address
+static inline __u64 get_scion_ia(const struct in6_addr *addr)
+{
+	return scion_mapping_ia(ipv6_hi(addr));
+}
+
+/// Map key of a SCION-mapped IPv6 address
+///
+/// subnet_bits: length of the subnet ID, 0 to key by ISD-AS only
+static inline scion_addr get_map_key(const struct in6_addr *addr, __u32 subnet_bits)
+{
+	__u64 hi = ipv6_hi(addr);
+	scion_addr key = {
+		.ia = scion_mapping_ia(hi),
+		.subnet = scion_mapping_subnet(hi, subnet_bits),
+		.rsv = 0,
+	};
+	return key;
 }
 
 #endif
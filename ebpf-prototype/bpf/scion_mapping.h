@@ -0,0 +1,102 @@
+#ifndef SCION_MAPPING_H_GUARD
+#define SCION_MAPPING_H_GUARD
+
+#include <linux/types.h>
+
+// Mapping between SCION and SCION-mapped IPv6 addresses, see scion2ip.
+// Shared by the BPF programs and the userspace loader, so that both always
+// agree on the encoding.
+//
+// 8 bit identifying prefix (currently unassigned ULA range fc00::/8)
+// 12 bit ISD
+// 20 bit encoded ASN
+// 24 - m bit local routing prefix
+// m bit subnet ID
+// 64 bit interface ID
+//
+// ASNs 0 to 2^19-1 are encoded directly, ASNs 2:0:0 to 2:7:ffff are encoded
+// as (1 << 19) | (asn & 0x7ffff).
+
+#ifdef __cplusplus
+#define SCION_MAPPING_FN constexpr
+#else
+#define SCION_MAPPING_FN static inline
+#endif
+
+#define SCION_MAPPING_PREFIX 0xFC
+#define SCION_MAPPING_MAX_SUBNET_BITS 24
+
+#define SCION_MAPPING_ENCODED_FLAG (1u << 19)
+#define SCION_MAPPING_ENCODED_MASK (SCION_MAPPING_ENCODED_FLAG - 1)
+#define SCION_MAPPING_SCION_ASN_BASE 0x200000000ull
+
+// Access the ISD and encoded ASN in the 32 bits following the prefix
+#define SADDR_GET_ISD(k) (((k) >> 20) & 0xFFF)
+#define SADDR_GET_AS(k) ((k)&0xFFFFF)
+#define SADDR_SET_ISD(k, v) (k) = ((k) & 0xFFFFF) | (((v)&0xFFF) << 20)
+#define SADDR_SET_AS(k, v) (k) = ((k) & 0xFFF00000) | ((v)&0xFFFFF)
+
+/// Whether `ia` (host byte order) has a SCION-mapped IPv6 representation
+SCION_MAPPING_FN int scion_mapping_representable(__u64 ia)
+{
+	__u64 isd = ia >> 48, asn = ia & 0xFFFFFFFFFFFFull;
+	if (isd > 0xFFF)
+		return 0;
+	return asn < SCION_MAPPING_ENCODED_FLAG
+		|| (asn & ~(__u64)SCION_MAPPING_ENCODED_MASK) == SCION_MAPPING_SCION_ASN_BASE;
+}
+
+/// Encode `ia` into the 32 bits following the prefix (ISD and encoded ASN)
+///
+/// The result is only meaningful if scion_mapping_representable(ia).
+SCION_MAPPING_FN __u32 scion_mapping_encode(__u64 ia)
+{
+	__u64 isd = ia >> 48, asn = ia & 0xFFFFFFFFFFFFull;
+	__u32 encoded = asn < SCION_MAPPING_ENCODED_FLAG
+		? (__u32)asn
+		: SCION_MAPPING_ENCODED_FLAG | (__u32)(asn & SCION_MAPPING_ENCODED_MASK);
+	return (__u32)((isd & 0xFFF) << 20) | encoded;
+}
+
+/// Decode the ISD-AS (host byte order) from ISD and encoded ASN
+SCION_MAPPING_FN __u64 scion_mapping_decode(__u32 word)
+{
+	__u64 isd = SADDR_GET_ISD(word), asn = SADDR_GET_AS(word);
+	if (asn & SCION_MAPPING_ENCODED_FLAG)
+		asn = SCION_MAPPING_SCION_ASN_BASE | (asn & SCION_MAPPING_ENCODED_MASK);
+	return (isd << 48) | asn;
+}
+
+/// ISD-AS of a SCION-mapped IPv6 address
+///
+/// hi: the upper 64 bits of the address in host byte order
+SCION_MAPPING_FN __u64 scion_mapping_ia(__u64 hi)
+{
+	return scion_mapping_decode((__u32)(hi >> 24));
+}
+
+/// Subnet ID of a SCION-mapped IPv6 address with a subnet ID of `subnet_bits` bits
+///
+/// hi: the upper 64 bits of the address in host byte order
+SCION_MAPPING_FN __u32 scion_mapping_subnet(__u64 hi, __u32 subnet_bits)
+{
+	if (subnet_bits == 0 || subnet_bits > SCION_MAPPING_MAX_SUBNET_BITS)
+		return 0;
+	return (__u32)(hi & ((1u << subnet_bits) - 1));
+}
+
+/// Upper 64 bits (host byte order) of the SCION-mapped IPv6 address of `ia`
+///
+/// The result is only meaningful if scion_mapping_representable(ia) and the
+/// local prefix and subnet fit into 24 bits.
+SCION_MAPPING_FN __u64 scion_mapping_prefix(__u64 ia, __u32 local_prefix, __u32 subnet, __u32 subnet_bits)
+{
+	__u64 hi = ((__u64)SCION_MAPPING_PREFIX << 56) | ((__u64)scion_mapping_encode(ia) << 24);
+	if (subnet_bits > SCION_MAPPING_MAX_SUBNET_BITS)
+		subnet_bits = SCION_MAPPING_MAX_SUBNET_BITS;
+	hi |= ((__u64)local_prefix << subnet_bits) & 0xFFFFFF;
+	hi |= (__u64)subnet & ((1u << subnet_bits) - 1);
+	return hi;
+}
+
+#endif // SCION_MAPPING_H_GUARD
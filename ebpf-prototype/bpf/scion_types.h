@@ -153,6 +153,9 @@ struct __attribute__((packed)) macinput {
 	__u16 null2;
 };
 
+#define SCMP_EXT_IF_DOWN 5
+#define SCMP_INT_CONN_DOWN 6
+
 struct __attribute__((packed)) scmphdr {
 	__u8 type;
 	__u8 code;
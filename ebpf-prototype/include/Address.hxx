@@ -0,0 +1,62 @@
+#ifndef ADDRESS_HXX_GUARD_
+#define ADDRESS_HXX_GUARD_
+
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "bpf/scion_types.h"
+#include "bpf/scion.h"
+
+/// Parse an ISD-AS pair like "1-64512" or "1-ff00:0:110"
+///
+/// Returns the 64-bit ISD-AS (16 bit ISD, 48 bit ASN) or nothing if the string is invalid.
+std::optional<std::uint64_t> parseIsdAsn(std::string_view raw);
+
+/// Format a 64-bit ISD-AS in the usual notation
+std::string formatIsdAsn(std::uint64_t ia);
+
+/// Parse an underlay address like "192.0.2.1:30042" or "[2001:db8::1]:30042"
+///
+/// IPv4 addresses are stored IPv4-mapped. Returns false if the string is invalid.
+bool parseUnderlay(std::string_view raw, std::array<std::uint8_t, 16> &addr, std::uint16_t &port);
+
+/// Path Cache key of a destination, see get_map_key in bpf/scion.h
+///
+/// subnet: subnet ID of the destination, 0 if the keys do not include the subnet
+constexpr scion_addr toScionAddr(std::uint64_t ia, std::uint32_t subnet = 0)
+{
+	return scion_addr{ ia, subnet, 0 };
+}
+
+/// ISD-AS of a Path Cache key
+constexpr std::uint64_t toIsdAsn(scion_addr addr)
+{
+	return addr.ia;
+}
+
+constexpr bool operator==(const scion_addr &a, const scion_addr &b)
+{
+	return a.ia == b.ia && a.subnet == b.subnet;
+}
+
+constexpr std::strong_ordering operator<=>(const scion_addr &a, const scion_addr &b)
+{
+	if (auto cmp = a.ia <=> b.ia; cmp != 0)
+		return cmp;
+	return a.subnet <=> b.subnet;
+}
+
+template <>
+struct std::hash<scion_addr> {
+	std::size_t operator()(const scion_addr &addr) const noexcept
+	{
+		return std::hash<std::uint64_t>{}(addr.ia ^ (std::uint64_t(addr.subnet) * 0x9E3779B97F4A7C15ull));
+	}
+};
+
+#endif // ADDRESS_HXX_GUARD_
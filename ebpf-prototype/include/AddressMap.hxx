@@ -0,0 +1,74 @@
+#ifndef ADDRESS_MAP_HXX_GUARD_
+#define ADDRESS_MAP_HXX_GUARD_
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "bpf.h"
+
+#include "bpf/scion_types.h"
+#include "bpf/scion.h"
+
+/// Manages the address map of the egress program
+///
+/// The address map assigns SCION addresses to IPv6 prefixes outside of the
+/// SCION-mapped range fc00::/8, e.g. for ASes with ASNs that cannot be encoded
+/// in a SCION-mapped address. The egress program uses the longest matching
+/// prefix of a destination that is not SCION-mapped.
+///
+/// Hosts mapped to an explicit SCION host address are also entered in the
+/// reverse map of the ingress program, which restores their IPv6 address in
+/// the source of their replies. Such mappings must therefore be single
+/// addresses (/128) with a unique SCION address.
+class AddressMap {
+    public:
+	using Prefix = std::pair<std::array<std::uint8_t, 16>, unsigned int>;
+
+	/// reverse: reverse map of the ingress program, nullptr if ingress translation is disabled
+	explicit AddressMap(struct bpf_map *map, struct bpf_map *reverse = nullptr);
+
+	/// Map all addresses in `prefix` to ISD-AS `ia`
+	///
+	/// host: host address in the SCION header, unspecified (::) to keep the IPv6 address, only
+	///       allowed for /128 prefixes
+	/// Returns false if the map could not be updated.
+	bool set(const Prefix &prefix, std::uint64_t ia, const std::array<std::uint8_t, 16> &host = {});
+
+	/// Remove the mapping of `prefix`
+	void erase(const Prefix &prefix);
+
+	/// Replace all mappings with the ones in `file`
+	///
+	/// The file contains one mapping per line, an IPv6 prefix followed by the
+	/// ISD-AS and optionally the IPv6 host address in the SCION header:
+	/// ```
+	/// # prefix          ISD-AS         [host]
+	/// 2001:db8:1::/48   1-ff00:0:110
+	/// 2001:db8:2::1/128 1-ff00:0:111   fd00::1
+	/// ```
+	/// Empty lines and lines starting with '#' are ignored, as are host
+	/// addresses for prefixes other than /128 and host addresses already used
+	/// for the same ISD-AS. Prefixes that are in the map but not in the file
+	/// are removed. Throws if the file cannot be read. Returns the number of
+	/// mappings.
+	std::size_t load(const std::string &file);
+
+	/// Parse an IPv6 prefix like "2001:db8::/32"
+	///
+	/// Bits beyond the prefix length are cleared. Returns false if the string is invalid.
+	static bool parsePrefix(const std::string &raw, Prefix &prefix);
+
+    private:
+	/// Remove the reverse mapping of `entry` at `prefix`, if it has one
+	void eraseReverse(const Prefix &prefix, const struct addr_map_entry &entry);
+
+	struct bpf_map *map;
+	struct bpf_map *reverse;
+	/// Mappings currently in the BPF map
+	std::map<Prefix, struct addr_map_entry> entries;
+};
+
+#endif // ADDRESS_MAP_HXX_GUARD_
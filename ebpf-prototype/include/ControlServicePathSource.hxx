@@ -0,0 +1,63 @@
+#ifndef CONTROL_SERVICE_PATH_SOURCE_HXX_GUARD_
+#define CONTROL_SERVICE_PATH_SOURCE_HXX_GUARD_
+
+#include <array>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PathSource.hxx"
+#include "SegmentCombiner.hxx"
+
+/// Obtains paths directly from the control service of the local AS
+///
+/// Up, core and down segments are looked up with the segment lookup API of the
+/// control service and combined locally, see combineSegments(). This saves the
+/// round trip through the SCION daemon on every cold lookup.
+///
+/// The control service and border router addresses are read from the
+/// topology.json of the local AS. Like the daemon, the source trusts the
+/// local control service to only return verified segments and does not check
+/// their signatures again.
+///
+/// Example:
+/// ```cpp
+/// ps.init(std::make_unique<ControlServicePathSource>("/etc/scion/topology.json"));
+/// ```
+class ControlServicePathSource : public PathSource {
+    public:
+	explicit ControlServicePathSource(const std::string &topologyFile);
+
+	/// Read the topology and connect to the control service
+	bool connect() override;
+	std::optional<PathInfoVec> query(std::uint64_t dst) override;
+
+	/// Internal addresses of all border routers listed in a topology.json
+	///
+	/// Throws if the file cannot be read.
+	static std::vector<std::array<std::uint8_t, 16>> borderRouters(const std::string &topologyFile);
+
+    private:
+	/// Look up segments from `src` to `dst`
+	///
+	/// An ASN of 0 matches all core ASes of the ISD. Lookups the control
+	/// service rejected return no segments, unreachable ones return nothing.
+	std::future<std::optional<std::vector<PathSegment>>> lookup(std::uint64_t src, std::uint64_t dst);
+
+	std::string topologyFile;
+	std::uint64_t localIA = 0;
+	bool core = false;
+	// Internal address of the border router owning each interface of the local AS
+	struct Router {
+		std::array<std::uint8_t, 16> addr;
+		std::uint16_t port;
+	};
+	std::unordered_map<std::uint64_t, Router> routers;
+	std::shared_ptr<grpc::Channel> channel;
+};
+
+#endif // CONTROL_SERVICE_PATH_SOURCE_HXX_GUARD_
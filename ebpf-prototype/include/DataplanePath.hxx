@@ -0,0 +1,49 @@
+#ifndef DATAPLANE_PATH_HXX_GUARD_
+#define DATAPLANE_PATH_HXX_GUARD_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+/// Decoded standard SCION dataplane path
+///
+/// Only the fields needed to reason about a path in userspace are kept,
+/// the MACs are not decoded.
+struct DecodedPath {
+	struct InfoField {
+		bool consDir;
+		bool peering;
+		std::uint16_t segId;
+		std::uint32_t timestamp;
+	};
+
+	struct HopField {
+		std::uint8_t expTime;
+		std::uint16_t consIngress;
+		std::uint16_t consEgress;
+	};
+
+	/// Number of hop fields in each segment
+	std::array<std::uint8_t, 3> segLen = {};
+	std::vector<InfoField> infos;
+	std::vector<HopField> hops;
+
+	/// Index of the info field hop field `hop` belongs to
+	std::size_t infoIndex(std::size_t hop) const;
+
+	/// Point in time the first hop field on the path expires
+	///
+	/// Empty paths never expire.
+	std::chrono::system_clock::time_point expiry() const;
+};
+
+/// Decode a raw standard SCION path as found in the SCION header
+///
+/// An empty buffer is decoded as an empty path.
+/// Returns nothing if the path is malformed.
+std::optional<DecodedPath> decodePath(std::span<const std::uint8_t> raw);
+
+#endif // DATAPLANE_PATH_HXX_GUARD_
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <cstdint>
 #include <string>
 
 #include "egress.skel.h"
@@ -11,18 +12,74 @@ class EgressLoader {
 	EgressLoader();
 	~EgressLoader();
 
+	/// Opens the bpf object without loading it into the kernel
+	///
+	/// Maps can be configured or shared with other programs until load() is called.
+	void open();
+
+	/// Loads the bpf programs and maps into the kernel without attaching them
+	///
+	/// Opens the object first if that has not happened yet.
+	/// Allows populating the maps before the first packet is seen.
+	void load();
+
+	/// Use the reply path map of the ingress program instead of a separate one
+	///
+	/// Must be called between open() and load().
+	void shareReplyMap(struct bpf_map *replyMap);
+
+	/// Include the lowest `bits` bits of the destination prefix (the subnet ID) in the map keys
+	///
+	/// Must be called before load(), 0 (the default) keys destinations by ISD-AS only.
+	void setSubnetBits(unsigned int bits);
+
+	/// Look up destinations outside of fc00::/8 in the address map
+	///
+	/// Must be called before load(), the map is populated through addressMap().
+	void enableAddressMap();
+
+	/// Rate limit the destinations configured in policeConfig()
+	///
+	/// Must be called before load(), see Policer.
+	void enablePolicing();
+
 	/// Attaches bpf programs to the specified interface
+	///
+	/// Loads the programs first if that has not happened yet.
 	void attach(const std::string &interface);
 	void attach(const unsigned int interfaceIndex);
 
+	/// Sample one in `rate` translated packets into captureBuffer(), 0 to stop
+	///
+	/// Takes effect immediately, only valid after the programs were loaded.
+	void setCaptureRate(std::uint32_t rate);
+	/// Returns a pointer to the capture ring buffer
+	struct bpf_map *captureBuffer();
+
 	/// Returns a pointer to the Path Cache bpf map
 	struct bpf_map *pathMap();
   /// Returns a pointer to the Request Queue bpf_map
   struct bpf_map *requestQueue();
+	/// Returns a pointer to the Path Statistics bpf map
+	struct bpf_map *pathStats();
+	/// Returns a pointer to the Negative Path Cache bpf map
+	struct bpf_map *negativeCache();
+	/// Returns a pointer to the address map
+	struct bpf_map *addressMap();
+	/// Returns a pointer to the rate limit configuration bpf map
+	struct bpf_map *policeConfig();
+	/// Returns a pointer to the token bucket bpf map
+	struct bpf_map *policeState();
+	/// Returns a pointer to the drop counter bpf map
+	struct bpf_map *dropStats();
 
     private:
 	/// Embedded object code of egress BPF program
-	struct egress_bpf *tc_skel;
+	struct egress_bpf *tc_skel = nullptr;
+	bool loaded = false;
+	unsigned int subnetBits = 0;
+	bool useAddressMap = false;
+	bool usePolicing = false;
 
 	/// TC hook to attach the BPF program to
 	std::shared_ptr<struct bpf_tc_hook> tc_hook;
@@ -0,0 +1,55 @@
+#ifndef GRPC_CALL_HXX_GUARD_
+#define GRPC_CALL_HXX_GUARD_
+
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+
+#include <grpcpp/channel.h>
+#include <grpcpp/client_context.h>
+#include <grpcpp/generic/generic_stub.h>
+#include <grpcpp/impl/codegen/proto_utils.h>
+
+/// A unary gRPC call of a protobuf method without generated stubs
+///
+/// Example:
+/// ```cpp
+/// GrpcCall<PathsRequest, PathsResponse> call;
+/// call.request.set_destination_isd_as(dst);
+/// auto status = call.start(channel, "/proto.daemon.v1.DaemonService/Paths", 1s).get();
+/// ```
+template <typename Request, typename Response>
+struct GrpcCall {
+	grpc::ClientContext context;
+	Request request;
+	Response response;
+
+	/// Send the request to `method` of the form "/package.Service/Method"
+	///
+	/// The call is cancelled after `timeout`. The response must not be
+	/// accessed and the call must stay alive until the returned future is ready.
+	std::future<grpc::Status> start(const std::shared_ptr<grpc::Channel> &channel, const std::string &method,
+		std::chrono::milliseconds timeout)
+	{
+		context.set_deadline(std::chrono::system_clock::now() + timeout);
+		auto future = done.get_future();
+		grpc::TemplatedGenericStub<Request, Response>(channel).UnaryCall(&context, method, grpc::StubOptions(),
+			&request, &response, [this](grpc::Status status) { done.set_value(std::move(status)); });
+		return future;
+	}
+
+    private:
+	std::promise<grpc::Status> done;
+};
+
+/// Whether a call failed because the server could not be reached in time
+///
+/// Other errors are reported by the server itself.
+inline bool isUnreachable(const grpc::Status &status)
+{
+	return status.error_code() == grpc::StatusCode::UNAVAILABLE
+		|| status.error_code() == grpc::StatusCode::DEADLINE_EXCEEDED;
+}
+
+#endif // GRPC_CALL_HXX_GUARD_
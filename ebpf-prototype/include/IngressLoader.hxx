@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <string>
 
 #include "ingress.skel.h"
@@ -14,7 +16,33 @@ class IngressLoader {
 	void attach(const std::string &interface);
 	void attach(const unsigned int interfaceIndex);
 
+	/// Include the lowest `bits` bits of the source prefix (the subnet ID) in the reply path keys
+	///
+	/// Must be called before attach() and match EgressLoader::setSubnetBits().
+	void setSubnetBits(unsigned int bits);
+
+	/// Sample one in `rate` translated packets into captureBuffer(), 0 to stop
+	///
+	/// Takes effect immediately, only valid after the programs were loaded.
+	void setCaptureRate(std::uint32_t rate);
+	/// Returns a pointer to the capture ring buffer
+	struct bpf_map *captureBuffer();
+
+	/// Accept SCMP messages and reply paths forwarded by the border router with underlay address `addr`
+	///
+	/// Packets from other senders are translated, but neither reported nor recorded. Only valid
+	/// after attach(), throws if too many routers are trusted.
+	void trustRouter(const std::array<std::uint8_t, 16> &addr);
+
+	/// Returns a pointer to the SCMP event ring buffer, only valid after attach()
+	struct bpf_map *scmpEvents();
+	/// Returns a pointer to the reply path map, only valid after attach()
+	struct bpf_map *replyMap();
+	/// Returns a pointer to the reverse address map, see AddressMap, only valid after attach()
+	struct bpf_map *addressReverseMap();
+
     private:
 	/// Embedded object code of ingress BPF program
-	struct ingress_bpf *xdp_skel;
+	struct ingress_bpf *xdp_skel = nullptr;
+	unsigned int subnetBits = 0;
 };
@@ -0,0 +1,64 @@
+#ifndef INTERFACE_INDEX_HXX_GUARD_
+#define INTERFACE_INDEX_HXX_GUARD_
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "bpf/scion_types.h"
+#include "bpf/scion.h"
+
+#include "Address.hxx"
+#include "PathSource.hxx"
+
+/// Reverse index from SCION interfaces to the destinations whose paths use them
+///
+/// Interfaces are taken from the interface metadata of a path if present.
+/// Otherwise they are read from the hop fields of the dataplane path, where
+/// only the ISD-AS of the first and last hop is known. Interface IDs are only
+/// unique within an AS, so the interfaces of the other hops are not indexed and
+/// such paths are not affected by failures of intermediate ASes.
+class InterfaceIndex {
+    public:
+	/// Index all interfaces `path` to `dst` traverses
+	void add(scion_addr dst, const PathInfo &path);
+
+	/// Remove all entries of `dst`
+	void remove(scion_addr dst);
+
+	/// Destinations with a path that uses interface `ifid` of AS `ia`
+	///
+	/// Not every path of a returned destination needs to use the interface,
+	/// check the paths with traverses().
+	std::vector<scion_addr> lookup(std::uint64_t ia, std::uint64_t ifid) const;
+
+	/// Whether `path` uses interface `ifid` of AS `ia`
+	///
+	/// If `egress` is non-zero, only paths crossing the AS between `ifid` and
+	/// `egress` match. Interfaces whose ISD-AS is unknown never match.
+	static bool traverses(const PathInfo &path, std::uint64_t ia, std::uint64_t ifid, std::uint64_t egress = 0);
+
+	/// Number of indexed destinations
+	std::size_t size() const { return byDestination.size(); }
+
+    private:
+	struct Key {
+		std::uint64_t ia;
+		std::uint64_t ifid;
+
+		bool operator==(const Key &) const = default;
+	};
+
+	struct KeyHash {
+		std::size_t operator()(const Key &key) const
+		{
+			return std::hash<std::uint64_t>()(key.ia * 0x9e3779b97f4a7c15ull ^ key.ifid);
+		}
+	};
+
+	std::unordered_map<Key, std::unordered_set<scion_addr>, KeyHash> byInterface;
+	std::unordered_map<scion_addr, std::vector<Key>> byDestination;
+};
+
+#endif // INTERFACE_INDEX_HXX_GUARD_
@@ -0,0 +1,46 @@
+#ifndef PACKET_CAPTURE_HXX_GUARD_
+#define PACKET_CAPTURE_HXX_GUARD_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "libbpf.h"
+
+#include "bpf/scion_types.h"
+#include "bpf/scion.h"
+
+/// Writes the packets sampled by the BPF programs to a pcapng file
+///
+/// Every capture point (egress or ingress, before or after translation) is a
+/// separate interface in the file. The records of the same packet before and
+/// after translation carry the same "packet <cpu>:<id>" comment and follow
+/// each other closely, as both are produced in one run of the program.
+class PacketCapture {
+    public:
+	/// Create or truncate `file`, throws if it cannot be written
+	explicit PacketCapture(const std::string &file);
+	~PacketCapture();
+
+	PacketCapture(const PacketCapture &) = delete;
+	PacketCapture &operator=(const PacketCapture &) = delete;
+
+	/// Consume the capture ring buffer of a BPF program
+	void watch(struct bpf_map *captureMap);
+
+	/// Wait up to `timeoutMs` for captured packets and write them to the file
+	///
+	/// Returns the number of packets written or a negative error.
+	int poll(int timeoutMs);
+
+    private:
+	static int handler(void *ctx, void *data, std::size_t size);
+	void write(const struct capture_record &record);
+
+	std::ofstream out;
+	struct ring_buffer *buffers = nullptr;
+	/// Offset of CLOCK_MONOTONIC to the Unix epoch in ns
+	std::int64_t epochOffset;
+};
+
+#endif // PACKET_CAPTURE_HXX_GUARD_
@@ -0,0 +1,114 @@
+#ifndef PATH_PROBER_HXX_GUARD_
+#define PATH_PROBER_HXX_GUARD_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "bpf/scion_types.h"
+#include "bpf/scion.h"
+
+#include "Address.hxx"
+#include "PathRanking.hxx"
+#include "PathSource.hxx"
+
+/// Configuration of the active path probing
+struct ProbeConfig {
+	/// Interval between two probes on the same path
+	std::chrono::milliseconds interval = std::chrono::milliseconds(1000);
+	/// Maximum number of probes sent per second in total
+	unsigned rate = 100;
+	/// Number of most used destinations whose paths are probed
+	std::size_t destinations = 64;
+	/// Probes not answered within this time count as lost
+	std::chrono::milliseconds timeout = std::chrono::milliseconds(1000);
+	/// Weight of a new sample in the moving averages
+	double alpha = 0.2;
+	/// Minimum score improvement required to replace the installed path
+	double hysteresis = 0.5;
+};
+
+/// Measures RTT and loss of SCION paths with SCMP probes
+///
+/// Each probe is an SCMP traceroute request with the router alert flag set on
+/// the last hop field, so it is answered by the ingress border router of the
+/// destination AS. Requests are sent to the first border router over UDP,
+/// replies are received on a raw socket after the ingress translator turned
+/// them into IPv6 packets carrying SCMP.
+///
+/// The ingress translator only processes packets addressed to SCION-mapped
+/// addresses, so probes are sent from a SCION-mapped address of the local AS
+/// (fc00::/8). Paths whose first border router cannot be reached from such an
+/// address, e.g. over an IPv4 underlay, are not probed.
+///
+/// RTT and loss are kept as exponentially weighted moving averages per path
+/// and handed to the PathRanking.
+class PathProber {
+    public:
+	PathProber(const ProbeConfig &config, PathRanking &ranking);
+	~PathProber();
+
+	PathProber(const PathProber &) = delete;
+	PathProber &operator=(const PathProber &) = delete;
+
+	/// Open the sockets, throws on failure
+	void open();
+
+	/// Send a probe to `dst` over `path`
+	///
+	/// Returns false if the rate limit is exhausted or the probe could not be sent.
+	bool probe(scion_addr dst, const PathInfo &path);
+
+	/// Process received replies and expired probes without blocking
+	///
+	/// Destinations with new measurements are appended to `updated`.
+	void poll(std::vector<scion_addr> &updated);
+
+	const ProbeConfig &config() const { return cfg; }
+
+    private:
+	using Clock = std::chrono::system_clock;
+	using Address = std::array<std::uint8_t, 16>;
+
+	struct Outstanding {
+		scion_addr dst;
+		std::uint64_t fingerprint;
+		Clock::time_point sent;
+	};
+
+	struct Estimate {
+		double rtt; // us
+		double loss;
+		bool replied;
+	};
+
+	/// SCION-mapped address of `localIA` used to reach `router`, cached per router
+	///
+	/// Returns nullptr if there is no such address.
+	const Address *sourceFor(const Address &router, std::uint64_t localIA);
+
+	/// Fold a sample into the estimate of a path and publish it to the ranking
+	void update(std::uint64_t fingerprint, std::optional<std::chrono::microseconds> rtt);
+
+	ProbeConfig cfg;
+	PathRanking &ranking;
+	// UDP socket requests are sent on, raw socket replies are received on
+	int sendFd = -1;
+	int recvFd = -1;
+	// SCMP identifier of this prober and sequence number of the next probe
+	std::uint16_t id;
+	std::uint16_t seq = 0;
+	// Token bucket limiting the probe rate
+	double tokens;
+	Clock::time_point lastRefill;
+	std::unordered_map<std::uint16_t, Outstanding> outstanding;
+	std::unordered_map<std::uint64_t, Estimate> estimates;
+	std::map<Address, std::optional<Address>> sources;
+	std::vector<std::uint8_t> buffer;
+};
+
+#endif // PATH_PROBER_HXX_GUARD_
@@ -0,0 +1,117 @@
+#ifndef PATH_RANKING_HXX_GUARD_
+#define PATH_RANKING_HXX_GUARD_
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "PathSource.hxx"
+
+/// Weights used to score a path, the path with the highest score is chosen
+///
+/// The score is the weighted sum of the path metrics in the units given below.
+/// Metrics that are unknown for a path (e.g. no latency metadata) contribute nothing.
+struct RankingPolicy {
+	/// Per hop field
+	double hops = -1.0;
+	/// Per byte of path MTU
+	double mtu = 0.001;
+	/// Per hour until the path expires
+	double lifetime = 0.1;
+	/// Per millisecond of advertised latency
+	double latency = -0.01;
+	/// Per Gbit/s of advertised bottleneck bandwidth
+	double bandwidth = 0.1;
+	/// Per millisecond of measured round-trip time
+	double rtt = -0.02;
+	/// Per percent of measured packet loss
+	double loss = -0.5;
+
+	/// Paths with a known MTU below this value are never chosen
+	std::uint16_t minMtu = 0;
+	/// Paths expiring earlier than this are never chosen
+	std::chrono::seconds minLifetime = std::chrono::seconds(10);
+};
+
+/// Live measurement of a path, see PathRanking::measured()
+struct PathMeasurement {
+	std::chrono::microseconds rtt;
+	/// Fraction of lost probes (0..1)
+	double loss;
+};
+
+/// Chooses the best of a set of paths according to a configurable policy
+///
+/// Policies are assigned per destination and per traffic class, the most
+/// specific one wins: (destination, class), (destination, any), (any, class),
+/// then the default policy.
+///
+/// The selection is deterministic: ties are broken by the path fingerprint,
+/// then by the position in the candidate list. It does not allocate and is
+/// linear in the number of candidates.
+class PathRanking {
+    public:
+	/// Matches any destination or traffic class in setPolicy()
+	static constexpr std::uint64_t ANY_DST = ~0ull;
+	static constexpr int ANY_CLASS = -1;
+
+	/// Set the policy used for destination ISD-AS `dst` and traffic class `tc`
+	void setPolicy(std::uint64_t dst, int tc, const RankingPolicy &policy);
+
+	/// Policy applicable for the given destination and traffic class
+	const RankingPolicy &policy(std::uint64_t dst, int tc) const;
+
+	/// Read policies from a text file, replacing the current ones
+	///
+	/// Each line holds a destination ISD-AS and a traffic class (both may be '*'),
+	/// followed by `metric=weight` pairs overriding the defaults. Lines starting
+	/// with '#' are ignored:
+	/// ```
+	/// # dst          class  weights
+	/// *              *      hops=-2 latency=-0.05
+	/// 1-ff00:0:110   *      bandwidth=1 minMtu=1400
+	/// ```
+	/// Throws if the file cannot be read or contains invalid lines.
+	void loadPolicies(const std::string &file);
+
+	/// Score a single path, higher is better
+	///
+	/// Returns nothing if the policy rules the path out.
+	std::optional<double> score(const PathInfo &path, const RankingPolicy &policy,
+		std::chrono::system_clock::time_point now) const;
+
+	/// Index of the best path in `paths` for destination `dst` and traffic class `tc`
+	///
+	/// Returns nothing if no path is acceptable.
+	std::optional<std::size_t> select(std::uint64_t dst, int tc, const PathInfoVec &paths,
+		std::chrono::system_clock::time_point now) const;
+
+	/// Record a live measurement for the path with the given fingerprint
+	void measured(std::uint64_t fingerprint, const PathMeasurement &measurement);
+
+	/// Forget all measurements
+	void clearMeasurements() { measurements.clear(); }
+
+	/// Identifies a path by the interfaces it traverses
+	///
+	/// Stable across path refreshes, unlike the raw dataplane path. Paths
+	/// without interface metadata are identified by their dataplane path.
+	static std::uint64_t fingerprint(const PathInfo &path);
+
+    private:
+	struct KeyHash {
+		std::size_t operator()(const std::pair<std::uint64_t, int> &key) const
+		{
+			return std::hash<std::uint64_t>()(key.first * 31 + key.second);
+		}
+	};
+
+	RankingPolicy defaultPolicy;
+	std::unordered_map<std::pair<std::uint64_t, int>, RankingPolicy, KeyHash> policies;
+	std::unordered_map<std::uint64_t, PathMeasurement> measurements;
+};
+
+#endif // PATH_RANKING_HXX_GUARD_
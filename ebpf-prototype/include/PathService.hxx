@@ -1,12 +1,27 @@
 #ifndef PATH_SERVICE_HXX_GUARD_
 #define PATH_SERVICE_HXX_GUARD_
 
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
-#include <snet/snet.hpp>
 #include "bpf.h"
 
+#include "bpf/scion_types.h"
+#include "bpf/scion.h"
+
+#include "Address.hxx"
+#include "InterfaceIndex.hxx"
+#include "PathProber.hxx"
+#include "PathRanking.hxx"
+#include "PathSource.hxx"
+#include "PathTable.hxx"
+
 /// The PathService is responsible for the management of the Path Cache.
 ///
 /// It is listening for new path requests and populates the Path Cache accordingly.
@@ -15,35 +30,135 @@
 /// ```cpp
 /// struct bpf_map *map = /*...*/;
 ///
-/// PathService ps(map);
-/// ps.init("127.0.0.1:50010"):
+/// PathService ps(map, reqMap, statsMap, negMap);
+/// ps.init(std::make_unique<DaemonPathSource>("127.0.0.1:30255"));
 /// ps.run();
 /// ```
 class PathService {
     public:
-	PathService(struct bpf_map *pathCache, struct bpf_map *reqMap);
+	/// Aggregated usage statistics of a cached destination
+	struct Stats {
+		scion_addr addr;
+		std::uint64_t packets;
+		std::uint64_t bytes;
+	};
+
+	PathService(struct bpf_map *pathCache, struct bpf_map *reqMap, struct bpf_map *statsMap,
+		struct bpf_map *negCache);
 
-	/// Initialize the PathService
+	/// Initialize the PathService with the source paths are obtained from
 	///
-	/// Throws if Host Context cannot be initialized (e.g. daemon not reachable)
-	void init(std::string &sciondAddr);
+	/// Throws if the source cannot be connected (e.g. daemon not reachable).
+	/// The source is kept anyway, run() keeps retrying to connect if this failed.
+	void init(std::unique_ptr<PathSource> source);
+
+	/// Ranking used to choose among the paths to a destination
+	PathRanking &ranking() { return pathRanking; }
+
+	/// Userspace mirror of the Path Cache, readable from any thread
+	const PathTable &table() const { return pathTable; }
+
+	/// Whether the connection to the path source is up
+	bool isConnected() const { return connected; }
 
 	/// Run the Path Service
 	///
 	/// This is a blocking call, listening for new path requests
 	void run();
 
-	/// Retrieve paths for specified destination address
+	/// Retrieve paths for specified destination address from the path source
 	///
-	/// TODO
-	///
-	scion::PathVec getPaths(std::uint32_t daddr);
+	/// Returns nothing if the source could not be reached. The source is then
+	/// marked as disconnected and run() reconnects it.
+	std::optional<PathInfoVec> getPaths(scion_addr daddr);
 
   /// Insert paths for given address
   ///
-  /// TODO
+  /// The best path according to the ranking is chosen. The update is only
+  /// queued, call flush() to write it to the Path Cache.
+  /// If no path is acceptable, the destination is added to the Negative Path Cache instead.
   ///
-  void insertPaths(std::uint32_t addr, const scion::PathVec &paths);
+  void insertPaths(scion_addr addr, const PathInfoVec &paths);
+
+	/// Signal that the topology has changed, e.g. after a link came back up
+	///
+	/// The Negative Path Cache is flushed by run() on its next iteration, so that
+	/// previously unreachable destinations are looked up again immediately.
+	/// Safe to call from any thread.
+	void onTopologyChange() { topologyChanged = true; }
+
+	/// Remove all entries from the Negative Path Cache and reset their backoff
+	void clearNegativeCache();
+
+	/// Listen for SCMP interface down events reported by the ingress program
+	///
+	/// Affected paths are dropped from the candidates and destinations using
+	/// them are switched to the next-best path immediately.
+	void watchScmp(struct bpf_map *scmpEvents);
+
+	/// Stop using all paths that traverse interface `ifid` of AS `ia`
+	///
+	/// If `egress` is non-zero, only paths crossing the AS from `ifid` to `egress` are affected.
+	void onInterfaceDown(std::uint64_t ia, std::uint64_t ifid, std::uint64_t egress = 0);
+
+	/// Probe the paths to the most used destinations while running
+	///
+	/// The installed path is replaced once another candidate scores better by
+	/// more than the configured hysteresis. Throws if the sockets cannot be opened.
+	void enableProbing(const ProbeConfig &config);
+
+	/// Write all queued updates to the Path Cache
+	///
+	/// Uses a single BPF_MAP_UPDATE_BATCH call if supported by the kernel.
+	/// Only entries written successfully are recorded in the userspace mirror,
+	/// see table(). Changes are published to it at most every 100 ms, so
+	/// bursts of small flushes do not each create a new snapshot.
+	/// Returns the number of entries written.
+	std::size_t flush();
+
+	/// Read the usage statistics of all cached destinations in bulk
+	///
+	/// Per-CPU counters are summed up.
+	std::vector<Stats> dumpStats();
+
+	/// Resolve paths to the given destinations and write them to the Path Cache
+	///
+	/// Up to `concurrency` daemon queries are in flight at the same time.
+	/// Intended to be called before the egress program is attached, so that
+	/// known destinations never see a cold miss.
+	/// Returns the number of destinations a path was found for.
+	std::size_t warmUp(const std::vector<scion_addr> &dests, unsigned concurrency = 16);
+
+	/// Persist the most used destinations to `file` periodically while running
+	///
+	/// The file has the format expected by readDestinations() and can be used
+	/// to warm up the Path Cache on the next start.
+	void setHotSetFile(const std::string &file, std::chrono::seconds interval = std::chrono::seconds(60));
+
+	/// Write the currently most used destinations to the hot set file
+	void saveHotSet();
+
+	/// Serialize the Path Cache to `file` periodically while running
+	void setSnapshotFile(const std::string &file, std::chrono::seconds interval = std::chrono::seconds(60));
+
+	/// Write the current Path Cache contents to the snapshot file
+	void saveSnapshot();
+
+	/// Load all entries of a snapshot that have not expired yet into the Path Cache
+	///
+	/// The snapshot holds no metadata of the paths, so run() queries the
+	/// restored destinations again once the source is connected. Until then
+	/// SCMP interface down messages and probing do not affect them.
+	/// Returns the number of entries restored. Throws if the snapshot cannot be read.
+	std::size_t loadSnapshot(const std::string &file);
+
+	/// Read a list of destinations from a text file
+	///
+	/// The file contains one ISD-AS per line, optionally followed by the
+	/// hexadecimal subnet ID if the Path Cache keys include the subnet. Empty
+	/// lines and lines starting with '#' are ignored. Throws if the file cannot
+	/// be read.
+	static std::vector<scion_addr> readDestinations(const std::string &file);
 
 	/// Pre-populate path cache with hardcoded values
 	///
@@ -53,13 +168,82 @@ class PathService {
 	//void fillPathMap();
 
     private:
+	/// Write pending updates one by one starting at index `first`
+	std::size_t flushSingle(std::size_t first);
+
+	/// Try to (re)connect to the path source
+	bool connect();
+
+	/// Query the paths to `dests` with up to `concurrency` queries in flight
+	std::vector<std::optional<PathInfoVec>> queryAll(const std::vector<scion_addr> &dests, unsigned concurrency);
+
+	/// Replace the paths restored from the snapshot with fresh ones from the source
+	///
+	/// Destinations the source could not be queried for are kept for the next call.
+	void refreshRestored();
+
+	/// Suppress requests for `addr` for an exponentially growing time
+	void insertNegative(scion_addr addr);
+
+	/// Remove `addr` from the Negative Path Cache
+	void removeNegative(scion_addr addr);
+
+	/// The `n` destinations with the most packets sent
+	std::vector<Stats> hottest(std::size_t n);
+
+	/// Send one round of probes over the candidate paths of the hottest destinations
+	void probeRound();
+
+	/// Rank the candidates of `addr` again and install a better path if there is one
+	void reselect(scion_addr addr);
+
+	/// Replace the candidate paths of `addr`, keeping the interface index up to date
+	void setCandidates(scion_addr addr, const PathInfoVec &paths);
+
+	/// Queue `path` for installation as the path to `addr`
+	void install(scion_addr addr, const PathInfo &path);
+
+	/// Remove the path to `addr` from the Path Cache, the next packet requests a new one
+	void evict(scion_addr addr);
+
 	// Map representing the path cache
 	struct bpf_map *pathCache;
+	// Per-CPU usage statistics of the path cache
+	struct bpf_map *statsMap;
+	// Updates not yet written to the path cache
+	std::vector<scion_addr> pendingKeys;
+	std::vector<struct path_map_entry> pendingValues;
+	std::vector<PathInfo> pendingPaths;
+	// Whether the kernel supports batched map operations
+	bool batchSupported = true;
+	// File the hot set is persisted to, empty if disabled
+	std::string hotSetFile;
+	std::chrono::seconds hotSetInterval;
+	// File the Path Cache is serialized to, empty if disabled
+	std::string snapshotFile;
+	std::chrono::seconds snapshotInterval;
+	// Destinations without paths mapped to the number of consecutive failed lookups
+	struct bpf_map *negCache;
+	std::unordered_map<scion_addr, unsigned> failures;
+	std::atomic<bool> topologyChanged = false;
+	// Path installed for each destination and the last time it was published
+	PathTable pathTable;
+	std::chrono::steady_clock::time_point lastPublish;
+	// Source of new paths
+	std::unique_ptr<PathSource> source;
+	PathRanking pathRanking;
+	std::unique_ptr<PathProber> prober;
+	// Paths last returned by the source and fingerprint of the installed one per destination
+	std::unordered_map<scion_addr, PathInfoVec> candidates;
+	std::unordered_map<scion_addr, std::uint64_t> installed;
+	// Interfaces the candidates of each destination depend on
+	InterfaceIndex interfaceIndex;
+	// Destinations restored from the snapshot without candidates yet
+	std::vector<scion_addr> restoredDests;
+	// Written by the warm-up threads when a query fails
+	std::atomic<bool> connected = false;
   // Ring buffer for obtaining path requests
   struct ring_buffer *reqQueue;
-	// host context for communication with daemon.
-	// for a daemonless version we can remove this in favor of calls directly to the path server using gRPC.
-	scion::HostCtx hostCtx;
 };
 
 #endif // PATH_SERVICE_HXX_GUARD_
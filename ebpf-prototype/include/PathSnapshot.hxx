@@ -0,0 +1,49 @@
+#ifndef PATH_SNAPSHOT_HXX_GUARD_
+#define PATH_SNAPSHOT_HXX_GUARD_
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "bpf/scion_types.h"
+#include "bpf/scion.h"
+
+/// On-disk snapshot of the Path Cache
+///
+/// Allows the translator to forward with the last known good paths right after
+/// a restart, even if the SCION daemon is not reachable yet.
+///
+/// The file starts with a fixed header followed by variable length records,
+/// only the used part of each raw path is stored:
+/// ```
+/// header: magic (8) | version (4) | key size (4) | record count (8)
+/// record: key | expiry in Unix seconds (8) | path_len (1) | scionhdr | router_addr (16)
+///         | router_port (2) | path (4 * path_len)
+/// ```
+/// All integers are in host byte order, snapshots are not meant to be portable.
+class PathSnapshot {
+    public:
+	using Clock = std::chrono::system_clock;
+
+	struct Entry {
+		scion_addr key;
+		Clock::time_point expiry;
+		struct path_map_entry value;
+	};
+
+	/// Write entries to `file`
+	///
+	/// The file is replaced atomically. Throws on I/O errors.
+	static void save(const std::string &file, const std::vector<Entry> &entries);
+
+	/// Map `file` into memory and call `fn` for every entry that is still valid at `now`
+	///
+	/// Returns the number of entries passed to `fn`. Throws if the file cannot be
+	/// opened or is not a valid snapshot.
+	static std::size_t load(const std::string &file, Clock::time_point now,
+		const std::function<void(const Entry &)> &fn);
+};
+
+#endif // PATH_SNAPSHOT_HXX_GUARD_
@@ -0,0 +1,106 @@
+#ifndef PATH_SOURCE_HXX_GUARD_
+#define PATH_SOURCE_HXX_GUARD_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace grpc {
+class Channel;
+}
+
+/// Forwarding information and metadata of a single SCION path
+///
+/// Independent of where the path was obtained from. Metadata a source cannot
+/// provide is left empty or zero.
+struct PathInfo {
+	/// Interface of an AS on the path
+	struct Interface {
+		std::uint64_t ia;
+		std::uint64_t ifid;
+	};
+
+	std::uint64_t src = 0;
+	std::uint64_t dst = 0;
+	/// Raw standard SCION path, empty for AS-internal paths
+	std::vector<std::uint8_t> dp;
+	/// Address of the first border router, IPv4 addresses are IPv4-mapped
+	std::array<std::uint8_t, 16> nextHop = {};
+	std::uint16_t nextHopPort = 0;
+
+	/// Path MTU, 0 if unknown
+	std::uint16_t mtu = 0;
+	std::chrono::system_clock::time_point expiry = std::chrono::system_clock::time_point::max();
+	/// Interfaces along the path in traversal order
+	std::vector<Interface> interfaces;
+	/// Advertised latency between consecutive interfaces, negative if unknown
+	std::vector<std::chrono::microseconds> latency;
+	/// Advertised bandwidth between consecutive interfaces in kbit/s, 0 if unknown
+	std::vector<std::uint64_t> bandwidth;
+};
+
+using PathInfoVec = std::vector<PathInfo>;
+
+/// Source of paths for the PathService
+class PathSource {
+    public:
+	virtual ~PathSource() = default;
+
+	/// Establish a connection to the source
+	///
+	/// Returns false if the source is not available, may be called again to retry.
+	virtual bool connect() = 0;
+
+	/// Look up paths to the destination ISD-AS
+	///
+	/// Returns an empty list if there are no paths and nothing if the source
+	/// could not be reached, connect() must be called again then. Must be safe
+	/// to call from multiple threads at once.
+	virtual std::optional<PathInfoVec> query(std::uint64_t dst) = 0;
+};
+
+/// Obtains paths from the SCION daemon
+///
+/// Uses the gRPC API of the daemon, which also provides the latency and
+/// bandwidth metadata of the paths.
+class DaemonPathSource : public PathSource {
+    public:
+	/// sciondAddr: address of the daemon (IP:port)
+	explicit DaemonPathSource(const std::string &sciondAddr);
+
+	bool connect() override;
+	std::optional<PathInfoVec> query(std::uint64_t dst) override;
+
+    private:
+	std::string sciondAddr;
+	std::shared_ptr<grpc::Channel> channel;
+	// ISD-AS of the local AS, reported by the daemon
+	std::uint64_t localIA = 0;
+};
+
+/// Serves paths from a text file
+///
+/// Intended for tests and static setups without a SCION daemon. Each line
+/// describes one path, lines starting with '#' are ignored:
+/// ```
+/// <dst ISD-AS> <src ISD-AS> <next hop [IPv6]:port> <MTU> <expiry Unix time> <raw path in hex or "-">
+///     [<latency in us per link, comma separated> [<bandwidth in kbit/s per link, comma separated>]]
+/// ```
+/// The file is read once by connect().
+class FilePathSource : public PathSource {
+    public:
+	explicit FilePathSource(const std::string &file);
+
+	bool connect() override;
+	std::optional<PathInfoVec> query(std::uint64_t dst) override;
+
+    private:
+	std::string file;
+	std::vector<PathInfo> paths;
+};
+
+#endif // PATH_SOURCE_HXX_GUARD_
@@ -0,0 +1,93 @@
+#ifndef PATH_TABLE_HXX_GUARD_
+#define PATH_TABLE_HXX_GUARD_
+
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <memory>
+#include <unordered_map>
+
+#include "bpf/scion_types.h"
+#include "bpf/scion.h"
+
+#include "Address.hxx"
+#include "PathSource.hxx"
+
+/// Userspace mirror of the Path Cache including the path metadata
+///
+/// The table has a single writer, the PathService, which publishes a new
+/// immutable snapshot once per batch of changes. Readers on any thread obtain
+/// the latest snapshot with a single atomic load and keep it alive as long as
+/// they hold on to it, without locks shared with the writer and without
+/// syscalls.
+///
+/// Destinations are spread over SHARDS shards. Publishing copies only the
+/// shards changed since the last publish, the others are shared with the
+/// previous snapshot.
+class PathTable {
+    public:
+	/// Path installed for a destination
+	struct Entry {
+		PathInfo path;
+		/// Time the path was installed
+		std::chrono::system_clock::time_point installed;
+	};
+
+	static constexpr std::size_t SHARDS = 256;
+
+	using Shard = std::unordered_map<scion_addr, std::shared_ptr<const Entry>>;
+
+	/// Contents of the table at the time of a publish()
+	class Snapshot {
+	    public:
+		/// Entry of `addr`, nullptr if there is none
+		std::shared_ptr<const Entry> find(scion_addr addr) const;
+
+		/// Number of destinations
+		std::size_t size() const;
+
+		/// Call `fn(addr, entry)` for every destination
+		template <typename Fn>
+		void forEach(Fn &&fn) const
+		{
+			for (const auto &shard : shards) {
+				for (const auto &[addr, entry] : *shard)
+					fn(addr, *entry);
+			}
+		}
+
+	    private:
+		friend class PathTable;
+		std::array<std::shared_ptr<const Shard>, SHARDS> shards;
+	};
+
+	PathTable();
+
+	/// Latest published contents, safe to call from any thread
+	std::shared_ptr<const Snapshot> snapshot() const { return current.load(std::memory_order_acquire); }
+
+	/// Look up a single destination in the latest published contents
+	std::shared_ptr<const Entry> find(scion_addr addr) const { return snapshot()->find(addr); }
+
+	/// Record `path` as installed for `addr`, visible after the next publish()
+	void set(scion_addr addr, const PathInfo &path);
+
+	/// Remove `addr`, visible after the next publish()
+	void erase(scion_addr addr);
+
+	/// Make all changes since the last call visible to readers
+	void publish();
+
+	/// Unpublished entry of `addr`, only for the writer
+	std::shared_ptr<const Entry> pending(scion_addr addr) const;
+
+    private:
+	static std::size_t shardOf(scion_addr addr) { return std::hash<scion_addr>()(addr) % SHARDS; }
+
+	std::array<Shard, SHARDS> working;
+	std::bitset<SHARDS> dirty;
+	std::atomic<std::shared_ptr<const Snapshot>> current;
+};
+
+#endif // PATH_TABLE_HXX_GUARD_
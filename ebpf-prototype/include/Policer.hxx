@@ -0,0 +1,109 @@
+#ifndef POLICER_HXX_GUARD_
+#define POLICER_HXX_GUARD_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bpf.h"
+
+#include "bpf/scion_types.h"
+#include "bpf/scion.h"
+
+#include "Address.hxx"
+
+/// Rate limit of a destination
+struct RateLimit {
+	/// Rate in bytes per second
+	std::uint64_t rate = 0;
+	/// Burst size in bytes
+	std::uint64_t burst = 0;
+};
+
+/// Configures the rate limits of the egress program and reconciles its per-CPU token buckets
+///
+/// The egress program polices each destination with one token bucket per CPU,
+/// so that the fast path needs no atomics. The configured rate is split into
+/// per-CPU shares, which are periodically redistributed according to the
+/// traffic each CPU saw for the destination since the last round. Every CPU
+/// keeps a small reserve of the rate, so that a flow moving to another CPU is
+/// not dropped until the next round. The reserve is bounded in absolute terms
+/// and relative to the rate, a flow on a single CPU gets at least
+/// 1 - 1 / RESERVE_DIVISOR of the rate.
+class Policer {
+    public:
+	/// Interval between two reconciliation rounds
+	static constexpr auto RECONCILE_INTERVAL = std::chrono::milliseconds(100);
+	/// Interval the drop counters are logged in, if they changed
+	static constexpr auto REPORT_INTERVAL = std::chrono::seconds(10);
+	/// Smallest per-CPU burst, so that a share can always pass a few full-sized packets
+	static constexpr std::uint64_t MIN_BURST = 64 * 1024;
+	/// Largest reserve of a CPU in bytes per second, enough to refill MIN_BURST within a few seconds
+	static constexpr std::uint64_t MAX_RESERVE = 16 * 1000;
+	/// The reserves of all CPUs together are at most this fraction of the rate
+	static constexpr std::uint64_t RESERVE_DIVISOR = 20;
+
+	Policer(struct bpf_map *cfgMap, struct bpf_map *stateMap, struct bpf_map *dropMap);
+
+	/// Limit the traffic to `dst` to `limit`
+	///
+	/// Returns false if the map could not be updated.
+	bool set(scion_addr dst, RateLimit limit);
+
+	/// Remove the rate limit of `dst`
+	void erase(scion_addr dst);
+
+	/// Replace all rate limits with the ones in `file`
+	///
+	/// The file contains one destination per line, the ISD-AS followed by the
+	/// rate in bit/s and the burst size in bytes, both with an optional k, M
+	/// or G suffix (powers of 1000), and optionally the hexadecimal subnet ID:
+	/// ```
+	/// # dst          rate   burst  [subnet]
+	/// 1-ff00:0:110   100M   1M
+	/// ```
+	/// Empty lines and lines starting with '#' are ignored. Throws if the file
+	/// cannot be read. Returns the number of rate limits.
+	std::size_t load(const std::string &file);
+
+	/// Move the unused shares of the rate limits to the CPUs that need them
+	void reconcile();
+
+	/// Per-CPU shares of `limit` given the bytes offered on each CPU in the last round
+	///
+	/// The shares add up to the rate, each CPU gets its reserve plus the rest
+	/// of the rate in proportion to its demand. Requires a non-zero demand.
+	static std::vector<struct police_share> shares(RateLimit limit, const std::vector<std::uint64_t> &demand);
+
+	/// Number of packets the egress program dropped, indexed by enum drop_reason
+	std::array<std::uint64_t, DROP_REASONS> drops();
+
+	/// Reconcile and report drops until a stop is requested
+	void run(std::stop_token stop);
+
+    private:
+	struct Limit {
+		RateLimit limit;
+		/// Bytes offered per CPU at the last round
+		std::vector<std::uint64_t> offered;
+	};
+
+	/// Write the per-CPU shares of `dst`
+	bool writeShares(scion_addr dst, const std::vector<struct police_share> &shares);
+
+	struct bpf_map *cfgMap;
+	struct bpf_map *stateMap;
+	struct bpf_map *dropMap;
+	int ncpus;
+
+	/// Protects limits, load() may be called from another thread than run()
+	std::mutex mutex;
+	std::unordered_map<scion_addr, Limit> limits;
+};
+
+#endif // POLICER_HXX_GUARD_
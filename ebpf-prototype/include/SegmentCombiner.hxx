@@ -0,0 +1,65 @@
+#ifndef SEGMENT_COMBINER_HXX_GUARD_
+#define SEGMENT_COMBINER_HXX_GUARD_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "PathSource.hxx"
+
+/// Path segment as registered at the control service
+///
+/// The AS entries are in construction direction, i.e. the first entry
+/// belongs to the core AS that originated the beacon.
+struct PathSegment {
+	enum class Type { Up, Core, Down };
+
+	struct HopField {
+		std::uint16_t ingress;
+		std::uint16_t egress;
+		std::uint8_t expTime;
+		std::array<std::uint8_t, 6> mac;
+	};
+
+	struct ASEntry {
+		std::uint64_t ia;
+		/// Internal MTU of the AS
+		std::uint16_t mtu;
+		/// MTU of the link at the ingress interface
+		std::uint16_t ingressMtu;
+		HopField hop;
+		/// Static info by interface ID, see StaticInfoExtension
+		///
+		/// Intra-AS values are between the egress interface and the given
+		/// interface, inter-AS values for the link at the given interface.
+		std::unordered_map<std::uint64_t, std::chrono::microseconds> intraLatency, interLatency;
+		std::unordered_map<std::uint64_t, std::uint64_t> intraBandwidth, interBandwidth;
+	};
+
+	Type type;
+	/// Creation time in seconds since the Unix epoch
+	std::uint32_t timestamp;
+	std::uint16_t segId;
+	std::vector<ASEntry> entries;
+
+	/// AS the segment is entered at when building a path
+	std::uint64_t start() const { return type == Type::Down ? entries.front().ia : entries.back().ia; }
+
+	/// AS the segment is left at when building a path
+	std::uint64_t end() const { return type == Type::Down ? entries.back().ia : entries.front().ia; }
+};
+
+/// Combine path segments to end-to-end paths from `src` to `dst`
+///
+/// Up and core segments are traversed against, down segments in construction
+/// direction. Up to one segment of each type is used, shortcuts and peering
+/// links are not considered. Paths visiting an AS twice are discarded, as are
+/// duplicates of paths with the same interfaces.
+///
+/// The next hop of the returned paths is left empty, it is the border router
+/// of the first interface on the path.
+PathInfoVec combineSegments(std::uint64_t src, std::uint64_t dst, const std::vector<PathSegment> &segments);
+
+#endif // SEGMENT_COMBINER_HXX_GUARD_
@@ -0,0 +1,86 @@
+#include <charconv>
+#include <sstream>
+
+#include "Address.hxx"
+
+// Must come after the UAPI headers included by the BPF headers above,
+// otherwise glibc's definition of in6_addr takes precedence.
+#include <arpa/inet.h>
+
+static constexpr unsigned ASN_BITS = 48;
+static constexpr std::uint64_t MAX_BGP_ASN = (1ull << 32) - 1;
+static constexpr std::uint64_t ASN_MASK = (1ull << ASN_BITS) - 1;
+
+std::optional<std::uint64_t> parseIsdAsn(std::string_view raw)
+{
+	auto dash = raw.find('-');
+	if (dash == std::string_view::npos)
+		return std::nullopt;
+	auto isdStr = raw.substr(0, dash), asnStr = raw.substr(dash + 1);
+
+	std::uint64_t isd = 0;
+	auto res = std::from_chars(isdStr.data(), isdStr.data() + isdStr.size(), isd, 10);
+	if (isdStr.empty() || res.ptr != isdStr.data() + isdStr.size() || isd > 0xFFFF)
+		return std::nullopt;
+
+	// BGP-style decimal ASN
+	std::uint64_t asn = 0;
+	res = std::from_chars(asnStr.data(), asnStr.data() + asnStr.size(), asn, 10);
+	if (!asnStr.empty() && res.ptr == asnStr.data() + asnStr.size()) {
+		if (asn > MAX_BGP_ASN)
+			return std::nullopt;
+		return (isd << ASN_BITS) | asn;
+	}
+
+	// SCION-style ASN in three hexadecimal groups
+	asn = 0;
+	for (int i = 0; i < 3; ++i) {
+		auto colon = asnStr.find(':');
+		bool last = (i == 2);
+		if (last != (colon == std::string_view::npos))
+			return std::nullopt; // too few or too many groups
+		auto group = asnStr.substr(0, colon);
+		std::uint64_t value = 0;
+		res = std::from_chars(group.data(), group.data() + group.size(), value, 16);
+		if (group.empty() || group.size() > 4 || res.ptr != group.data() + group.size())
+			return std::nullopt;
+		asn = (asn << 16) | value;
+		if (!last)
+			asnStr.remove_prefix(colon + 1);
+	}
+	return (isd << ASN_BITS) | asn;
+}
+
+std::string formatIsdAsn(std::uint64_t ia)
+{
+	std::stringstream stream;
+	std::uint64_t asn = ia & ASN_MASK;
+	stream << (ia >> ASN_BITS) << '-';
+	if (asn <= MAX_BGP_ASN) {
+		stream << asn;
+	} else {
+		stream << std::hex << ((asn >> 32) & 0xFFFF) << ':' << ((asn >> 16) & 0xFFFF) << ':'
+		       << (asn & 0xFFFF);
+	}
+	return stream.str();
+}
+
+bool parseUnderlay(std::string_view raw, std::array<std::uint8_t, 16> &addr, std::uint16_t &port)
+{
+	auto colon = raw.rfind(':');
+	if (colon == std::string_view::npos)
+		return false;
+	auto host = raw.substr(0, colon), portStr = raw.substr(colon + 1);
+	auto res = std::from_chars(portStr.data(), portStr.data() + portStr.size(), port);
+	if (portStr.empty() || res.ptr != portStr.data() + portStr.size())
+		return false;
+
+	if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+		std::string ip(host.substr(1, host.size() - 2));
+		return inet_pton(AF_INET6, ip.c_str(), addr.data()) == 1;
+	}
+	std::string ip(host);
+	addr = {};
+	addr[10] = addr[11] = 0xff;
+	return inet_pton(AF_INET, ip.c_str(), addr.data() + 12) == 1;
+}
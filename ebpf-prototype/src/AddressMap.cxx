@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include "libbpf.h"
+#include "Address.hxx"
+#include "AddressMap.hxx"
+
+// Must come after the UAPI headers included by the BPF headers above,
+// otherwise glibc's definition of in6_addr takes precedence.
+#include <arpa/inet.h>
+
+static struct addr_map_key toKey(const AddressMap::Prefix &prefix)
+{
+	struct addr_map_key key = {};
+	key.prefixlen = prefix.second;
+	std::memcpy(&key.addr, prefix.first.data(), sizeof(key.addr));
+	return key;
+}
+
+static bool hasHost(const struct addr_map_entry &entry)
+{
+	static const struct in6_addr unspecified = {};
+	return std::memcmp(&entry.host, &unspecified, sizeof(unspecified)) != 0;
+}
+
+static struct addr_rmap_key toReverseKey(const struct addr_map_entry &entry)
+{
+	struct addr_rmap_key key = {};
+	key.ia = entry.ia;
+	key.host = entry.host;
+	return key;
+}
+
+AddressMap::AddressMap(struct bpf_map *map, struct bpf_map *reverse)
+	: map(map)
+	, reverse(reverse)
+{
+}
+
+bool AddressMap::set(const Prefix &prefix, std::uint64_t ia, const std::array<std::uint8_t, 16> &host)
+{
+	auto key = toKey(prefix);
+	struct addr_map_entry entry = {};
+	entry.ia = ia;
+	std::memcpy(&entry.host, host.data(), sizeof(entry.host));
+
+	// The reverse translation must be unique
+	if (hasHost(entry) && prefix.second != 128) {
+		std::cerr << "Could not insert address mapping: host address for a prefix that is not /128\n";
+		return false;
+	}
+
+	int err = bpf_map__update_elem(map, &key, sizeof(key), &entry, sizeof(entry), BPF_ANY);
+	if (err) {
+		std::cerr << "Could not insert address mapping: " << strerror(-err) << "\n";
+		return false;
+	}
+	auto current = entries.find(prefix);
+	if (current != entries.end())
+		eraseReverse(prefix, current->second);
+	entries[prefix] = entry;
+
+	if (reverse && hasHost(entry)) {
+		auto rkey = toReverseKey(entry);
+		err = bpf_map__update_elem(reverse, &rkey, sizeof(rkey), prefix.first.data(), prefix.first.size(),
+			BPF_ANY);
+		if (err)
+			std::cerr << "Could not insert reverse address mapping: " << strerror(-err) << "\n";
+	}
+	return true;
+}
+
+void AddressMap::erase(const Prefix &prefix)
+{
+	auto key = toKey(prefix);
+	bpf_map__delete_elem(map, &key, sizeof(key), 0);
+	auto current = entries.find(prefix);
+	if (current != entries.end()) {
+		eraseReverse(prefix, current->second);
+		entries.erase(current);
+	}
+}
+
+void AddressMap::eraseReverse(const Prefix &prefix, const struct addr_map_entry &entry)
+{
+	if (!reverse || !hasHost(entry))
+		return;
+	// The host may have moved to another prefix already
+	auto rkey = toReverseKey(entry);
+	std::array<std::uint8_t, 16> addr;
+	if (bpf_map__lookup_elem(reverse, &rkey, sizeof(rkey), addr.data(), addr.size(), 0) == 0
+		&& addr == prefix.first)
+		bpf_map__delete_elem(reverse, &rkey, sizeof(rkey), 0);
+}
+
+bool AddressMap::parsePrefix(const std::string &raw, Prefix &prefix)
+{
+	auto slash = raw.find('/');
+	if (slash == std::string::npos)
+		return false;
+	auto addr = raw.substr(0, slash), len = raw.substr(slash + 1);
+
+	unsigned int bits = 0;
+	auto res = std::from_chars(len.data(), len.data() + len.size(), bits);
+	if (len.empty() || res.ptr != len.data() + len.size() || bits > 128)
+		return false;
+	if (inet_pton(AF_INET6, addr.c_str(), prefix.first.data()) != 1)
+		return false;
+
+	// Normalize, so that the same prefix always has the same key
+	for (unsigned int i = 0; i < prefix.first.size(); ++i) {
+		if (bits >= 8 * (i + 1))
+			continue;
+		prefix.first[i] &= bits > 8 * i ? std::uint8_t(0xFF << (8 - (bits - 8 * i))) : 0;
+	}
+	prefix.second = bits;
+	return true;
+}
+
+std::size_t AddressMap::load(const std::string &file)
+{
+	std::ifstream in(file);
+	if (!in)
+		throw std::runtime_error("Could not open address map " + file);
+
+	std::map<Prefix, std::pair<std::uint64_t, std::array<std::uint8_t, 16>>> mappings;
+	// SCION addresses of the mapped hosts, replies are translated back by them
+	std::set<std::pair<std::uint64_t, std::array<std::uint8_t, 16>>> hosts;
+	std::string line;
+	for (unsigned lineNo = 1; std::getline(in, line); ++lineNo) {
+		std::stringstream stream(line);
+		std::string rawPrefix, rawIa, rawHost;
+		Prefix prefix;
+		std::array<std::uint8_t, 16> host = {};
+
+		if (!(stream >> rawPrefix) || rawPrefix.front() == '#')
+			continue;
+		stream >> rawIa >> rawHost;
+
+		auto ia = parseIsdAsn(rawIa);
+		bool valid = parsePrefix(rawPrefix, prefix) && ia
+			&& (rawHost.empty() || inet_pton(AF_INET6, rawHost.c_str(), host.data()) == 1);
+		if (!valid) {
+			std::cerr << file << ":" << lineNo << ": invalid address mapping\n";
+			continue;
+		}
+		// Would never be used, SCION-mapped addresses are decoded directly
+		if (prefix.second >= 8 && prefix.first[0] == SCION_MAPPING_PREFIX)
+			std::cerr << file << ":" << lineNo << ": " << rawPrefix << " is SCION-mapped, ignored\n";
+		else if (!rawHost.empty() && prefix.second != 128)
+			std::cerr << file << ":" << lineNo << ": host address " << rawHost << " requires a /128 prefix, ignored\n";
+		else if (!rawHost.empty() && !hosts.emplace(*ia, host).second)
+			std::cerr << file << ":" << lineNo << ": host address " << rawHost << " already mapped, ignored\n";
+		else
+			mappings[prefix] = { *ia, host };
+	}
+
+	// Remove stale prefixes first, the remaining ones are updated in place
+	for (auto it = entries.begin(); it != entries.end();) {
+		auto next = std::next(it);
+		if (!mappings.contains(it->first))
+			erase(it->first);
+		it = next;
+	}
+
+	std::size_t count = 0;
+	for (const auto &[prefix, mapping] : mappings) {
+		auto current = entries.find(prefix);
+		if (current != entries.end() && current->second.ia == mapping.first
+			&& std::memcmp(&current->second.host, mapping.second.data(), mapping.second.size()) == 0) {
+			++count;
+			continue;
+		}
+		if (set(prefix, mapping.first, mapping.second))
+			++count;
+	}
+	return count;
+}
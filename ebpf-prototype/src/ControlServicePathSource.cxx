@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include <google/protobuf/util/json_util.h>
+#include <grpcpp/create_channel.h>
+
+#include "proto/control_plane/v1/seg.pb.h"
+#include "proto/crypto/v1/signed.pb.h"
+#include "proto/topology.pb.h"
+
+#include "Address.hxx"
+#include "ControlServicePathSource.hxx"
+#include "GrpcCall.hxx"
+
+using namespace std::chrono_literals;
+namespace cp = proto::control_plane::v1;
+
+static constexpr auto CONNECT_TIMEOUT = 1s;
+// Lookups of core and down segments may be forwarded to remote control services
+static constexpr auto LOOKUP_TIMEOUT = 1s;
+
+static constexpr std::uint64_t ISD_MASK = 0xFFFFull << 48;
+
+/// Convert a segment received from the control service, returns nothing if it is malformed
+static std::optional<PathSegment> decodeSegment(PathSegment::Type type, const cp::PathSegment &raw)
+{
+	cp::SegmentInformation info;
+	if (!info.ParseFromString(raw.segment_info()))
+		return std::nullopt;
+
+	PathSegment seg = {
+		.type = type,
+		.timestamp = static_cast<std::uint32_t>(info.timestamp()),
+		.segId = static_cast<std::uint16_t>(info.segment_id()),
+		.entries = {},
+	};
+	for (const auto &rawEntry : raw.as_entries()) {
+		proto::crypto::v1::HeaderAndBodyInternal signedPart;
+		cp::ASEntrySignedBody body;
+		if (!signedPart.ParseFromString(rawEntry.signed_().header_and_body())
+			|| !body.ParseFromString(signedPart.body()))
+			return std::nullopt;
+
+		const auto &hf = body.hop_entry().hop_field();
+		if (hf.mac().size() != 6)
+			return std::nullopt;
+		PathSegment::ASEntry entry = {
+			.ia = body.isd_as(),
+			.mtu = static_cast<std::uint16_t>(std::min<std::uint32_t>(body.mtu(), UINT16_MAX)),
+			.ingressMtu = static_cast<std::uint16_t>(std::min<std::uint32_t>(body.hop_entry().ingress_mtu(), UINT16_MAX)),
+			.hop = {
+				.ingress = static_cast<std::uint16_t>(hf.ingress()),
+				.egress = static_cast<std::uint16_t>(hf.egress()),
+				.expTime = static_cast<std::uint8_t>(hf.exp_time()),
+				.mac = {},
+			},
+			.intraLatency = {},
+			.interLatency = {},
+			.intraBandwidth = {},
+			.interBandwidth = {},
+		};
+		std::copy_n(hf.mac().begin(), 6, entry.hop.mac.begin());
+
+		const auto &staticInfo = body.extensions().static_info();
+		for (auto [ifid, us] : staticInfo.latency().intra())
+			entry.intraLatency[ifid] = std::chrono::microseconds(us);
+		for (auto [ifid, us] : staticInfo.latency().inter())
+			entry.interLatency[ifid] = std::chrono::microseconds(us);
+		for (auto [ifid, kbps] : staticInfo.bandwidth().intra())
+			entry.intraBandwidth[ifid] = kbps;
+		for (auto [ifid, kbps] : staticInfo.bandwidth().inter())
+			entry.interBandwidth[ifid] = kbps;
+		seg.entries.push_back(std::move(entry));
+	}
+	return seg;
+}
+
+/// Parse a topology.json, returns false if it cannot be read
+static bool readTopology(const std::string &file, loader::topology::Topology &topo)
+{
+	std::ifstream in(file);
+	if (!in) {
+		std::cerr << "Could not open topology " << file << "\n";
+		return false;
+	}
+	std::stringstream json;
+	json << in.rdbuf();
+
+	google::protobuf::util::JsonParseOptions options;
+	options.ignore_unknown_fields = true;
+	if (!google::protobuf::util::JsonStringToMessage(json.str(), &topo, options).ok()) {
+		std::cerr << "Invalid topology " << file << "\n";
+		return false;
+	}
+	return true;
+}
+
+ControlServicePathSource::ControlServicePathSource(const std::string &topologyFile)
+	: topologyFile(topologyFile)
+{
+}
+
+bool ControlServicePathSource::connect()
+{
+	loader::topology::Topology topo;
+	if (!readTopology(topologyFile, topo))
+		return false;
+	auto ia = parseIsdAsn(topo.isd_as());
+	if (!ia || topo.control_service().empty()) {
+		std::cerr << "Invalid topology " << topologyFile << "\n";
+		return false;
+	}
+	localIA = *ia;
+	core = std::find(topo.attributes().begin(), topo.attributes().end(), "core") != topo.attributes().end();
+
+	routers.clear();
+	for (const auto &[name, br] : topo.border_routers()) {
+		Router router;
+		if (!parseUnderlay(br.internal_addr(), router.addr, router.port)) {
+			std::cerr << "Invalid address of border router " << name << " in " << topologyFile << "\n";
+			continue;
+		}
+		for (const auto &[ifid, _] : br.interfaces())
+			routers[ifid] = router;
+	}
+
+	// All instances of the control service are equivalent
+	const auto &addr = topo.control_service().begin()->second.addr();
+	channel = grpc::CreateChannel(addr, grpc::InsecureChannelCredentials());
+	if (!channel->WaitForConnected(std::chrono::system_clock::now() + CONNECT_TIMEOUT)) {
+		std::cerr << "Could not reach control service at " << addr << "\n";
+		return false;
+	}
+	return true;
+}
+
+std::vector<std::array<std::uint8_t, 16>> ControlServicePathSource::borderRouters(const std::string &topologyFile)
+{
+	loader::topology::Topology topo;
+	if (!readTopology(topologyFile, topo))
+		throw std::runtime_error("Could not read border routers from " + topologyFile);
+
+	std::vector<std::array<std::uint8_t, 16>> addrs;
+	for (const auto &[name, br] : topo.border_routers()) {
+		std::array<std::uint8_t, 16> addr;
+		std::uint16_t port;
+		if (parseUnderlay(br.internal_addr(), addr, port))
+			addrs.push_back(addr);
+	}
+	return addrs;
+}
+
+std::future<std::optional<std::vector<PathSegment>>> ControlServicePathSource::lookup(std::uint64_t src,
+	std::uint64_t dst)
+{
+	auto call = std::make_unique<GrpcCall<cp::SegmentsRequest, cp::SegmentsResponse>>();
+	call->request.set_src_isd_as(src);
+	call->request.set_dst_isd_as(dst);
+	auto status = call->start(channel, "/proto.control_plane.v1.SegmentLookupService/Segments", LOOKUP_TIMEOUT);
+
+	// The response is decoded by the thread waiting for it, the lookups run in parallel anyway
+	return std::async(std::launch::deferred, [src, dst, call = std::move(call), status = std::move(status)]() mutable
+		-> std::optional<std::vector<PathSegment>> {
+		std::vector<PathSegment> segments;
+		if (auto result = status.get(); !result.ok()) {
+			std::cerr << "Segment lookup " << formatIsdAsn(src) << " -> " << formatIsdAsn(dst) << " failed ("
+				  << result.error_message() << ")\n";
+			if (isUnreachable(result))
+				return std::nullopt;
+			return segments;
+		}
+		for (const auto &[type, segs] : call->response.segments()) {
+			PathSegment::Type segType;
+			switch (type) {
+			case cp::SEGMENT_TYPE_UP:
+				segType = PathSegment::Type::Up;
+				break;
+			case cp::SEGMENT_TYPE_CORE:
+				segType = PathSegment::Type::Core;
+				break;
+			case cp::SEGMENT_TYPE_DOWN:
+				segType = PathSegment::Type::Down;
+				break;
+			default:
+				continue;
+			}
+			for (const auto &raw : segs.segments()) {
+				if (auto seg = decodeSegment(segType, raw))
+					segments.push_back(std::move(*seg));
+			}
+		}
+		return segments;
+	});
+}
+
+std::optional<PathInfoVec> ControlServicePathSource::query(std::uint64_t dst)
+{
+	// Paths within the local AS depend on the destination host, the Path Cache cannot hold them
+	if (dst == localIA)
+		return PathInfoVec();
+
+	std::vector<PathSegment> segments;
+	bool unreachable = false;
+	auto collect = [&segments, &unreachable](std::future<std::optional<std::vector<PathSegment>>> &future) {
+		auto segs = future.get();
+		if (!segs) {
+			unreachable = true;
+			return;
+		}
+		std::move(segs->begin(), segs->end(), std::back_inserter(segments));
+	};
+
+	// Up and down segments are independent of each other
+	std::future<std::optional<std::vector<PathSegment>>> ups;
+	if (!core)
+		ups = lookup(localIA, localIA & ISD_MASK);
+	auto downs = lookup(dst & ISD_MASK, dst);
+	if (ups.valid())
+		collect(ups);
+	collect(downs);
+
+	// Core segments connect the core ASes reached by the up and down segments
+	std::set<std::uint64_t> from, to;
+	if (core)
+		from.insert(localIA);
+	for (const auto &seg : segments) {
+		if (seg.type == PathSegment::Type::Up)
+			from.insert(seg.end());
+		else if (seg.type == PathSegment::Type::Down)
+			to.insert(seg.start());
+	}
+	// Without down segments the destination is a core AS itself
+	if (to.empty())
+		to.insert(dst);
+	std::vector<std::future<std::optional<std::vector<PathSegment>>>> cores;
+	for (auto a : from) {
+		for (auto b : to) {
+			if (a != b)
+				cores.push_back(lookup(a, b));
+		}
+	}
+	for (auto &future : cores)
+		collect(future);
+
+	auto paths = combineSegments(localIA, dst, segments);
+	std::erase_if(paths, [&](PathInfo &path) {
+		auto router = routers.find(path.interfaces.front().ifid);
+		if (router == routers.end())
+			return true;
+		path.nextHop = router->second.addr;
+		path.nextHopPort = router->second.port;
+		return false;
+	});
+	// Missing segments would only make the destination look unreachable
+	if (paths.empty() && unreachable)
+		return std::nullopt;
+	if (paths.empty())
+		std::cerr << "No path for " << formatIsdAsn(dst) << " found\n";
+	return paths;
+}
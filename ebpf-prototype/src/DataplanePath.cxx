@@ -0,0 +1,84 @@
+#include <algorithm>
+
+#include "DataplanePath.hxx"
+
+static constexpr std::size_t PATH_META_LEN = 4;
+static constexpr std::size_t INFO_FIELD_LEN = 8;
+static constexpr std::size_t HOP_FIELD_LEN = 12;
+// Unit of the relative hop field expiration time (24 h / 256)
+static constexpr auto EXP_TIME_UNIT = std::chrono::milliseconds(337'500);
+
+static std::uint16_t read16(const std::uint8_t *p)
+{
+	return (std::uint16_t)(p[0] << 8) | p[1];
+}
+
+static std::uint32_t read32(const std::uint8_t *p)
+{
+	return ((std::uint32_t)p[0] << 24) | ((std::uint32_t)p[1] << 16) | ((std::uint32_t)p[2] << 8) | p[3];
+}
+
+std::size_t DecodedPath::infoIndex(std::size_t hop) const
+{
+	std::size_t info = 0;
+	for (std::size_t end = segLen[0]; info < 2 && hop >= end; end += segLen[++info])
+		;
+	return info;
+}
+
+std::chrono::system_clock::time_point DecodedPath::expiry() const
+{
+	auto expiry = std::chrono::system_clock::time_point::max();
+	for (std::size_t i = 0; i < hops.size(); ++i) {
+		auto ts = std::chrono::system_clock::time_point(std::chrono::seconds(infos[infoIndex(i)].timestamp));
+		expiry = std::min(expiry, ts + (1 + hops[i].expTime) * EXP_TIME_UNIT);
+	}
+	return expiry;
+}
+
+std::optional<DecodedPath> decodePath(std::span<const std::uint8_t> raw)
+{
+	DecodedPath path;
+	if (raw.empty())
+		return path;
+	if (raw.size() < PATH_META_LEN)
+		return std::nullopt;
+
+	auto meta = read32(raw.data());
+	path.segLen[0] = (meta >> 12) & 0x3f;
+	path.segLen[1] = (meta >> 6) & 0x3f;
+	path.segLen[2] = meta & 0x3f;
+
+	// Segments must be filled from the front, no segment may follow an empty one
+	std::size_t numInf = 0, numHops = 0;
+	for (std::size_t i = 0; i < path.segLen.size(); ++i) {
+		if (path.segLen[i] == 0)
+			continue;
+		if (numInf != i)
+			return std::nullopt;
+		++numInf;
+		numHops += path.segLen[i];
+	}
+	if (numInf == 0)
+		return std::nullopt;
+	if (raw.size() != PATH_META_LEN + numInf * INFO_FIELD_LEN + numHops * HOP_FIELD_LEN)
+		return std::nullopt;
+
+	auto p = raw.data() + PATH_META_LEN;
+	for (std::size_t i = 0; i < numInf; ++i, p += INFO_FIELD_LEN) {
+		path.infos.push_back({
+			.consDir = (p[0] & 0x01) != 0,
+			.peering = (p[0] & 0x02) != 0,
+			.segId = read16(p + 2),
+			.timestamp = read32(p + 4),
+		});
+	}
+	for (std::size_t i = 0; i < numHops; ++i, p += HOP_FIELD_LEN) {
+		path.hops.push_back({
+			.expTime = p[1],
+			.consIngress = read16(p + 2),
+			.consEgress = read16(p + 4),
+		});
+	}
+	return path;
+}
@@ -6,6 +6,7 @@
 #include <string>
 
 #include "libbpf.h"
+#include "bpf/scion_mapping.h"
 #include "EgressLoader.hxx"
 
 EgressLoader::EgressLoader()
@@ -47,18 +48,70 @@ void EgressLoader::attach(const std::string &interface)
 	this->attach(index);
 }
 
-void EgressLoader::attach(const unsigned int interfaceIndex)
+void EgressLoader::open()
 {
-	int err;
-
-	tc_hook->ifindex = interfaceIndex;
+	if (tc_skel)
+		return;
 
-	// Load bpf object code
-	tc_skel = egress_bpf__open_and_load();
+	tc_skel = egress_bpf__open();
 	if (!tc_skel) {
 		std::cerr << "Failed to open BPF skeleton\n";
+		throw std::runtime_error("Egress program open");
+	}
+}
+
+void EgressLoader::load()
+{
+	if (loaded)
+		return;
+
+	open();
+	tc_skel->rodata->subnet_bits = subnetBits;
+	tc_skel->rodata->use_addr_map = useAddressMap;
+	tc_skel->rodata->use_policing = usePolicing;
+
+	// Load bpf object code
+	int err = egress_bpf__load(tc_skel);
+	if (err) {
+		std::cerr << "Failed to load BPF skeleton: " << strerror(-err) << "\n";
 		throw std::runtime_error("Egress program load");
 	}
+	loaded = true;
+}
+
+void EgressLoader::shareReplyMap(struct bpf_map *replyMap)
+{
+	int err = bpf_map__reuse_fd(tc_skel->maps.reply_map, bpf_map__fd(replyMap));
+	if (err) {
+		std::cerr << "Failed to share reply path map: " << strerror(-err) << "\n";
+		throw std::runtime_error("Egress map reuse");
+	}
+}
+
+void EgressLoader::setSubnetBits(unsigned int bits)
+{
+	if (bits > SCION_MAPPING_MAX_SUBNET_BITS)
+		throw std::invalid_argument("Subnet ID too long");
+	subnetBits = bits;
+}
+
+void EgressLoader::enableAddressMap()
+{
+	useAddressMap = true;
+}
+
+void EgressLoader::enablePolicing()
+{
+	usePolicing = true;
+}
+
+void EgressLoader::attach(const unsigned int interfaceIndex)
+{
+	int err;
+
+	tc_hook->ifindex = interfaceIndex;
+
+	load();
 
 	// Create TC hook
 	err = bpf_tc_hook_create(tc_hook.get());
@@ -92,3 +145,44 @@ struct bpf_map *EgressLoader::requestQueue()
 {
   return tc_skel->maps.path_req;
 }
+
+struct bpf_map *EgressLoader::pathStats()
+{
+	return tc_skel->maps.path_stats;
+}
+
+struct bpf_map *EgressLoader::negativeCache()
+{
+	return tc_skel->maps.neg_map;
+}
+
+struct bpf_map *EgressLoader::addressMap()
+{
+	return tc_skel->maps.addr_map;
+}
+
+struct bpf_map *EgressLoader::policeConfig()
+{
+	return tc_skel->maps.police_cfg;
+}
+
+struct bpf_map *EgressLoader::policeState()
+{
+	return tc_skel->maps.police_state;
+}
+
+struct bpf_map *EgressLoader::dropStats()
+{
+	return tc_skel->maps.drop_stats;
+}
+
+void EgressLoader::setCaptureRate(std::uint32_t rate)
+{
+	// The .bss section is shared with the running program
+	tc_skel->bss->capture_rate = rate;
+}
+
+struct bpf_map *EgressLoader::captureBuffer()
+{
+	return tc_skel->maps.capture;
+}
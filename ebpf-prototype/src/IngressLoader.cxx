@@ -6,6 +6,7 @@
 #include <string>
 
 #include "libbpf.h"
+#include "bpf/scion_mapping.h"
 #include "IngressLoader.hxx"
 
 IngressLoader::IngressLoader()
@@ -30,15 +31,64 @@ void IngressLoader::attach(const std::string &interface)
 
 void IngressLoader::attach(const unsigned int interfaceIndex)
 {
-	xdp_skel = ingress_bpf__open_and_load();
+	xdp_skel = ingress_bpf__open();
 	if (!xdp_skel) {
 		std::cerr << "Failed to open ingress BPF skeleton\n";
 		throw std::runtime_error("Ingress load error");
 	}
 
+	xdp_skel->rodata->subnet_bits = subnetBits;
+	int err = ingress_bpf__load(xdp_skel);
+	if (err) {
+		std::cerr << "Failed to load ingress BPF skeleton: " << strerror(-err) << "\n";
+		throw std::runtime_error("Ingress load error");
+	}
+
 	// Attach bpf program to interface
 	if(!bpf_program__attach_xdp(xdp_skel->progs.scion_ingress, interfaceIndex)) {
     std::cerr << "Failed to attach eBPF program to XDP: " << strerror(errno) << "\n";
     throw std::runtime_error("Ingress attach error");
   }
 }
+
+void IngressLoader::setSubnetBits(unsigned int bits)
+{
+	if (bits > SCION_MAPPING_MAX_SUBNET_BITS)
+		throw std::invalid_argument("Subnet ID too long");
+	subnetBits = bits;
+}
+
+void IngressLoader::trustRouter(const std::array<std::uint8_t, 16> &addr)
+{
+	std::uint8_t trusted = 1;
+	int err = bpf_map__update_elem(xdp_skel->maps.trusted_routers, addr.data(), addr.size(), &trusted,
+		sizeof(trusted), BPF_ANY);
+	if (err)
+		throw std::runtime_error(std::string("Could not trust border router: ") + strerror(-err));
+}
+
+struct bpf_map *IngressLoader::scmpEvents()
+{
+	return xdp_skel->maps.scmp_events;
+}
+
+struct bpf_map *IngressLoader::replyMap()
+{
+	return xdp_skel->maps.reply_map;
+}
+
+struct bpf_map *IngressLoader::addressReverseMap()
+{
+	return xdp_skel->maps.addr_rmap;
+}
+
+void IngressLoader::setCaptureRate(std::uint32_t rate)
+{
+	// The .bss section is shared with the running program
+	xdp_skel->bss->capture_rate = rate;
+}
+
+struct bpf_map *IngressLoader::captureBuffer()
+{
+	return xdp_skel->maps.capture;
+}
@@ -0,0 +1,89 @@
+#include <algorithm>
+
+#include "DataplanePath.hxx"
+#include "InterfaceIndex.hxx"
+
+/// Call `fn(ia, ingress, egress)` for every AS on `path`
+///
+/// Interfaces not present (e.g. ingress of the first AS) are 0, unknown ISD-AS are 0.
+template <typename Fn>
+static void forEachHop(const PathInfo &path, Fn &&fn)
+{
+	// Interface metadata lists the egress and ingress interface of each link
+	if (!path.interfaces.empty()) {
+		const auto &ifs = path.interfaces;
+		fn(ifs.front().ia, 0, ifs.front().ifid);
+		for (std::size_t i = 1; i + 1 < ifs.size(); i += 2)
+			fn(ifs[i].ia, ifs[i].ifid, ifs[i + 1].ifid);
+		fn(ifs.back().ia, ifs.back().ifid, 0);
+		return;
+	}
+
+	auto decoded = decodePath(path.dp);
+	if (!decoded)
+		return;
+	for (std::size_t i = 0; i < decoded->hops.size(); ++i) {
+		const auto &hop = decoded->hops[i];
+		std::uint64_t ia = 0;
+		if (i == 0)
+			ia = path.src;
+		else if (i + 1 == decoded->hops.size())
+			ia = path.dst;
+		fn(ia, hop.consIngress, hop.consEgress);
+	}
+}
+
+void InterfaceIndex::add(scion_addr dst, const PathInfo &path)
+{
+	auto &keys = byDestination[dst];
+	forEachHop(path, [&](std::uint64_t ia, std::uint64_t ingress, std::uint64_t egress) {
+		if (ia == 0)
+			return;
+		for (auto ifid : { ingress, egress }) {
+			if (ifid == 0)
+				continue;
+			Key key{ ia, ifid };
+			if (byInterface[key].insert(dst).second)
+				keys.push_back(key);
+		}
+	});
+}
+
+void InterfaceIndex::remove(scion_addr dst)
+{
+	auto keys = byDestination.find(dst);
+	if (keys == byDestination.end())
+		return;
+
+	for (const auto &key : keys->second) {
+		auto dsts = byInterface.find(key);
+		dsts->second.erase(dst);
+		if (dsts->second.empty())
+			byInterface.erase(dsts);
+	}
+	byDestination.erase(keys);
+}
+
+std::vector<scion_addr> InterfaceIndex::lookup(std::uint64_t ia, std::uint64_t ifid) const
+{
+	auto it = byInterface.find(Key{ ia, ifid });
+	if (it == byInterface.end())
+		return {};
+	std::vector<scion_addr> dsts(it->second.begin(), it->second.end());
+	std::sort(dsts.begin(), dsts.end());
+	return dsts;
+}
+
+bool InterfaceIndex::traverses(const PathInfo &path, std::uint64_t ia, std::uint64_t ifid, std::uint64_t egress)
+{
+	bool found = false;
+	forEachHop(path, [&](std::uint64_t hopIa, std::uint64_t in, std::uint64_t out) {
+		if (found || hopIa == 0 || hopIa != ia)
+			return;
+		if (egress == 0)
+			found = in == ifid || out == ifid;
+		else
+			found = (in == ifid && out == egress) || (in == egress && out == ifid);
+	});
+	return found;
+}
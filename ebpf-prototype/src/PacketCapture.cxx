@@ -0,0 +1,169 @@
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "PacketCapture.hxx"
+
+// pcapng block types and options, see https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-01.html
+static constexpr std::uint32_t SECTION_HEADER_BLOCK = 0x0A0D0D0A;
+static constexpr std::uint32_t INTERFACE_DESCRIPTION_BLOCK = 1;
+static constexpr std::uint32_t ENHANCED_PACKET_BLOCK = 6;
+static constexpr std::uint32_t BYTE_ORDER_MAGIC = 0x1A2B3C4D;
+static constexpr std::uint16_t LINKTYPE_ETHERNET = 1;
+static constexpr std::uint16_t OPT_END = 0;
+static constexpr std::uint16_t OPT_COMMENT = 1;
+static constexpr std::uint16_t OPT_IF_NAME = 2;
+static constexpr std::uint16_t OPT_IF_TSRESOL = 9;
+
+// Interface names of the capture points, in the order of enum capture_point
+static const char *const CAPTURE_POINT_NAMES[CAPTURE_POINTS] = {
+	"egress-before",
+	"egress-after",
+	"ingress-before",
+	"ingress-after",
+};
+
+/// Builds a pcapng block in host byte order
+class Block {
+    public:
+	explicit Block(std::uint32_t type)
+	{
+		put(type);
+		put(std::uint32_t(0)); // length, filled in by finish()
+	}
+
+	template <typename T>
+	void put(T value)
+	{
+		auto bytes = reinterpret_cast<const std::uint8_t *>(&value);
+		data.insert(data.end(), bytes, bytes + sizeof(value));
+	}
+
+	/// Append raw bytes, padded to 32 bits
+	void putPadded(const void *bytes, std::size_t len)
+	{
+		auto begin = static_cast<const std::uint8_t *>(bytes);
+		data.insert(data.end(), begin, begin + len);
+		data.resize((data.size() + 3) & ~std::size_t(3), 0);
+	}
+
+	void option(std::uint16_t code, const void *value, std::uint16_t len)
+	{
+		put(code);
+		put(len);
+		putPadded(value, len);
+	}
+
+	void option(std::uint16_t code, std::string_view value)
+	{
+		option(code, value.data(), std::uint16_t(value.size()));
+	}
+
+	/// Write the block with its length to `out`
+	void finish(std::ofstream &out)
+	{
+		auto len = std::uint32_t(data.size() + sizeof(std::uint32_t));
+		std::memcpy(data.data() + sizeof(std::uint32_t), &len, sizeof(len));
+		put(len);
+		out.write(reinterpret_cast<const char *>(data.data()), data.size());
+	}
+
+    private:
+	std::vector<std::uint8_t> data;
+};
+
+static std::int64_t toNs(const struct timespec &ts)
+{
+	return std::int64_t(ts.tv_sec) * 1000 * 1000 * 1000 + ts.tv_nsec;
+}
+
+PacketCapture::PacketCapture(const std::string &file)
+	: out(file, std::ios::binary | std::ios::trunc)
+{
+	if (!out)
+		throw std::runtime_error("Could not open capture file " + file);
+
+	struct timespec realtime, monotonic;
+	clock_gettime(CLOCK_REALTIME, &realtime);
+	clock_gettime(CLOCK_MONOTONIC, &monotonic);
+	epochOffset = toNs(realtime) - toNs(monotonic);
+
+	Block shb(SECTION_HEADER_BLOCK);
+	shb.put(BYTE_ORDER_MAGIC);
+	shb.put(std::uint16_t(1)); // major version
+	shb.put(std::uint16_t(0)); // minor version
+	shb.put(std::int64_t(-1)); // section length not known
+	shb.finish(out);
+
+	for (auto name : CAPTURE_POINT_NAMES) {
+		Block idb(INTERFACE_DESCRIPTION_BLOCK);
+		idb.put(LINKTYPE_ETHERNET);
+		idb.put(std::uint16_t(0)); // reserved
+		idb.put(std::uint32_t(CAPTURE_SNAPLEN));
+		idb.option(OPT_IF_NAME, name);
+		std::uint8_t resolution = 9; // timestamps in ns
+		idb.option(OPT_IF_TSRESOL, &resolution, sizeof(resolution));
+		idb.option(OPT_END, nullptr, 0);
+		idb.finish(out);
+	}
+	out.flush();
+}
+
+PacketCapture::~PacketCapture()
+{
+	if (buffers)
+		ring_buffer__free(buffers);
+}
+
+void PacketCapture::watch(struct bpf_map *captureMap)
+{
+	int err;
+	if (!buffers) {
+		buffers = ring_buffer__new(bpf_map__fd(captureMap), handler, this, NULL);
+		err = buffers ? 0 : -errno;
+	} else {
+		err = ring_buffer__add(buffers, bpf_map__fd(captureMap), handler, this);
+	}
+	if (err < 0)
+		throw std::runtime_error("Could not listen for captured packets");
+}
+
+int PacketCapture::poll(int timeoutMs)
+{
+	if (!buffers)
+		return 0;
+	int count = ring_buffer__poll(buffers, timeoutMs);
+	out.flush();
+	return count;
+}
+
+int PacketCapture::handler(void *ctx, void *data, std::size_t size)
+{
+	if (size < sizeof(struct capture_record))
+		return 0;
+	static_cast<PacketCapture *>(ctx)->write(*static_cast<const struct capture_record *>(data));
+	return 0;
+}
+
+void PacketCapture::write(const struct capture_record &record)
+{
+	if (record.point >= CAPTURE_POINTS || record.caplen == 0 || record.caplen > CAPTURE_SNAPLEN)
+		return;
+
+	auto timestamp = std::uint64_t(epochOffset + std::int64_t(record.timestamp));
+	auto comment = "packet " + std::to_string(record.cpu) + ":" + std::to_string(record.id);
+
+	Block epb(ENHANCED_PACKET_BLOCK);
+	epb.put(std::uint32_t(record.point)); // interface ID
+	epb.put(std::uint32_t(timestamp >> 32));
+	epb.put(std::uint32_t(timestamp));
+	epb.put(record.caplen);
+	epb.put(record.len);
+	epb.putPadded(record.data, record.caplen);
+	epb.option(OPT_COMMENT, comment);
+	epb.option(OPT_END, nullptr, 0);
+	epb.finish(out);
+}
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <endian.h>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+#include "bpf/scion_mapping.h"
+
+#include "DataplanePath.hxx"
+#include "PathProber.hxx"
+
+// Must come after the UAPI headers included by the BPF headers above,
+// otherwise glibc's definition of in6_addr takes precedence.
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// SCMP traceroute, see https://docs.scion.org/en/latest/protocols/scmp.html
+static constexpr std::uint8_t SCMP_TRACEROUTE_REQUEST = 130;
+static constexpr std::uint8_t SCMP_TRACEROUTE_REPLY = 131;
+// Type, code, checksum, identifier, sequence number, ISD-AS and interface
+static constexpr std::size_t SCMP_TRACEROUTE_LEN = 24;
+
+static constexpr std::size_t PATH_META_LEN = 4;
+static constexpr std::size_t INFO_FIELD_LEN = 8;
+static constexpr std::size_t HOP_FIELD_LEN = 12;
+
+/// One's complement sum over `len` bytes in network order
+static std::uint32_t csumAdd(std::uint32_t sum, const std::uint8_t *data, std::size_t len)
+{
+	for (std::size_t i = 0; i + 1 < len; i += 2)
+		sum += (data[i] << 8) | data[i + 1];
+	if (len & 1)
+		sum += data[len - 1] << 8;
+	return sum;
+}
+
+static std::uint16_t csumFold(std::uint32_t sum)
+{
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return ~sum;
+}
+
+PathProber::PathProber(const ProbeConfig &config, PathRanking &ranking)
+	: cfg(config)
+	, ranking(ranking)
+	, id(std::random_device()())
+	, tokens(config.rate)
+	, lastRefill(Clock::now())
+{
+}
+
+PathProber::~PathProber()
+{
+	if (sendFd >= 0)
+		close(sendFd);
+	if (recvFd >= 0)
+		close(recvFd);
+}
+
+void PathProber::open()
+{
+	sendFd = socket(AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	if (sendFd < 0)
+		throw std::runtime_error(std::string("Could not open probe socket: ") + strerror(errno));
+
+	// Replies arrive as IPv6 packets with SCMP as next header once translated by the ingress program
+	recvFd = socket(AF_INET6, SOCK_RAW | SOCK_NONBLOCK, SC_PROTO_SCMP);
+	if (recvFd < 0)
+		throw std::runtime_error(std::string("Could not open SCMP socket: ") + strerror(errno));
+
+	// Kernel receive timestamps keep the RTT independent of how often poll() is called
+	int on = 1;
+	if (setsockopt(recvFd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0)
+		throw std::runtime_error(std::string("Could not enable timestamps: ") + strerror(errno));
+}
+
+/// Whether `addr` is a SCION-mapped address of `ia`
+static bool isMapped(const std::array<std::uint8_t, 16> &addr, std::uint64_t ia)
+{
+	std::uint64_t hi = 0;
+	for (int i = 0; i < 8; ++i)
+		hi = (hi << 8) | addr[i];
+	return addr[0] == SCION_MAPPING_PREFIX && scion_mapping_ia(hi) == ia;
+}
+
+const PathProber::Address *PathProber::sourceFor(const Address &router, std::uint64_t localIA)
+{
+	auto it = sources.find(router);
+	if (it != sources.end())
+		return it->second ? &*it->second : nullptr;
+
+	// Let the kernel pick the source address by connecting a throwaway socket
+	std::optional<Address> source;
+	int fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return nullptr;
+	struct sockaddr_in6 addr = {};
+	addr.sin6_family = AF_INET6;
+	addr.sin6_port = htons(9);
+	std::memcpy(&addr.sin6_addr, router.data(), router.size());
+	socklen_t len = sizeof(addr);
+	bool ok = connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0
+		&& getsockname(fd, (struct sockaddr *)&addr, &len) == 0;
+	close(fd);
+	if (!ok)
+		return nullptr;
+	source.emplace();
+	std::memcpy(source->data(), &addr.sin6_addr, source->size());
+
+	// Replies to other addresses are not translated by the ingress program, fall
+	// back to any SCION-mapped address of the local AS. IPv4 underlays cannot be
+	// probed at all.
+	if (!isMapped(*source, localIA)) {
+		static constexpr std::uint8_t V4_MAPPED[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff };
+		bool ipv4 = std::equal(V4_MAPPED, V4_MAPPED + sizeof(V4_MAPPED), router.begin());
+		source.reset();
+		struct ifaddrs *ifas = nullptr;
+		if (!ipv4 && getifaddrs(&ifas) == 0) {
+			for (auto ifa = ifas; ifa; ifa = ifa->ifa_next) {
+				if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != AF_INET6)
+					continue;
+				Address candidate;
+				std::memcpy(candidate.data(), &((struct sockaddr_in6 *)ifa->ifa_addr)->sin6_addr,
+					candidate.size());
+				if (isMapped(candidate, localIA)) {
+					source = candidate;
+					break;
+				}
+			}
+			freeifaddrs(ifas);
+		}
+		if (!source) {
+			char str[INET6_ADDRSTRLEN];
+			inet_ntop(AF_INET6, router.data(), str, sizeof(str));
+			std::cerr << "No SCION-mapped address to probe paths via " << str
+				  << " from, replies would not reach the prober\n";
+		}
+	}
+	// Failures are cached as well to warn only once per router
+	auto &cached = sources.emplace(router, source).first->second;
+	return cached ? &*cached : nullptr;
+}
+
+bool PathProber::probe(scion_addr dst, const PathInfo &path)
+{
+	auto now = Clock::now();
+	tokens = std::min<double>(cfg.rate,
+		tokens + cfg.rate * std::chrono::duration<double>(now - lastRefill).count());
+	lastRefill = now;
+	if (tokens < 1)
+		return false;
+
+	// Intra-AS paths have no border router to answer
+	auto decoded = decodePath(path.dp);
+	if (!decoded || decoded->hops.empty())
+		return true;
+	auto src = sourceFor(path.nextHop, path.src);
+	if (!src)
+		return false;
+
+	const std::size_t hdrLen = sizeof(struct scionhdr) + 2 * 16 + path.dp.size();
+	buffer.assign(hdrLen + SCMP_TRACEROUTE_LEN, 0);
+
+	// Common and address header
+	auto hdr = reinterpret_cast<struct scionhdr *>(buffer.data());
+	hdr->ver_qos_flow = htonl(1);
+	hdr->next = SC_PROTO_SCMP;
+	hdr->len = hdrLen / 4;
+	hdr->payload = htons(SCMP_TRACEROUTE_LEN);
+	hdr->type = SC_PATH_TYPE_SCION;
+	SC_SET_DT(hdr, SC_ADDR_TYPE_IP);
+	SC_SET_DL(hdr, 0x3);
+	SC_SET_ST(hdr, SC_ADDR_TYPE_IP);
+	SC_SET_SL(hdr, 0x3);
+	hdr->dst.dst = htobe64(path.dst);
+	hdr->src.src = htobe64(path.src);
+	// The destination host is left unspecified, the probe never leaves the border router
+	auto hosts = buffer.data() + sizeof(struct scionhdr);
+	std::memcpy(hosts + 16, src->data(), src->size());
+
+	// Raise the router alert on the last hop field, in the direction it is entered
+	auto raw = hosts + 2 * 16;
+	std::memcpy(raw, path.dp.data(), path.dp.size());
+	auto last = decoded->hops.size() - 1;
+	auto info = decoded->infoIndex(last);
+	auto hf = reinterpret_cast<struct hopfield *>(
+		raw + PATH_META_LEN + decoded->infos.size() * INFO_FIELD_LEN + last * HOP_FIELD_LEN);
+	if (decoded->infos[info].consDir)
+		HF_SET_I_ALERT(hf, 1);
+	else
+		HF_SET_E_ALERT(hf, 1);
+
+	// SCMP traceroute request
+	auto scmp = buffer.data() + hdrLen;
+	auto probeSeq = seq++;
+	scmp[0] = SCMP_TRACEROUTE_REQUEST;
+	scmp[4] = id >> 8;
+	scmp[5] = id & 0xff;
+	scmp[6] = probeSeq >> 8;
+	scmp[7] = probeSeq & 0xff;
+
+	// Checksum over the pseudo header (addresses, length, next header) and the message
+	std::uint8_t lenNext[8] = { 0, 0, 0, SCMP_TRACEROUTE_LEN, 0, 0, 0, SC_PROTO_SCMP };
+	auto sum = csumAdd(0, buffer.data() + offsetof(struct scionhdr, dst), 16);
+	sum = csumAdd(sum, hosts, 2 * 16);
+	sum = csumAdd(sum, lenNext, sizeof(lenNext));
+	sum = csumAdd(sum, scmp, SCMP_TRACEROUTE_LEN);
+	auto csum = csumFold(sum);
+	scmp[2] = csum >> 8;
+	scmp[3] = csum & 0xff;
+
+	struct sockaddr_in6 router = {};
+	router.sin6_family = AF_INET6;
+	router.sin6_port = htons(path.nextHopPort);
+	std::memcpy(&router.sin6_addr, path.nextHop.data(), path.nextHop.size());
+
+	// The underlay source must be the mapped address as well, the reply is sent back to it
+	struct iovec iov = { buffer.data(), buffer.size() };
+	char control[CMSG_SPACE(sizeof(struct in6_pktinfo))] = {};
+	struct msghdr msg = {};
+	msg.msg_name = &router;
+	msg.msg_namelen = sizeof(router);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	auto cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = IPPROTO_IPV6;
+	cmsg->cmsg_type = IPV6_PKTINFO;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(struct in6_pktinfo));
+	struct in6_pktinfo pktinfo = {};
+	std::memcpy(&pktinfo.ipi6_addr, src->data(), src->size());
+	std::memcpy(CMSG_DATA(cmsg), &pktinfo, sizeof(pktinfo));
+
+	now = Clock::now();
+	if (sendmsg(sendFd, &msg, 0) < 0) {
+		std::cerr << "Could not send probe: " << strerror(errno) << "\n";
+		return false;
+	}
+	tokens -= 1;
+	outstanding[probeSeq] = { dst, PathRanking::fingerprint(path), now };
+	return true;
+}
+
+void PathProber::poll(std::vector<scion_addr> &updated)
+{
+	std::uint8_t data[256];
+	char control[CMSG_SPACE(sizeof(struct timespec))];
+
+	while (true) {
+		struct iovec iov = { data, sizeof(data) };
+		struct msghdr msg = {};
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		auto n = recvmsg(recvFd, &msg, 0);
+		if (n < 0)
+			break;
+		if (n < (ssize_t)SCMP_TRACEROUTE_LEN || data[0] != SCMP_TRACEROUTE_REPLY)
+			continue;
+		if (((data[4] << 8) | data[5]) != id)
+			continue;
+		auto probe = outstanding.find((data[6] << 8) | data[7]);
+		if (probe == outstanding.end())
+			continue;
+
+		auto received = Clock::now();
+		for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+				struct timespec ts;
+				std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+				received = Clock::time_point(std::chrono::duration_cast<Clock::duration>(
+					std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec)));
+			}
+		}
+
+		update(probe->second.fingerprint,
+			std::chrono::duration_cast<std::chrono::microseconds>(received - probe->second.sent));
+		updated.push_back(probe->second.dst);
+		outstanding.erase(probe);
+	}
+
+	// Unanswered probes count as lost
+	auto now = Clock::now();
+	for (auto it = outstanding.begin(); it != outstanding.end();) {
+		if (now - it->second.sent < cfg.timeout) {
+			++it;
+			continue;
+		}
+		update(it->second.fingerprint, std::nullopt);
+		updated.push_back(it->second.dst);
+		it = outstanding.erase(it);
+	}
+}
+
+void PathProber::update(std::uint64_t fingerprint, std::optional<std::chrono::microseconds> rtt)
+{
+	auto &est = estimates.try_emplace(fingerprint, Estimate{ 0, 0, false }).first->second;
+
+	if (rtt) {
+		est.rtt = est.replied ? (1 - cfg.alpha) * est.rtt + cfg.alpha * rtt->count() : rtt->count();
+		est.replied = true;
+		est.loss = (1 - cfg.alpha) * est.loss;
+	} else {
+		// Without any reply yet, the timeout is the best guess for the RTT
+		if (!est.replied)
+			est.rtt = std::chrono::microseconds(cfg.timeout).count();
+		est.loss = (1 - cfg.alpha) * est.loss + cfg.alpha;
+	}
+
+	ranking.measured(fingerprint, { std::chrono::microseconds(static_cast<long>(est.rtt)), est.loss });
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#include "Address.hxx"
+#include "PathRanking.hxx"
+
+// Offset basis and prime of the 64-bit FNV-1a hash
+static constexpr std::uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+static constexpr std::uint64_t FNV_PRIME = 0x100000001b3ull;
+
+static std::uint64_t fnv1a(std::uint64_t hash, std::uint64_t value)
+{
+	for (int i = 0; i < 8; ++i) {
+		hash ^= (value >> (i * 8)) & 0xff;
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+/// Number of hop fields of a raw standard SCION path, read from the PathMeta header
+static unsigned hopCount(const std::vector<std::uint8_t> &dp)
+{
+	if (dp.size() < 4)
+		return 0;
+	std::uint32_t meta = (dp[0] << 24) | (dp[1] << 16) | (dp[2] << 8) | dp[3];
+	return (meta & 0x3f) + ((meta >> 6) & 0x3f) + ((meta >> 12) & 0x3f);
+}
+
+void PathRanking::setPolicy(std::uint64_t dst, int tc, const RankingPolicy &policy)
+{
+	if (dst == ANY_DST && tc == ANY_CLASS)
+		defaultPolicy = policy;
+	else
+		policies[{ dst, tc }] = policy;
+}
+
+const RankingPolicy &PathRanking::policy(std::uint64_t dst, int tc) const
+{
+	if (policies.empty())
+		return defaultPolicy;
+	for (const auto &key : { std::pair{ dst, tc }, { dst, ANY_CLASS }, { ANY_DST, tc } }) {
+		auto it = policies.find(key);
+		if (it != policies.end())
+			return it->second;
+	}
+	return defaultPolicy;
+}
+
+void PathRanking::loadPolicies(const std::string &file)
+{
+	std::ifstream in(file);
+	if (!in)
+		throw std::runtime_error("Could not open policy file " + file);
+
+	PathRanking loaded;
+	std::string line;
+	for (unsigned lineNo = 1; std::getline(in, line); ++lineNo) {
+		auto error = [&](const std::string &msg) {
+			return std::runtime_error(file + ":" + std::to_string(lineNo) + ": " + msg);
+		};
+
+		std::istringstream fields(line);
+		std::string dstField, tcField;
+		if (!(fields >> dstField) || dstField[0] == '#')
+			continue;
+		if (!(fields >> tcField))
+			throw error("missing traffic class");
+
+		std::uint64_t dst = ANY_DST;
+		if (dstField != "*") {
+			auto ia = parseIsdAsn(dstField);
+			if (!ia)
+				throw error("invalid ISD-AS " + dstField);
+			dst = *ia;
+		}
+		int tc = ANY_CLASS;
+		if (tcField != "*") {
+			auto end = tcField.data() + tcField.size();
+			auto [ptr, ec] = std::from_chars(tcField.data(), end, tc);
+			if (ec != std::errc() || ptr != end || tc < 0 || tc > 63)
+				throw error("invalid traffic class " + tcField);
+		}
+
+		// Weights not given fall back to the built-in defaults
+		RankingPolicy policy;
+		for (std::string weight; fields >> weight;) {
+			auto eq = weight.find('=');
+			if (eq == std::string::npos)
+				throw error("expected metric=weight, got " + weight);
+			auto name = weight.substr(0, eq);
+			double value = 0;
+			auto end = weight.data() + weight.size();
+			auto [ptr, ec] = std::from_chars(weight.data() + eq + 1, end, value);
+			if (ec != std::errc() || ptr != end || !std::isfinite(value))
+				throw error("invalid weight for " + name);
+
+			if (name == "hops")
+				policy.hops = value;
+			else if (name == "mtu")
+				policy.mtu = value;
+			else if (name == "lifetime")
+				policy.lifetime = value;
+			else if (name == "latency")
+				policy.latency = value;
+			else if (name == "bandwidth")
+				policy.bandwidth = value;
+			else if (name == "rtt")
+				policy.rtt = value;
+			else if (name == "loss")
+				policy.loss = value;
+			else if (name == "minMtu") {
+				if (value < 0 || value > std::numeric_limits<std::uint16_t>::max())
+					throw error("invalid weight for " + name);
+				policy.minMtu = static_cast<std::uint16_t>(value);
+			} else if (name == "minLifetime") {
+				if (value < 0 || value > std::numeric_limits<std::int32_t>::max())
+					throw error("invalid weight for " + name);
+				policy.minLifetime = std::chrono::seconds(static_cast<long>(value));
+			} else {
+				throw error("unknown metric " + name);
+			}
+		}
+		loaded.setPolicy(dst, tc, policy);
+	}
+
+	defaultPolicy = loaded.defaultPolicy;
+	policies = std::move(loaded.policies);
+}
+
+std::optional<double> PathRanking::score(const PathInfo &path, const RankingPolicy &policy,
+	std::chrono::system_clock::time_point now) const
+{
+	using namespace std::chrono;
+
+	if (path.mtu != 0 && path.mtu < policy.minMtu)
+		return std::nullopt;
+	if (path.expiry < now + policy.minLifetime)
+		return std::nullopt;
+
+	double score = policy.hops * hopCount(path.dp);
+	if (path.mtu != 0)
+		score += policy.mtu * path.mtu;
+	if (path.expiry != system_clock::time_point::max())
+		score += policy.lifetime * duration<double, std::ratio<3600>>(path.expiry - now).count();
+
+	// Latency is only meaningful if known for the whole path
+	microseconds latency{ 0 };
+	bool latencyKnown = !path.latency.empty();
+	for (auto l : path.latency) {
+		if (l.count() < 0) {
+			latencyKnown = false;
+			break;
+		}
+		latency += l;
+	}
+	if (latencyKnown)
+		score += policy.latency * duration<double, std::milli>(latency).count();
+
+	// Bottleneck of the links with known bandwidth
+	std::uint64_t bandwidth = 0;
+	for (auto bw : path.bandwidth) {
+		if (bw != 0 && (bandwidth == 0 || bw < bandwidth))
+			bandwidth = bw;
+	}
+	if (bandwidth != 0)
+		score += policy.bandwidth * bandwidth / 1e6;
+
+	if (!measurements.empty()) {
+		auto it = measurements.find(fingerprint(path));
+		if (it != measurements.end()) {
+			score += policy.rtt * duration<double, std::milli>(it->second.rtt).count();
+			score += policy.loss * it->second.loss * 100;
+		}
+	}
+
+	return score;
+}
+
+std::optional<std::size_t> PathRanking::select(std::uint64_t dst, int tc, const PathInfoVec &paths,
+	std::chrono::system_clock::time_point now) const
+{
+	const auto &pol = policy(dst, tc);
+
+	std::optional<std::size_t> best;
+	double bestScore = 0;
+	std::uint64_t bestFingerprint = 0;
+	for (std::size_t i = 0; i < paths.size(); ++i) {
+		auto s = score(paths[i], pol, now);
+		if (!s)
+			continue;
+
+		auto fp = fingerprint(paths[i]);
+		if (!best || *s > bestScore || (*s == bestScore && fp < bestFingerprint)) {
+			best = i;
+			bestScore = *s;
+			bestFingerprint = fp;
+		}
+	}
+	return best;
+}
+
+void PathRanking::measured(std::uint64_t fingerprint, const PathMeasurement &measurement)
+{
+	measurements[fingerprint] = measurement;
+}
+
+std::uint64_t PathRanking::fingerprint(const PathInfo &path)
+{
+	auto hash = FNV_OFFSET;
+	if (path.interfaces.empty()) {
+		for (auto byte : path.dp)
+			hash = (hash ^ byte) * FNV_PRIME;
+		return hash;
+	}
+	for (const auto &iface : path.interfaces) {
+		hash = fnv1a(hash, iface.ia);
+		hash = fnv1a(hash, iface.ifid);
+	}
+	return hash;
+}
@@ -1,10 +1,18 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
 #include <cstddef>
 #include <cstring>
 #include <endian.h>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <memory>
-#include <snet/snet.hpp>
-#include <snet/snet_cdefs.h>
+#include <thread>
+#include <time.h>
+#include <unordered_map>
+#include <utility>
 
 #include "bpf.h"
 #include "libbpf.h"
@@ -12,10 +20,32 @@
 #include "bpf/scion_types.h"
 #include "bpf/scion.h"
 
+#include "Address.hxx"
 #include "PathService.hxx"
+#include "PathSnapshot.hxx"
 
 using namespace std::chrono_literals;
-using namespace scion;
+
+// Maximum number of destinations persisted in the hot set
+static constexpr std::size_t HOT_SET_SIZE = 1024;
+
+// Interval between attempts to reach the SCION daemon
+static constexpr auto RECONNECT_INTERVAL = 5s;
+// Queries in flight when refreshing the paths restored from a snapshot
+static constexpr unsigned REFRESH_CONCURRENCY = 16;
+
+// Time a destination without paths is not looked up again after the first failure,
+// doubled on every further failure up to NEGATIVE_TTL_MAX
+static constexpr auto NEGATIVE_TTL_MIN = 1s;
+static constexpr auto NEGATIVE_TTL_MAX = 5min;
+
+// Minimum time between two publishes of the path table, changes in between are
+// published together
+static constexpr auto PUBLISH_INTERVAL = 100ms;
+
+// Kernel-internal error code returned for unsupported map operations,
+// not exported by the UAPI headers.
+static constexpr int KERNEL_ENOTSUPP = 524;
 
 // TODO implement TrafficClasses
 //
@@ -25,10 +55,10 @@ using namespace scion;
 //
 //const TrafficClass TrafficClasses[] = {DefaultForwarding};
 
-/// Converts a Path object to path_map_entry for insertion to a BPF map
+/// Converts a PathInfo object to path_map_entry for insertion to a BPF map
 ///
 /// Returns a pointer to a dynamically allocated path_map_entry struct
-static std::unique_ptr<struct path_map_entry> pathToMapEntry(Path &path)
+static std::unique_ptr<struct path_map_entry> pathToMapEntry(const PathInfo &path)
 {
 	auto entry = std::make_unique<struct path_map_entry>();
 
@@ -63,25 +93,100 @@ static std::unique_ptr<struct path_map_entry> pathToMapEntry(Path &path)
 	entry->path_len = path.dp.size() / 4;
 
 	// Next Hop address
-	std::memcpy(entry->router_addr, path.nextHop.getIPv6().data(), path.nextHop.getIPv6().size());
-	entry->router_port = path.nextHop.getPort();
+	std::memcpy(entry->router_addr, path.nextHop.data(), path.nextHop.size());
+	entry->router_port = path.nextHopPort;
 
 	return entry;
 }
 
+/// Converts a path_map_entry back to a PathInfo object
+///
+/// Only the forwarding information is restored, metadata is left empty.
+static PathInfo mapEntryToPath(const struct path_map_entry &entry, std::chrono::system_clock::time_point expiry)
+{
+	PathInfo path;
+	path.dst = be64toh(entry.header.dst.dst);
+	path.src = be64toh(entry.header.src.src);
+	auto raw = reinterpret_cast<const std::uint8_t *>(entry.path);
+	path.dp.assign(raw, raw + 4 * entry.path_len);
+	std::memcpy(path.nextHop.data(), entry.router_addr, path.nextHop.size());
+	path.nextHopPort = entry.router_port;
+	path.expiry = expiry;
+	return path;
+}
+
+/// Read all entries of a BPF hash map using batched lookups
+///
+/// For per-CPU maps `valuesPerKey` must be the number of possible CPUs.
+/// Returns false if the map could not be read completely.
+template <typename Key, typename Value>
+static bool dumpMap(struct bpf_map *map, std::size_t valuesPerKey, std::vector<Key> &keys,
+	std::vector<Value> &values)
+{
+	constexpr __u32 BATCH_SIZE = 256;
+	LIBBPF_OPTS(bpf_map_batch_opts, opts);
+	__u32 batch = 0;
+	bool first = true;
+
+	keys.clear();
+	values.clear();
+	while (true) {
+		__u32 count = BATCH_SIZE;
+		auto offset = keys.size();
+		keys.resize(offset + BATCH_SIZE);
+		values.resize((offset + BATCH_SIZE) * valuesPerKey);
+
+		int err = bpf_map_lookup_batch(bpf_map__fd(map), first ? nullptr : &batch, &batch,
+			keys.data() + offset, values.data() + offset * valuesPerKey, &count, &opts);
+		first = false;
+		keys.resize(offset + count);
+		values.resize((offset + count) * valuesPerKey);
+
+		if (err < 0) {
+			// ENOENT signals the last (possibly partial) batch
+			if (errno == ENOENT)
+				return true;
+			std::cerr << "Could not read BPF map: " << strerror(errno) << "\n";
+			return false;
+		}
+	}
+}
+
 static int reqHandler(void *ctx, void *data, std::size_t data_sz)
 {
   const auto ps = static_cast<PathService *>(ctx);
-  const auto addr = *static_cast<std::uint32_t *>(data);
+  const auto addr = *static_cast<scion_addr *>(data);
+
+  // Without daemon connection requests cannot be served, they are repeated on the next miss
+  if (!ps->isConnected()) return 0;
 
+  // A failed query says nothing about the destination, it must not be negative cached
   auto paths = ps->getPaths(addr);
-  ps->insertPaths(addr, paths);
+  if (paths)
+    ps->insertPaths(addr, *paths);
 
   return 0;
 }
 
-PathService::PathService(struct bpf_map *pathCache, struct bpf_map *reqMap)
+static int scmpHandler(void *ctx, void *data, std::size_t data_sz)
+{
+  const auto ps = static_cast<PathService *>(ctx);
+  const auto event = static_cast<struct scmp_event *>(data);
+
+  std::cerr << "Interface " << event->ingress << " of " << formatIsdAsn(event->ia) << " is down\n";
+  if (event->type == SCMP_INT_CONN_DOWN)
+    ps->onInterfaceDown(event->ia, event->ingress, event->egress);
+  else
+    ps->onInterfaceDown(event->ia, event->ingress);
+
+  return 0;
+}
+
+PathService::PathService(struct bpf_map *pathCache, struct bpf_map *reqMap, struct bpf_map *statsMap,
+	struct bpf_map *negCache)
 	: pathCache(pathCache)
+	, statsMap(statsMap)
+	, negCache(negCache)
 {
   reqQueue = ring_buffer__new(bpf_map__fd(reqMap), reqHandler, this, NULL);
   if(!reqQueue) {
@@ -89,54 +194,511 @@ PathService::PathService(struct bpf_map *pathCache, struct bpf_map *reqMap)
   }
 }
 
-void PathService::init(std::string &sciondAddr)
+void PathService::init(std::unique_ptr<PathSource> source)
 {
-	Status status = hostCtx.init(sciondAddr.c_str(), 1s);
-	if (status != Status::Success)
-		throw std::runtime_error("Host context unitialization failed");
+	this->source = std::move(source);
+	if (!connect())
+		throw std::runtime_error("Path source unitialization failed");
+}
+
+bool PathService::connect()
+{
+	connected = source && source->connect();
+	return connected;
 }
 
 void PathService::run()
 {
 	//fillPathMap();
 
+  auto lastSave = std::chrono::steady_clock::now();
+  auto lastSnapshot = lastSave, lastConnect = lastSave, lastProbe = lastSave;
   while(true) {
+    // All requests drained in one poll are written with a single batch update
     ring_buffer__poll(reqQueue, 100 /*ms*/);
+    flush();
+
+    if (prober) {
+      std::vector<scion_addr> updated;
+      prober->poll(updated);
+      std::sort(updated.begin(), updated.end());
+      updated.erase(std::unique(updated.begin(), updated.end()), updated.end());
+      for (auto addr : updated)
+        reselect(addr);
+      flush();
+    }
+
+    if (topologyChanged.exchange(false)) {
+      std::cerr << "Topology changed, flushing Negative Path Cache\n";
+      clearNegativeCache();
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (prober && now - lastProbe > prober->config().interval) {
+      probeRound();
+      lastProbe = now;
+    }
+    if (connected && !restoredDests.empty())
+      refreshRestored();
+    if (!connected && now - lastConnect > RECONNECT_INTERVAL) {
+      // Destinations may have been negative cached because of the outage
+      if (connect()) {
+        std::cerr << "Connected to path source\n";
+        clearNegativeCache();
+      }
+      lastConnect = now;
+    }
+    if (!hotSetFile.empty() && now - lastSave > hotSetInterval) {
+      saveHotSet();
+      lastSave = now;
+    }
+    if (!snapshotFile.empty() && now - lastSnapshot > snapshotInterval) {
+      saveSnapshot();
+      lastSnapshot = now;
+    }
   }
 }
 
-PathVec PathService::getPaths(std::uint32_t daddr)
+std::optional<PathInfoVec> PathService::getPaths(scion_addr daddr)
 {
-	Status status;
-	PathVec paths;
-
-	IA dst{ (((std::uint64_t)daddr & 0xFFF00000) << 28) | (daddr & 0xFFFFF) };
-	std::tie(paths, status) = hostCtx.queryPaths(dst, SC_FLAG_PATH_GET_IFACES, 100ms);
-	if (status != Status::Success) {
-		std::cerr << "No path for " << dst << " found (" << status << ")\n";
-	}
-
+	auto paths = source->query(toIsdAsn(daddr));
+	if (!paths && connected.exchange(false))
+		std::cerr << "Lost connection to path source\n";
 	return paths;
 }
 
-void PathService::insertPaths(std::uint32_t addr, const scion::PathVec &paths)
+void PathService::insertPaths(scion_addr addr, const PathInfoVec &paths)
 {
-  int err;
   //auto items = std::views::iota(0b0, 0b111111);
-  if(paths.empty()) return;
+  // The Path Cache is not keyed by traffic class yet, so rank for DefaultForwarding only
+  auto best = pathRanking.select(toIsdAsn(addr), 0, paths, std::chrono::system_clock::now());
+  if(!best) {
+    insertNegative(addr);
+    return;
+  }
+  removeNegative(addr);
 
-    // TODO find best paths according to metric
-    // for now we just use the first path
   //for(const auto &item : items) {
     //auto key = (addr << 8) | (item << 2);
-    auto key = addr;
-    auto path = pathToMapEntry(*paths[0]);
-
-    err = bpf_map__update_elem(pathCache, &key, sizeof(key), path.get(), sizeof(*path), BPF_ANY);
-    if(err < 0) {
-      std::cerr << "Could not insert path to Path Cache\n";
-    }
+    install(addr, paths[*best]);
   //}
+  setCandidates(addr, paths);
+}
+
+void PathService::setCandidates(scion_addr addr, const PathInfoVec &paths)
+{
+	interfaceIndex.remove(addr);
+	for (const auto &path : paths)
+		interfaceIndex.add(addr, path);
+	candidates[addr] = paths;
+}
+
+void PathService::install(scion_addr addr, const PathInfo &path)
+{
+	pendingKeys.push_back(addr);
+	pendingValues.push_back(*pathToMapEntry(path));
+	pendingPaths.push_back(path);
+	installed[addr] = PathRanking::fingerprint(path);
+}
+
+void PathService::enableProbing(const ProbeConfig &config)
+{
+	prober = std::make_unique<PathProber>(config, pathRanking);
+	prober->open();
+}
+
+void PathService::evict(scion_addr addr)
+{
+	bpf_map__delete_elem(pathCache, &addr, sizeof(addr), 0);
+	pathTable.erase(addr);
+	installed.erase(addr);
+	candidates.erase(addr);
+	interfaceIndex.remove(addr);
+}
+
+void PathService::watchScmp(struct bpf_map *scmpEvents)
+{
+	if (ring_buffer__add(reqQueue, bpf_map__fd(scmpEvents), scmpHandler, this) < 0)
+		throw std::runtime_error("Could not listen for SCMP events");
+}
+
+void PathService::onInterfaceDown(std::uint64_t ia, std::uint64_t ifid, std::uint64_t egress)
+{
+	// Only destinations depending on the interface are touched
+	for (auto addr : interfaceIndex.lookup(ia, ifid)) {
+		auto paths = candidates[addr];
+		auto removed = std::erase_if(paths, [&](const PathInfo &path) {
+			return InterfaceIndex::traverses(path, ia, ifid, egress);
+		});
+		if (removed == 0)
+			continue;
+
+		setCandidates(addr, paths);
+		if (!pathRanking.select(toIsdAsn(addr), 0, paths, std::chrono::system_clock::now()))
+			evict(addr);
+		else
+			reselect(addr);
+	}
+	flush();
+}
+
+void PathService::probeRound()
+{
+	for (const auto &dst : hottest(prober->config().destinations)) {
+		auto paths = candidates.find(dst.addr);
+		if (paths == candidates.end())
+			continue;
+		for (const auto &path : paths->second) {
+			// Rate limit exhausted, continue in the next round
+			if (!prober->probe(dst.addr, path))
+				return;
+		}
+	}
+}
+
+void PathService::reselect(scion_addr addr)
+{
+	auto paths = candidates.find(addr);
+	if (paths == candidates.end())
+		return;
+
+	auto now = std::chrono::system_clock::now();
+	auto best = pathRanking.select(toIsdAsn(addr), 0, paths->second, now);
+	if (!best)
+		return;
+	auto fingerprint = PathRanking::fingerprint(paths->second[*best]);
+	if (installed[addr] == fingerprint)
+		return;
+
+	// Only switch if the gain is worth it, so that paths with similar scores do not flap
+	const auto &policy = pathRanking.policy(toIsdAsn(addr), 0);
+	const double hysteresis = prober ? prober->config().hysteresis : 0;
+	auto bestScore = *pathRanking.score(paths->second[*best], policy, now);
+	for (const auto &path : paths->second) {
+		if (PathRanking::fingerprint(path) != installed[addr])
+			continue;
+		auto current = pathRanking.score(path, policy, now);
+		if (current && bestScore - *current <= hysteresis)
+			return;
+		break;
+	}
+
+	install(addr, paths->second[*best]);
+}
+
+std::size_t PathService::flush()
+{
+	std::size_t written = 0;
+	if (!pendingKeys.empty() && batchSupported) {
+		LIBBPF_OPTS(bpf_map_batch_opts, opts, .elem_flags = BPF_ANY);
+		__u32 count = pendingKeys.size();
+		int err = bpf_map_update_batch(bpf_map__fd(pathCache), pendingKeys.data(),
+			pendingValues.data(), &count, &opts);
+		for (std::size_t i = 0; i < count; ++i)
+			pathTable.set(pendingKeys[i], pendingPaths[i]);
+		written = count;
+		if (err < 0) {
+			if (errno == EINVAL || errno == KERNEL_ENOTSUPP) {
+				// Kernel without batch support (< 5.6), fall back permanently
+				std::cerr << "Batched map updates not supported, using single updates\n";
+				batchSupported = false;
+				written += flushSingle(count);
+			} else {
+				std::cerr << "Batched Path Cache update failed after " << count << " entries: "
+					  << strerror(errno) << "\n";
+				// Skip the offending entry and continue with the rest
+				written += flushSingle(count + 1);
+			}
+		}
+	} else if (!pendingKeys.empty()) {
+		written = flushSingle(0);
+	}
+
+	pendingKeys.clear();
+	pendingValues.clear();
+	pendingPaths.clear();
+
+	// Evictions do not queue map updates but still change the table
+	auto now = std::chrono::steady_clock::now();
+	if (now - lastPublish >= PUBLISH_INTERVAL) {
+		pathTable.publish();
+		lastPublish = now;
+	}
+	return written;
+}
+
+void PathService::insertNegative(scion_addr addr)
+{
+	auto count = ++failures[addr];
+
+	// Back off exponentially, a destination that is unreachable now will likely stay so
+	std::chrono::seconds ttl = NEGATIVE_TTL_MAX;
+	if (count <= 16)
+		ttl = std::min<std::chrono::seconds>(NEGATIVE_TTL_MIN * (1u << (count - 1)), NEGATIVE_TTL_MAX);
+
+	// The BPF program compares against bpf_ktime_get_ns(), i.e. CLOCK_MONOTONIC
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	struct negative_entry entry = {
+		.expires = static_cast<__u64>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec
+			+ std::chrono::nanoseconds(ttl).count(),
+	};
+
+	int err = bpf_map__update_elem(negCache, &addr, sizeof(addr), &entry, sizeof(entry), BPF_ANY);
+	if (err < 0)
+		std::cerr << "Could not insert " << formatIsdAsn(toIsdAsn(addr))
+			  << " to Negative Path Cache\n";
+}
+
+void PathService::removeNegative(scion_addr addr)
+{
+	if (failures.erase(addr) == 0)
+		return;
+	bpf_map__delete_elem(negCache, &addr, sizeof(addr), 0);
+}
+
+void PathService::clearNegativeCache()
+{
+	for (const auto &[addr, _] : failures)
+		bpf_map__delete_elem(negCache, &addr, sizeof(addr), 0);
+	failures.clear();
+}
+
+std::size_t PathService::flushSingle(std::size_t first)
+{
+	std::size_t written = 0;
+	for (std::size_t i = first; i < pendingKeys.size(); ++i) {
+		int err = bpf_map__update_elem(pathCache, &pendingKeys[i], sizeof(scion_addr),
+			&pendingValues[i], sizeof(struct path_map_entry), BPF_ANY);
+		if (err < 0) {
+			std::cerr << "Could not insert path to Path Cache\n";
+			continue;
+		}
+		// Only paths actually in the Path Cache are mirrored
+		pathTable.set(pendingKeys[i], pendingPaths[i]);
+		++written;
+	}
+	return written;
+}
+
+std::vector<PathService::Stats> PathService::dumpStats()
+{
+	const int ncpus = libbpf_num_possible_cpus();
+	if (ncpus <= 0)
+		throw std::runtime_error("Could not determine number of CPUs");
+
+	std::vector<scion_addr> keys;
+	std::vector<struct path_stats> values;
+	dumpMap(statsMap, ncpus, keys, values);
+
+	std::unordered_map<scion_addr, Stats> sums;
+	for (std::size_t i = 0; i < keys.size(); ++i) {
+		auto &sum = sums[keys[i]];
+		sum.addr = keys[i];
+		for (int cpu = 0; cpu < ncpus; ++cpu) {
+			sum.packets += values[i * ncpus + cpu].packets;
+			sum.bytes += values[i * ncpus + cpu].bytes;
+		}
+	}
+
+	std::vector<Stats> stats;
+	stats.reserve(sums.size());
+	for (const auto &[_, sum] : sums)
+		stats.push_back(sum);
+	return stats;
+}
+
+std::vector<std::optional<PathInfoVec>> PathService::queryAll(const std::vector<scion_addr> &dests,
+	unsigned concurrency)
+{
+	std::vector<std::optional<PathInfoVec>> results(dests.size());
+	std::atomic<std::size_t> next = 0;
+
+	// Path queries are latency bound, so resolve them concurrently
+	{
+		std::vector<std::jthread> workers;
+		auto n = std::min<std::size_t>(std::max(concurrency, 1u), dests.size());
+		for (std::size_t i = 0; i < n; ++i) {
+			workers.emplace_back([&] {
+				for (auto j = next++; j < dests.size(); j = next++)
+					results[j] = getPaths(dests[j]);
+			});
+		}
+	}
+	return results;
+}
+
+std::size_t PathService::warmUp(const std::vector<scion_addr> &dests, unsigned concurrency)
+{
+	if (!connected)
+		return 0;
+
+	auto results = queryAll(dests, concurrency);
+	std::size_t found = 0;
+	for (std::size_t i = 0; i < dests.size(); ++i) {
+		if (!results[i])
+			continue;
+		if (!results[i]->empty())
+			++found;
+		insertPaths(dests[i], *results[i]);
+	}
+	flush();
+
+	std::cerr << "Warmed up Path Cache with " << found << " of " << dests.size() << " destinations\n";
+	return found;
+}
+
+void PathService::refreshRestored()
+{
+	// Destinations requested in the meantime already have fresh candidates
+	std::vector<scion_addr> dests;
+	for (auto addr : std::exchange(restoredDests, {})) {
+		if (!candidates.contains(addr))
+			dests.push_back(addr);
+	}
+
+	auto results = queryAll(dests, REFRESH_CONCURRENCY);
+	std::size_t refreshed = 0;
+	for (std::size_t i = 0; i < dests.size(); ++i) {
+		if (!results[i]) {
+			restoredDests.push_back(dests[i]);
+			continue;
+		}
+		insertPaths(dests[i], *results[i]);
+		// The restored path must not outlive the candidates it was chosen from
+		if (!installed.contains(dests[i]))
+			evict(dests[i]);
+		++refreshed;
+	}
+	flush();
+
+	std::cerr << "Refreshed " << refreshed << " of " << dests.size() << " paths restored from snapshot\n";
+}
+
+std::vector<PathService::Stats> PathService::hottest(std::size_t n)
+{
+	auto stats = dumpStats();
+	auto end = stats.begin() + std::min(n, stats.size());
+	std::partial_sort(stats.begin(), end, stats.end(), [](const Stats &a, const Stats &b) {
+		return a.packets > b.packets;
+	});
+	stats.erase(end, stats.end());
+	return stats;
+}
+
+void PathService::setHotSetFile(const std::string &file, std::chrono::seconds interval)
+{
+	hotSetFile = file;
+	hotSetInterval = interval;
+}
+
+void PathService::saveHotSet()
+{
+	auto stats = hottest(HOT_SET_SIZE);
+
+	// Write to a temporary file first, so that a crash never leaves a truncated hot set behind
+	auto tmp = hotSetFile + ".tmp";
+	{
+		std::ofstream out(tmp, std::ios::trunc);
+		if (!out) {
+			std::cerr << "Could not write hot set to " << tmp << "\n";
+			return;
+		}
+		out << "# Destinations by number of packets sent\n";
+		for (const auto &entry : stats) {
+			out << formatIsdAsn(toIsdAsn(entry.addr));
+			if (entry.addr.subnet)
+				out << ' ' << std::hex << entry.addr.subnet << std::dec;
+			out << '\n';
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmp, hotSetFile, ec);
+	if (ec)
+		std::cerr << "Could not replace hot set file " << hotSetFile << ": " << ec.message() << "\n";
+}
+
+void PathService::setSnapshotFile(const std::string &file, std::chrono::seconds interval)
+{
+	snapshotFile = file;
+	snapshotInterval = interval;
+}
+
+void PathService::saveSnapshot()
+{
+	std::vector<scion_addr> keys;
+	std::vector<struct path_map_entry> values;
+	if (!dumpMap(pathCache, 1, keys, values))
+		return;
+
+	std::vector<PathSnapshot::Entry> entries;
+	entries.reserve(keys.size());
+	for (std::size_t i = 0; i < keys.size(); ++i) {
+		auto entry = pathTable.pending(keys[i]);
+		if (!entry)
+			continue;
+		entries.push_back({ keys[i], entry->path.expiry, values[i] });
+	}
+
+	try {
+		PathSnapshot::save(snapshotFile, entries);
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << "\n";
+	}
+}
+
+std::size_t PathService::loadSnapshot(const std::string &file)
+{
+	auto restored = PathSnapshot::load(file, std::chrono::system_clock::now(),
+		[this](const PathSnapshot::Entry &entry) {
+			pendingKeys.push_back(entry.key);
+			pendingValues.push_back(entry.value);
+			pendingPaths.push_back(mapEntryToPath(entry.value, entry.expiry));
+			restoredDests.push_back(entry.key);
+		});
+	flush();
+
+	std::cerr << "Restored " << restored << " paths from snapshot " << file << "\n";
+	return restored;
+}
+
+std::vector<scion_addr> PathService::readDestinations(const std::string &file)
+{
+	std::ifstream in(file);
+	if (!in)
+		throw std::runtime_error("Could not open destination list " + file);
+
+	std::vector<scion_addr> dests;
+	std::string line;
+	for (unsigned lineNo = 1; std::getline(in, line); ++lineNo) {
+		auto begin = line.find_first_not_of(" \t");
+		if (begin == std::string::npos || line[begin] == '#')
+			continue;
+		auto end = line.find_last_not_of(" \t\r");
+		std::string_view fields = std::string_view(line).substr(begin, end - begin + 1);
+
+		// Optional second column with the subnet ID, for keys that include the subnet
+		std::uint32_t subnet = 0;
+		auto sep = fields.find_first_of(" \t");
+		if (sep != std::string_view::npos) {
+			auto raw = fields.substr(fields.find_first_not_of(" \t", sep));
+			auto res = std::from_chars(raw.data(), raw.data() + raw.size(), subnet, 0x10);
+			if (res.ptr != raw.data() + raw.size() || subnet >= (1u << SCION_MAPPING_MAX_SUBNET_BITS)) {
+				std::cerr << file << ":" << lineNo << ": invalid subnet ID\n";
+				continue;
+			}
+			fields = fields.substr(0, sep);
+		}
+
+		auto ia = parseIsdAsn(fields);
+		if (!ia) {
+			std::cerr << file << ":" << lineNo << ": invalid ISD-AS\n";
+			continue;
+		}
+		dests.push_back(toScionAddr(*ia, subnet));
+	}
+	return dests;
 }
 
 //void PathService::fillPathMap()
@@ -0,0 +1,139 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "PathSnapshot.hxx"
+
+static constexpr char MAGIC[8] = { 'S', 'C', 'P', 'C', 'A', 'C', 'H', 'E' };
+static constexpr std::uint32_t VERSION = 1;
+
+struct SnapshotHeader {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t keySize;
+	std::uint64_t count;
+};
+
+// Size of a record without the raw path
+static constexpr std::size_t RECORD_FIXED_SIZE = sizeof(scion_addr) + sizeof(std::int64_t) + 1
+	+ sizeof(struct scionhdr) + sizeof(path_map_entry::router_addr) + sizeof(path_map_entry::router_port);
+
+template <typename T>
+static void writeRaw(std::ofstream &out, const T &value)
+{
+	out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+static void readRaw(const std::uint8_t *&p, T &value)
+{
+	std::memcpy(&value, p, sizeof(value));
+	p += sizeof(value);
+}
+
+void PathSnapshot::save(const std::string &file, const std::vector<Entry> &entries)
+{
+	auto tmp = file + ".tmp";
+	{
+		std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+		if (!out)
+			throw std::runtime_error("Could not create snapshot " + tmp);
+
+		SnapshotHeader header = {};
+		std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.keySize = sizeof(scion_addr);
+		header.count = entries.size();
+		writeRaw(out, header);
+
+		for (const auto &entry : entries) {
+			std::int64_t expiry = std::numeric_limits<std::int64_t>::max();
+			if (entry.expiry != Clock::time_point::max())
+				expiry = std::chrono::duration_cast<std::chrono::seconds>(entry.expiry.time_since_epoch()).count();
+
+			writeRaw(out, entry.key);
+			writeRaw(out, expiry);
+			writeRaw(out, entry.value.path_len);
+			writeRaw(out, entry.value.header);
+			writeRaw(out, entry.value.router_addr);
+			writeRaw(out, entry.value.router_port);
+			out.write(reinterpret_cast<const char *>(entry.value.path), 4 * entry.value.path_len);
+		}
+
+		if (!out.flush())
+			throw std::runtime_error("Could not write snapshot " + tmp);
+	}
+	std::filesystem::rename(tmp, file);
+}
+
+std::size_t PathSnapshot::load(const std::string &file, Clock::time_point now,
+	const std::function<void(const Entry &)> &fn)
+{
+	int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw std::runtime_error("Could not open snapshot " + file + ": " + strerror(errno));
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || (std::size_t)st.st_size < sizeof(SnapshotHeader)) {
+		close(fd);
+		throw std::runtime_error("Invalid snapshot " + file);
+	}
+	std::size_t size = st.st_size;
+	void *base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		throw std::runtime_error("Could not map snapshot " + file + ": " + strerror(errno));
+	// Records are read front to back exactly once
+	madvise(base, size, MADV_SEQUENTIAL);
+
+	auto p = static_cast<const std::uint8_t *>(base);
+	const auto end = p + size;
+	SnapshotHeader header;
+	readRaw(p, header);
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) || header.version != VERSION
+		|| header.keySize != sizeof(scion_addr)) {
+		munmap(base, size);
+		throw std::runtime_error("Incompatible snapshot " + file);
+	}
+
+	auto nowSecs = std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch()).count();
+	std::size_t loaded = 0;
+	Entry entry = {};
+	for (std::uint64_t i = 0; i < header.count; ++i) {
+		if ((std::size_t)(end - p) < RECORD_FIXED_SIZE)
+			break;
+		std::int64_t expiry;
+		readRaw(p, entry.key);
+		readRaw(p, expiry);
+		readRaw(p, entry.value.path_len);
+		readRaw(p, entry.value.header);
+		readRaw(p, entry.value.router_addr);
+		readRaw(p, entry.value.router_port);
+		std::size_t pathBytes = 4 * entry.value.path_len;
+		if ((std::size_t)(end - p) < pathBytes)
+			break;
+		std::memcpy(entry.value.path, p, pathBytes);
+		std::memset(entry.value.path + entry.value.path_len, 0, sizeof(entry.value.path) - pathBytes);
+		p += pathBytes;
+
+		if (expiry <= nowSecs)
+			continue;
+		if (expiry == std::numeric_limits<std::int64_t>::max())
+			entry.expiry = Clock::time_point::max();
+		else
+			entry.expiry = Clock::time_point(std::chrono::seconds(expiry));
+		fn(entry);
+		++loaded;
+	}
+
+	munmap(base, size);
+	return loaded;
+}
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <grpcpp/create_channel.h>
+
+#include "proto/daemon/v1/daemon.pb.h"
+
+#include "Address.hxx"
+#include "DataplanePath.hxx"
+#include "GrpcCall.hxx"
+#include "PathSource.hxx"
+
+using namespace std::chrono_literals;
+namespace daemon_pb = proto::daemon::v1;
+
+// Timeouts of the daemon API calls
+static constexpr auto CONNECT_TIMEOUT = 1s;
+static constexpr auto QUERY_TIMEOUT = 100ms;
+
+DaemonPathSource::DaemonPathSource(const std::string &sciondAddr)
+	: sciondAddr(sciondAddr)
+{
+}
+
+bool DaemonPathSource::connect()
+{
+	channel = grpc::CreateChannel(sciondAddr, grpc::InsecureChannelCredentials());
+
+	// The daemon does not include the source AS in its paths
+	GrpcCall<daemon_pb::ASRequest, daemon_pb::ASResponse> call;
+	auto status = call.start(channel, "/proto.daemon.v1.DaemonService/AS", CONNECT_TIMEOUT).get();
+	if (!status.ok()) {
+		std::cerr << "Could not reach SCION daemon at " << sciondAddr << " (" << status.error_message() << ")\n";
+		return false;
+	}
+	localIA = call.response.isd_as();
+	return true;
+}
+
+std::optional<PathInfoVec> DaemonPathSource::query(std::uint64_t dst)
+{
+	GrpcCall<daemon_pb::PathsRequest, daemon_pb::PathsResponse> call;
+	call.request.set_source_isd_as(localIA);
+	call.request.set_destination_isd_as(dst);
+	auto status = call.start(channel, "/proto.daemon.v1.DaemonService/Paths", QUERY_TIMEOUT).get();
+	if (isUnreachable(status)) {
+		std::cerr << "SCION daemon at " << sciondAddr << " not reachable (" << status.error_message() << ")\n";
+		return std::nullopt;
+	}
+	if (!status.ok() || call.response.paths().empty()) {
+		std::cerr << "No path for " << formatIsdAsn(dst) << " found (" << status.error_message() << ")\n";
+		return PathInfoVec();
+	}
+
+	PathInfoVec result;
+	result.reserve(call.response.paths_size());
+	for (const auto &path : call.response.paths()) {
+		PathInfo info;
+		info.src = localIA;
+		info.dst = dst;
+		info.dp.assign(path.raw().begin(), path.raw().end());
+		if (!parseUnderlay(path.interface().address().address(), info.nextHop, info.nextHopPort)) {
+			std::cerr << "Invalid next hop " << path.interface().address().address() << " for path to "
+				  << formatIsdAsn(dst) << "\n";
+			continue;
+		}
+		info.mtu = path.mtu();
+		if (path.has_expiration())
+			info.expiry = std::chrono::system_clock::time_point(std::chrono::seconds(path.expiration().seconds()));
+		else if (auto decoded = decodePath(info.dp))
+			info.expiry = decoded->expiry();
+		for (const auto &iface : path.interfaces())
+			info.interfaces.push_back({ iface.isd_as(), iface.id() });
+		for (const auto &latency : path.latency()) {
+			// Unknown latencies are negative, but may be shorter than a microsecond
+			auto ns = std::chrono::seconds(latency.seconds()) + std::chrono::nanoseconds(latency.nanos());
+			if (ns < ns.zero())
+				info.latency.push_back(std::chrono::microseconds(-1));
+			else
+				info.latency.push_back(std::chrono::duration_cast<std::chrono::microseconds>(ns));
+		}
+		info.bandwidth.assign(path.bandwidth().begin(), path.bandwidth().end());
+		result.push_back(std::move(info));
+	}
+	return result;
+}
+
+FilePathSource::FilePathSource(const std::string &file)
+	: file(file)
+{
+}
+
+/// Parse a comma separated list of integers
+template <typename T>
+static bool parseList(const std::string &raw, std::vector<T> &out)
+{
+	std::stringstream stream(raw);
+	std::string item;
+	while (std::getline(stream, item, ',')) {
+		long long value = 0;
+		auto res = std::from_chars(item.data(), item.data() + item.size(), value);
+		if (item.empty() || res.ptr != item.data() + item.size())
+			return false;
+		out.push_back(T(value));
+	}
+	return true;
+}
+
+static bool parseHex(const std::string &raw, std::vector<std::uint8_t> &out)
+{
+	if (raw == "-")
+		return true;
+	if (raw.size() % 2)
+		return false;
+	for (std::size_t i = 0; i < raw.size(); i += 2) {
+		std::uint8_t byte = 0;
+		auto res = std::from_chars(raw.data() + i, raw.data() + i + 2, byte, 16);
+		if (res.ptr != raw.data() + i + 2)
+			return false;
+		out.push_back(byte);
+	}
+	return true;
+}
+
+bool FilePathSource::connect()
+{
+	std::ifstream in(file);
+	if (!in) {
+		std::cerr << "Could not open path file " << file << "\n";
+		return false;
+	}
+
+	paths.clear();
+	std::string line;
+	for (unsigned lineNo = 1; std::getline(in, line); ++lineNo) {
+		std::stringstream stream(line);
+		std::string dst, src, nextHop, dp, latency, bandwidth;
+		long long expiry = 0;
+		PathInfo path;
+
+		if (!(stream >> dst) || dst.front() == '#')
+			continue;
+		bool valid = (bool)(stream >> src >> nextHop >> path.mtu >> expiry >> dp);
+		// Metadata is optional
+		stream >> latency >> bandwidth;
+
+		auto dstIA = parseIsdAsn(dst), srcIA = parseIsdAsn(src);
+		valid = valid && dstIA && srcIA && parseUnderlay(nextHop, path.nextHop, path.nextHopPort) && parseHex(dp, path.dp)
+			&& parseList(latency, path.latency) && parseList(bandwidth, path.bandwidth);
+		if (!valid) {
+			std::cerr << file << ":" << lineNo << ": invalid path\n";
+			continue;
+		}
+		path.dst = *dstIA;
+		path.src = *srcIA;
+		path.expiry = std::chrono::system_clock::time_point(std::chrono::seconds(expiry));
+		paths.push_back(std::move(path));
+	}
+	return true;
+}
+
+std::optional<PathInfoVec> FilePathSource::query(std::uint64_t dst)
+{
+	PathInfoVec result;
+	std::copy_if(paths.begin(), paths.end(), std::back_inserter(result),
+		[dst](const PathInfo &path) { return path.dst == dst; });
+	return result;
+}
@@ -0,0 +1,64 @@
+#include "PathTable.hxx"
+
+std::shared_ptr<const PathTable::Entry> PathTable::Snapshot::find(scion_addr addr) const
+{
+	const auto &shard = *shards[shardOf(addr)];
+	auto it = shard.find(addr);
+	if (it == shard.end())
+		return nullptr;
+	return it->second;
+}
+
+std::size_t PathTable::Snapshot::size() const
+{
+	std::size_t size = 0;
+	for (const auto &shard : shards)
+		size += shard->size();
+	return size;
+}
+
+PathTable::PathTable()
+{
+	// All shards of the initial snapshot are empty
+	auto snapshot = std::make_shared<Snapshot>();
+	auto empty = std::make_shared<const Shard>();
+	snapshot->shards.fill(empty);
+	current.store(snapshot);
+}
+
+void PathTable::set(scion_addr addr, const PathInfo &path)
+{
+	auto shard = shardOf(addr);
+	working[shard][addr] = std::make_shared<const Entry>(Entry{ path, std::chrono::system_clock::now() });
+	dirty.set(shard);
+}
+
+void PathTable::erase(scion_addr addr)
+{
+	auto shard = shardOf(addr);
+	if (working[shard].erase(addr) > 0)
+		dirty.set(shard);
+}
+
+void PathTable::publish()
+{
+	if (dirty.none())
+		return;
+
+	auto next = std::make_shared<Snapshot>(*snapshot());
+	for (std::size_t i = 0; i < SHARDS; ++i) {
+		if (dirty.test(i))
+			next->shards[i] = std::make_shared<const Shard>(working[i]);
+	}
+	current.store(std::move(next), std::memory_order_release);
+	dirty.reset();
+}
+
+std::shared_ptr<const PathTable::Entry> PathTable::pending(scion_addr addr) const
+{
+	const auto &shard = working[shardOf(addr)];
+	auto it = shard.find(addr);
+	if (it == shard.end())
+		return nullptr;
+	return it->second;
+}
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "libbpf.h"
+#include "Policer.hxx"
+
+static const char *const DROP_REASON_NAMES[DROP_REASONS] = { "no path", "policed", "MTU", "no room", "malformed" };
+
+/// Parse a number with an optional k, M or G suffix
+static bool parseQuantity(const std::string &raw, std::uint64_t &value)
+{
+	auto res = std::from_chars(raw.data(), raw.data() + raw.size(), value);
+	if (raw.empty() || res.ec != std::errc())
+		return false;
+	std::string_view suffix(res.ptr, raw.data() + raw.size() - res.ptr);
+	if (suffix == "k")
+		value *= 1000;
+	else if (suffix == "M")
+		value *= 1000 * 1000;
+	else if (suffix == "G")
+		value *= 1000 * 1000 * 1000;
+	else if (!suffix.empty())
+		return false;
+	return true;
+}
+
+Policer::Policer(struct bpf_map *cfgMap, struct bpf_map *stateMap, struct bpf_map *dropMap)
+	: cfgMap(cfgMap)
+	, stateMap(stateMap)
+	, dropMap(dropMap)
+	, ncpus(libbpf_num_possible_cpus())
+{
+	if (ncpus <= 0)
+		throw std::runtime_error("Could not determine number of CPUs");
+}
+
+bool Policer::writeShares(scion_addr dst, const std::vector<struct police_share> &shares)
+{
+	int err = bpf_map__update_elem(cfgMap, &dst, sizeof(dst), shares.data(),
+		shares.size() * sizeof(struct police_share), BPF_ANY);
+	if (err) {
+		std::cerr << "Could not update rate limit of " << formatIsdAsn(toIsdAsn(dst)) << ": "
+			  << strerror(-err) << "\n";
+		return false;
+	}
+	return true;
+}
+
+bool Policer::set(scion_addr dst, RateLimit limit)
+{
+	// Equal shares until the first reconciliation knows better
+	std::vector<struct police_share> shares(ncpus);
+	for (auto &share : shares) {
+		share.rate = limit.rate / ncpus;
+		share.burst = std::max(limit.burst / ncpus, std::min(limit.burst, MIN_BURST));
+	}
+	if (!writeShares(dst, shares))
+		return false;
+
+	std::lock_guard lock(mutex);
+	auto &entry = limits[dst];
+	entry.limit = limit;
+	if (entry.offered.empty())
+		entry.offered.assign(ncpus, 0);
+	return true;
+}
+
+void Policer::erase(scion_addr dst)
+{
+	bpf_map__delete_elem(cfgMap, &dst, sizeof(dst), 0);
+	bpf_map__delete_elem(stateMap, &dst, sizeof(dst), 0);
+
+	std::lock_guard lock(mutex);
+	limits.erase(dst);
+}
+
+std::size_t Policer::load(const std::string &file)
+{
+	std::ifstream in(file);
+	if (!in)
+		throw std::runtime_error("Could not open rate limits " + file);
+
+	std::unordered_map<scion_addr, RateLimit> configured;
+	std::string line;
+	for (unsigned lineNo = 1; std::getline(in, line); ++lineNo) {
+		std::stringstream stream(line);
+		std::string dst, rate, burst, subnet;
+		RateLimit limit;
+		std::uint32_t subnetId = 0;
+
+		if (!(stream >> dst) || dst.front() == '#')
+			continue;
+		stream >> rate >> burst >> subnet;
+
+		auto ia = parseIsdAsn(dst);
+		bool valid = ia && parseQuantity(rate, limit.rate) && parseQuantity(burst, limit.burst);
+		if (valid && !subnet.empty()) {
+			auto res = std::from_chars(subnet.data(), subnet.data() + subnet.size(), subnetId, 16);
+			valid = res.ptr == subnet.data() + subnet.size();
+		}
+		if (!valid || limit.rate == 0) {
+			std::cerr << file << ":" << lineNo << ": invalid rate limit\n";
+			continue;
+		}
+		limit.rate /= 8;
+		configured[toScionAddr(*ia, subnetId)] = limit;
+	}
+
+	std::vector<scion_addr> stale;
+	{
+		std::lock_guard lock(mutex);
+		for (const auto &[dst, _] : limits) {
+			if (!configured.contains(dst))
+				stale.push_back(dst);
+		}
+	}
+	for (auto dst : stale)
+		erase(dst);
+
+	std::size_t count = 0;
+	for (const auto &[dst, limit] : configured) {
+		if (set(dst, limit))
+			++count;
+	}
+	return count;
+}
+
+std::vector<struct police_share> Policer::shares(RateLimit limit, const std::vector<std::uint64_t> &demand)
+{
+	std::vector<struct police_share> shares(demand.size());
+	std::uint64_t total = 0;
+	for (auto bytes : demand)
+		total += bytes;
+
+	std::uint64_t reserve = std::min(limit.rate / (RESERVE_DIVISOR * demand.size()), MAX_RESERVE);
+	long double spare = limit.rate - reserve * demand.size();
+	for (std::size_t cpu = 0; cpu < demand.size(); ++cpu) {
+		shares[cpu].rate = reserve + std::uint64_t(spare * demand[cpu] / total);
+		long double weight = limit.rate ? (long double)shares[cpu].rate / limit.rate : 0;
+		shares[cpu].burst = std::max(std::uint64_t(limit.burst * weight), std::min(limit.burst, MIN_BURST));
+	}
+	return shares;
+}
+
+void Policer::reconcile()
+{
+	std::vector<struct police_bucket> buckets(ncpus);
+	std::vector<std::uint64_t> demand(ncpus);
+
+	std::lock_guard lock(mutex);
+	for (auto &[dst, entry] : limits) {
+		// No bucket yet, no traffic since the rate limit was set
+		if (bpf_map__lookup_elem(stateMap, &dst, sizeof(dst), buckets.data(),
+			    buckets.size() * sizeof(struct police_bucket), 0))
+			continue;
+
+		std::uint64_t total = 0;
+		for (int cpu = 0; cpu < ncpus; ++cpu) {
+			demand[cpu] = buckets[cpu].offered - entry.offered[cpu];
+			entry.offered[cpu] = buckets[cpu].offered;
+			total += demand[cpu];
+		}
+		if (total == 0)
+			continue;
+
+		writeShares(dst, shares(entry.limit, demand));
+	}
+}
+
+std::array<std::uint64_t, DROP_REASONS> Policer::drops()
+{
+	std::array<std::uint64_t, DROP_REASONS> sums = {};
+	std::vector<std::uint64_t> counts(ncpus);
+
+	for (__u32 reason = 0; reason < DROP_REASONS; ++reason) {
+		if (bpf_map__lookup_elem(dropMap, &reason, sizeof(reason), counts.data(),
+			    counts.size() * sizeof(std::uint64_t), 0))
+			continue;
+		for (auto count : counts)
+			sums[reason] += count;
+	}
+	return sums;
+}
+
+void Policer::run(std::stop_token stop)
+{
+	auto nextReport = std::chrono::steady_clock::now() + REPORT_INTERVAL;
+	std::array<std::uint64_t, DROP_REASONS> reported = {};
+
+	while (!stop.stop_requested()) {
+		std::this_thread::sleep_for(RECONCILE_INTERVAL);
+		reconcile();
+
+		if (std::chrono::steady_clock::now() < nextReport)
+			continue;
+		nextReport += REPORT_INTERVAL;
+
+		auto current = drops();
+		if (current == reported)
+			continue;
+		std::stringstream report;
+		report << "Dropped packets:";
+		for (int reason = 0; reason < DROP_REASONS; ++reason)
+			report << ' ' << DROP_REASON_NAMES[reason] << ' ' << current[reason];
+		std::cerr << report.str() << "\n";
+		reported = current;
+	}
+}
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <unordered_set>
+
+#include "DataplanePath.hxx"
+#include "SegmentCombiner.hxx"
+
+// Limits of the standard SCION path header
+static constexpr std::size_t MAX_SEG_LEN = 63;
+static constexpr std::size_t MAX_HOPS = 64;
+
+using Segments = std::vector<const PathSegment *>;
+
+/// An AS on a combined path, crossover ASes are entered and left in different segments
+struct Hop {
+	std::uint64_t ia;
+	std::uint16_t in;
+	std::uint16_t out;
+	const PathSegment::ASEntry *inEntry;
+	const PathSegment::ASEntry *outEntry;
+};
+
+static void put16(std::vector<std::uint8_t> &raw, std::uint16_t value)
+{
+	raw.push_back(value >> 8);
+	raw.push_back(value);
+}
+
+static void put32(std::vector<std::uint8_t> &raw, std::uint32_t value)
+{
+	put16(raw, value >> 16);
+	put16(raw, value);
+}
+
+/// SegID the info field of `seg` must start with
+///
+/// Against construction direction the MACs of all but the last traversed
+/// hop field have been accumulated into the SegID already.
+static std::uint16_t initialSegId(const PathSegment &seg)
+{
+	std::uint16_t beta = seg.segId;
+	if (seg.type == PathSegment::Type::Down)
+		return beta;
+	for (std::size_t i = 0; i + 1 < seg.entries.size(); ++i)
+		beta ^= (std::uint16_t)(seg.entries[i].hop.mac[0] << 8) | seg.entries[i].hop.mac[1];
+	return beta;
+}
+
+template <typename T>
+using StaticInfo = std::unordered_map<std::uint64_t, T> PathSegment::ASEntry::*;
+
+/// Static info value between the interfaces `hop` is entered and left through
+///
+/// The values are given relative to the egress interface of an AS entry, at
+/// crossovers either of the two entries may have it.
+template <typename T>
+static std::optional<T> intraValue(const Hop &hop, StaticInfo<T> member)
+{
+	for (const auto *entry : { hop.inEntry, hop.outEntry }) {
+		const auto &map = entry->*member;
+		auto it = map.end();
+		if (entry->hop.egress == hop.in)
+			it = map.find(hop.out);
+		else if (entry->hop.egress == hop.out)
+			it = map.find(hop.in);
+		if (it != map.end())
+			return it->second;
+	}
+	return std::nullopt;
+}
+
+/// Static info value of the link between `from` and `to`
+///
+/// The link is described by the AS entry it is the egress interface of.
+template <typename T>
+static std::optional<T> interValue(const Hop &from, const Hop &to, StaticInfo<T> member)
+{
+	for (auto [entry, ifid] : { std::pair(from.outEntry, from.out), std::pair(to.inEntry, to.in) }) {
+		if (entry->hop.egress != ifid)
+			continue;
+		auto it = (entry->*member).find(ifid);
+		if (it != (entry->*member).end())
+			return it->second;
+	}
+	return std::nullopt;
+}
+
+static void addMetadata(const std::vector<Hop> &hops, PathInfo &path)
+{
+	using Entry = PathSegment::ASEntry;
+	constexpr auto UNKNOWN = std::chrono::microseconds(-1);
+
+	for (std::size_t k = 0; k + 1 < hops.size(); ++k) {
+		if (k > 0) {
+			path.latency.push_back(intraValue(hops[k], &Entry::intraLatency).value_or(UNKNOWN));
+			path.bandwidth.push_back(intraValue(hops[k], &Entry::intraBandwidth).value_or(0));
+		}
+		path.latency.push_back(interValue(hops[k], hops[k + 1], &Entry::interLatency).value_or(UNKNOWN));
+		path.bandwidth.push_back(interValue(hops[k], hops[k + 1], &Entry::interBandwidth).value_or(0));
+	}
+}
+
+/// Build the path through `segs`, returns nothing if it is not a valid path
+static std::optional<PathInfo> build(std::uint64_t src, std::uint64_t dst, const Segments &segs)
+{
+	PathInfo path;
+	path.src = src;
+	path.dst = dst;
+
+	std::uint32_t meta = 0;
+	std::size_t numHops = 0;
+	for (std::size_t i = 0; i < segs.size(); ++i) {
+		auto len = segs[i]->entries.size();
+		if (len == 0 || len > MAX_SEG_LEN)
+			return std::nullopt;
+		meta |= len << (6 * (2 - i));
+		numHops += len;
+	}
+	if (numHops > MAX_HOPS)
+		return std::nullopt;
+
+	put32(path.dp, meta);
+	for (const auto *seg : segs) {
+		bool consDir = seg->type == PathSegment::Type::Down;
+		path.dp.push_back(consDir ? 0x01 : 0x00);
+		path.dp.push_back(0);
+		put16(path.dp, initialSegId(*seg));
+		put32(path.dp, seg->timestamp);
+	}
+
+	std::vector<Hop> hops;
+	std::unordered_set<std::uint64_t> visited;
+	std::uint32_t mtu = UINT16_MAX;
+	for (const auto *seg : segs) {
+		bool consDir = seg->type == PathSegment::Type::Down;
+		for (std::size_t i = 0; i < seg->entries.size(); ++i) {
+			const auto &entry = seg->entries[consDir ? i : seg->entries.size() - 1 - i];
+			const auto &hf = entry.hop;
+
+			path.dp.push_back(0);
+			path.dp.push_back(hf.expTime);
+			put16(path.dp, hf.ingress);
+			put16(path.dp, hf.egress);
+			path.dp.insert(path.dp.end(), hf.mac.begin(), hf.mac.end());
+
+			if (entry.mtu)
+				mtu = std::min<std::uint32_t>(mtu, entry.mtu);
+			if (hf.ingress && entry.ingressMtu)
+				mtu = std::min<std::uint32_t>(mtu, entry.ingressMtu);
+
+			auto in = consDir ? hf.ingress : hf.egress;
+			auto out = consDir ? hf.egress : hf.ingress;
+			if (i == 0 && !hops.empty()) {
+				// Crossover, the AS is left through the new segment
+				hops.back().out = out;
+				hops.back().outEntry = &entry;
+				continue;
+			}
+			if (!visited.insert(entry.ia).second)
+				return std::nullopt;
+			hops.push_back({ entry.ia, in, out, &entry, &entry });
+		}
+	}
+
+	// The path must leave the source and enter the destination through a real interface
+	if (hops.size() < 2 || hops.front().out == 0 || hops.back().in == 0)
+		return std::nullopt;
+	for (std::size_t k = 0; k < hops.size(); ++k) {
+		if (k > 0)
+			path.interfaces.push_back({ hops[k].ia, hops[k].in });
+		if (k + 1 < hops.size())
+			path.interfaces.push_back({ hops[k].ia, hops[k].out });
+	}
+	addMetadata(hops, path);
+
+	path.mtu = mtu;
+	if (auto decoded = decodePath(path.dp))
+		path.expiry = decoded->expiry();
+	else
+		return std::nullopt;
+	return path;
+}
+
+PathInfoVec combineSegments(std::uint64_t src, std::uint64_t dst, const std::vector<PathSegment> &segments)
+{
+	Segments ups, cores, downs;
+	for (const auto &seg : segments) {
+		if (seg.entries.empty())
+			continue;
+		switch (seg.type) {
+		case PathSegment::Type::Up:
+			ups.push_back(&seg);
+			break;
+		case PathSegment::Type::Core:
+			cores.push_back(&seg);
+			break;
+		case PathSegment::Type::Down:
+			downs.push_back(&seg);
+			break;
+		}
+	}
+	// Unused positions hold nullptr, so that every type is optional
+	ups.push_back(nullptr);
+	cores.push_back(nullptr);
+	downs.push_back(nullptr);
+
+	// Paths with the same interfaces only differ in their segments, keep the one expiring last
+	std::map<std::vector<std::pair<std::uint64_t, std::uint64_t>>, PathInfo> paths;
+	for (const auto *up : ups) {
+		if (up && up->start() != src)
+			continue;
+		for (const auto *core : cores) {
+			for (const auto *down : downs) {
+				Segments segs;
+				for (const auto *seg : { up, core, down }) {
+					if (seg)
+						segs.push_back(seg);
+				}
+				if (segs.empty() || segs.back()->end() != dst || segs.front()->start() != src)
+					continue;
+				bool joined = true;
+				for (std::size_t i = 1; i < segs.size(); ++i)
+					joined = joined && segs[i - 1]->end() == segs[i]->start();
+				if (!joined)
+					continue;
+
+				auto path = build(src, dst, segs);
+				if (!path)
+					continue;
+				std::vector<std::pair<std::uint64_t, std::uint64_t>> key;
+				for (const auto &iface : path->interfaces)
+					key.emplace_back(iface.ia, iface.ifid);
+				auto [it, inserted] = paths.try_emplace(std::move(key), *path);
+				if (!inserted && it->second.expiry < path->expiry)
+					it->second = std::move(*path);
+			}
+		}
+	}
+
+	PathInfoVec result;
+	result.reserve(paths.size());
+	for (auto &[_, path] : paths)
+		result.push_back(std::move(path));
+	std::stable_sort(result.begin(), result.end(), [](const PathInfo &a, const PathInfo &b) {
+		return a.interfaces.size() < b.interfaces.size();
+	});
+	return result;
+}
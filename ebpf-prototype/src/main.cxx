@@ -1,37 +1,85 @@
+#include <algorithm>
 #include <chrono>
 #include <errno.h>
 #include <exception>
 #include <getopt.h>
 #include <iostream>
 #include <net/if.h>
+#include <optional>
 #include <signal.h>
 #include <stdarg.h>
 #include <thread>
+#include <vector>
 
 #include "libbpf.h"
 #include "libbpf_common.h"
 
+#include "Address.hxx"
+#include "AddressMap.hxx"
+#include "ControlServicePathSource.hxx"
 #include "EgressLoader.hxx"
+#include "PacketCapture.hxx"
 #include "IngressLoader.hxx"
 #include "PathService.hxx"
+#include "Policer.hxx"
 
 using namespace std::chrono_literals;
 
 static volatile sig_atomic_t exiting = 0;
+static volatile sig_atomic_t topologyChanged = 0;
+static volatile sig_atomic_t captureToggled = 0;
+static volatile sig_atomic_t tableRequested = 0;
 
 static void sig_int(int)
 {
 	exiting = 1;
 }
 
+static void sig_hup(int)
+{
+	topologyChanged = 1;
+}
+
+static void sig_usr1(int)
+{
+	captureToggled = 1;
+}
+
+static void sig_usr2(int)
+{
+	tableRequested = 1;
+}
+
 static int libbpf_print_fn(enum libbpf_print_level, const char *format, va_list args)
 {
 	return vfprintf(stderr, format, args);
 }
 
+/// Print the installed paths from the mirror of the Path Cache
+///
+/// Runs on the main thread, the Path Service is neither blocked nor are the BPF maps read.
+static void printPathTable(const PathTable &table)
+{
+	auto snapshot = table.snapshot();
+	auto now = std::chrono::system_clock::now();
+	std::cerr << snapshot->size() << " installed paths\n";
+	snapshot->forEach([&](scion_addr addr, const PathTable::Entry &entry) {
+		const auto &path = entry.path;
+		std::cerr << "  " << formatIsdAsn(toIsdAsn(addr));
+		if (addr.subnet)
+			std::cerr << " subnet " << std::hex << addr.subnet << std::dec;
+		std::cerr << ": " << path.interfaces.size() / 2 << " links, MTU " << path.mtu << ", installed "
+			  << std::chrono::duration_cast<std::chrono::seconds>(now - entry.installed).count() << " s ago";
+		if (path.expiry != std::chrono::system_clock::time_point::max())
+			std::cerr << ", expires in "
+				  << std::chrono::duration_cast<std::chrono::seconds>(path.expiry - now).count() << " s";
+		std::cerr << "\n";
+	});
+}
+
 void usage(char *name)
 {
-	std::cout << "usage: " << name << " [-i interface] [-e interface] [-d sciond]\n"
+	std::cout << "usage: " << name << " [-i interface] [-e interface] [-d sciond | -T file | -P file]\n"
 		  << "\n"
 		  << "options:\n"
 		  << "  -i interface          Specify ingress interface to attach to\n"
@@ -39,7 +87,48 @@ void usage(char *name)
 		  << "  -e interface          Specify egress interface to attach to\n"
 		  << "  --egress=interface    Alias for -e\n"
 		  << "  -d sciond             Address of SCION daemon (IP:port)\n"
-		  << "  --sciond=sciond       Alias for -d\n";
+		  << "  --sciond=sciond       Alias for -d\n"
+		  << "  -T file               Look up path segments at the control service of the local\n"
+		  << "                        AS given by its topology.json instead of the SCION daemon\n"
+		  << "  --topology=file       Alias for -T\n"
+		  << "  -B addr               Trust SCMP messages and reply paths forwarded by the border\n"
+		  << "                        router with this internal address (IP:port), may be\n"
+		  << "                        repeated. All routers listed in the topology given with\n"
+		  << "                        -T are trusted as well\n"
+		  << "  --border-router=addr  Alias for -B\n"
+		  << "  -P file               Read paths from file instead of querying the SCION daemon\n"
+		  << "  --paths=file          Alias for -P\n"
+		  << "  -w file               Resolve the destinations (one ISD-AS per line) in file\n"
+		  << "                        before attaching the egress translator\n"
+		  << "  --warm=file           Alias for -w\n"
+		  << "  -H file               Persist the most used destinations to file periodically\n"
+		  << "                        and warm up from it on the next start\n"
+		  << "  --hot-set=file        Alias for -H\n"
+		  << "  -s file               Save the path cache to file periodically and restore\n"
+		  << "                        still valid paths from it on start\n"
+		  << "  --snapshot=file       Alias for -s\n"
+		  << "  -r file               Read path ranking policies from file\n"
+		  << "  --policy=file         Alias for -r\n"
+		  << "  -p rate               Probe the paths to the most used destinations with up to\n"
+		  << "                        rate probes per second and prefer the fastest\n"
+		  << "  --probe=rate          Alias for -p\n"
+		  << "  -I ms                 Interval between probes on the same path (default 1000)\n"
+		  << "  --probe-interval=ms   Alias for -I\n"
+		  << "  -S bits               Key destinations by ISD-AS and the subnet ID of this many\n"
+		  << "                        bits in their SCION-mapped address (0-24, default 0)\n"
+		  << "  --subnet-bits=bits    Alias for -S\n"
+		  << "  -m file               Read SCION addresses of IPv6 prefixes outside of fc00::/8\n"
+		  << "                        from file, reloaded on SIGHUP\n"
+		  << "  --addr-map=file       Alias for -m\n"
+		  << "  -L file               Rate limit the destinations listed in file, reloaded on SIGHUP\n"
+		  << "  --rate-limits=file    Alias for -L\n"
+		  << "  -c file               Write a sample of the translated packets before and after\n"
+		  << "                        translation to file (pcapng), SIGUSR1 pauses and resumes\n"
+		  << "  --capture=file        Alias for -c\n"
+		  << "  -C n                  Capture one in n translated packets (default 1000)\n"
+		  << "  --capture-rate=n      Alias for -C\n"
+		  << "\n"
+		  << "Send SIGUSR2 to print the installed paths.\n";
 	std::exit(EXIT_SUCCESS);
 }
 
@@ -48,21 +137,40 @@ static struct option longopts[] = {
   { "ingress", required_argument, NULL, 'i' },
   { "egress", required_argument, NULL, 'e' },
   { "sciond", required_argument, NULL, 'd' },
+  { "topology", required_argument, NULL, 'T' },
+  { "border-router", required_argument, NULL, 'B' },
+  { "paths", required_argument, NULL, 'P' },
+  { "warm", required_argument, NULL, 'w' },
+  { "hot-set", required_argument, NULL, 'H' },
+  { "snapshot", required_argument, NULL, 's' },
+  { "policy", required_argument, NULL, 'r' },
+  { "probe", required_argument, NULL, 'p' },
+  { "probe-interval", required_argument, NULL, 'I' },
+  { "subnet-bits", required_argument, NULL, 'S' },
+  { "addr-map", required_argument, NULL, 'm' },
+  { "rate-limits", required_argument, NULL, 'L' },
+  { "capture", required_argument, NULL, 'c' },
+  { "capture-rate", required_argument, NULL, 'C' },
   { NULL, 0, NULL, 0 } };
 // clang-format on
 
 int main(int argc, char **argv)
 {
 	int ch;
-	std::string in_if, eg_if, sciond;
+	std::string in_if, eg_if, sciond, topologyFile, pathFile, warmFile, hotSetFile, snapshotFile, policyFile,
+		addrMapFile, rateLimitFile, captureFile;
 	struct bpf_map *pathMap;
+	std::optional<ProbeConfig> probeConfig;
+	unsigned long subnetBits = 0;
+	std::uint32_t captureRate = 1000;
+	std::vector<std::array<std::uint8_t, 16>> trustedRouters;
 
 	libbpf_set_print(libbpf_print_fn);
 
 	// Parse commandline arguments
 	if (argc < 2)
 		usage(argv[0]);
-	while ((ch = getopt_long(argc, argv, "d:e:i:", longopts, NULL)) != -1) {
+	while ((ch = getopt_long(argc, argv, "d:e:i:T:B:P:w:H:s:r:p:I:S:m:L:c:C:", longopts, NULL)) != -1) {
 		switch (ch) {
 		case 'i':
 			in_if = optarg;
@@ -73,6 +181,67 @@ int main(int argc, char **argv)
 		case 'd':
 			sciond = optarg;
 			break;
+		case 'T':
+			topologyFile = optarg;
+			break;
+		case 'B': {
+			std::array<std::uint8_t, 16> addr;
+			std::uint16_t port;
+			if (!parseUnderlay(optarg, addr, port)) {
+				std::cerr << "Invalid border router address " << optarg << "\n";
+				return EXIT_FAILURE;
+			}
+			trustedRouters.push_back(addr);
+			break;
+		}
+		case 'P':
+			pathFile = optarg;
+			break;
+		case 'w':
+			warmFile = optarg;
+			break;
+		case 'H':
+			hotSetFile = optarg;
+			break;
+		case 's':
+			snapshotFile = optarg;
+			break;
+		case 'r':
+			policyFile = optarg;
+			break;
+		case 'p':
+			if (!probeConfig)
+				probeConfig.emplace();
+			probeConfig->rate = std::stoul(optarg);
+			break;
+		case 'I':
+			if (!probeConfig)
+				probeConfig.emplace();
+			probeConfig->interval = std::chrono::milliseconds(std::stoul(optarg));
+			break;
+		case 'm':
+			addrMapFile = optarg;
+			break;
+		case 'L':
+			rateLimitFile = optarg;
+			break;
+		case 'c':
+			captureFile = optarg;
+			break;
+		case 'C':
+			captureRate = std::stoul(optarg);
+			if (captureRate == 0) {
+				std::cerr << "Capture rate must be at least 1, pause a capture with SIGUSR1\n";
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'S':
+			subnetBits = std::stoul(optarg);
+			if (subnetBits > SCION_MAPPING_MAX_SUBNET_BITS) {
+				std::cerr << "Subnet ID must be at most " << SCION_MAPPING_MAX_SUBNET_BITS << " bits\n";
+				return EXIT_FAILURE;
+			}
+			break;
 		// Print usage
 		default:
 			usage(argv[0]);
@@ -80,13 +249,14 @@ int main(int argc, char **argv)
 	}
 
   // Make sure all required arguments are present
-	if ((eg_if.empty()  && in_if.empty()) || (!eg_if.empty() && sciond.empty())) {
+	if ((eg_if.empty()  && in_if.empty()) || (!eg_if.empty() && sciond.empty() && topologyFile.empty() && pathFile.empty())) {
 		std::cerr << "Missing argument\n";
 		return EXIT_FAILURE;
 	}
 
 	// Register signal handler for graceful shutdown
-	if (signal(SIGINT, sig_int) == SIG_ERR) {
+	if (signal(SIGINT, sig_int) == SIG_ERR || signal(SIGHUP, sig_hup) == SIG_ERR
+		|| signal(SIGUSR1, sig_usr1) == SIG_ERR || signal(SIGUSR2, sig_usr2) == SIG_ERR) {
 		std::cerr << "Can't set signal handler: " << strerror(errno) << "\n";
 		return EXIT_FAILURE;
 	}
@@ -95,60 +265,215 @@ int main(int argc, char **argv)
 	IngressLoader inLoader{};
   if(!in_if.empty()) {
     try {
+      inLoader.setSubnetBits(subnetBits);
       inLoader.attach(in_if);
       std::cerr << "Successfully attached to ingress interface " << in_if << '\n';
     } catch (const std::exception &e) {
       std::cerr << "Could not attach ingress translator to interface " << in_if << '\n';
       return EXIT_FAILURE;
     }
+
+    // SCMP messages and reply paths are unauthenticated, only those forwarded by our own border routers are believed
+    try {
+      if (!topologyFile.empty()) {
+        auto routers = ControlServicePathSource::borderRouters(topologyFile);
+        trustedRouters.insert(trustedRouters.end(), routers.begin(), routers.end());
+      }
+      for (const auto &addr : trustedRouters)
+        inLoader.trustRouter(addr);
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << '\n';
+      return EXIT_FAILURE;
+    }
+    if (trustedRouters.empty())
+      std::cerr << "No border routers given with -B or -T, SCMP messages and reply paths are ignored\n";
   }
 
-  // Attach TC program to egress interface
 	EgressLoader egLoader{};
+	std::optional<PathService> pathService;
+	std::optional<AddressMap> addressMap;
+	std::optional<Policer> policer;
+	std::jthread policerThread;
+	std::jthread pathServiceThread;
+
   if(!eg_if.empty()) {
+    // Load the egress program, it is attached after the Path Cache has been warmed up
     try {
-      egLoader.attach(eg_if);
-      std::cerr << "Successfully attached to egress interface " << eg_if << '\n';
+      egLoader.setSubnetBits(subnetBits);
+      if (!addrMapFile.empty())
+        egLoader.enableAddressMap();
+      if (!rateLimitFile.empty())
+        egLoader.enablePolicing();
+      egLoader.open();
+      // Replies to inbound flows can reuse the reversed paths recorded by the ingress program
+      if (!in_if.empty())
+        egLoader.shareReplyMap(inLoader.replyMap());
+      egLoader.load();
     } catch (const std::exception &e) {
-      std::cerr << "Could not attach egress translator to interface " << eg_if << '\n';
+      std::cerr << "Could not load egress translator\n";
       return EXIT_FAILURE;
     }
-  } else {
-    // Kinda bad practice here, but PathService is unfortunately implemented
-    // in a way that makes this easier. Problem for future-me :^)
-    goto start_loop;
-  }
 
-  // Obtain handle for the Path Cache BPF map
-	try {
-		pathMap = egLoader.pathMap();
-	} catch (std::exception &e) {
-		std::cerr << "Could not obtain path map handle\n";
-		return EXIT_FAILURE;
-	}
+    // Obtain handle for the Path Cache BPF map
+    try {
+      pathMap = egLoader.pathMap();
+    } catch (std::exception &e) {
+      std::cerr << "Could not obtain path map handle\n";
+      return EXIT_FAILURE;
+    }
 
-	PathService pathService(pathMap, egLoader.requestQueue());
+    // Destinations outside of fc00::/8 must be mapped before the first packet is seen
+    if (!addrMapFile.empty()) {
+      // Replies of hosts with an explicit SCION host address are translated back on ingress
+      addressMap.emplace(egLoader.addressMap(), in_if.empty() ? nullptr : inLoader.addressReverseMap());
+      try {
+        std::cerr << "Loaded " << addressMap->load(addrMapFile) << " address mappings\n";
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+      }
+    }
 
-  // Initialize Path Service, connecting to the SCION daemon
-	try {
-		pathService.init(sciond);
-	} catch (std::exception &e) {
-		std::cerr << "Could not connect to SCION Daemon\n";
-		return EXIT_FAILURE;
-	}
+    // Rate limits apply from the first packet on, drops are reported even without them
+    try {
+      policer.emplace(egLoader.policeConfig(), egLoader.policeState(), egLoader.dropStats());
+      if (!rateLimitFile.empty())
+        std::cerr << "Loaded " << policer->load(rateLimitFile) << " rate limits\n";
+    } catch (const std::exception &e) {
+      std::cerr << e.what() << '\n';
+      return EXIT_FAILURE;
+    }
 
-  // Run Path Service in separate thread
-	std::jthread pathServiceThread([&pathService]() {
-    std::cerr << "Starting Path Service\n";
+    pathService.emplace(pathMap, egLoader.requestQueue(), egLoader.pathStats(), egLoader.negativeCache());
+
+    if (!policyFile.empty()) {
+      try {
+        pathService->ranking().loadPolicies(policyFile);
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+      }
+    }
+
+    // Restore the last known good paths, they do not depend on the daemon
+    std::size_t restored = 0;
+    if (!snapshotFile.empty()) {
+      try {
+        restored = pathService->loadSnapshot(snapshotFile);
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+      }
+      pathService->setSnapshotFile(snapshotFile);
+    }
+
+    // Initialize Path Service, connecting to the SCION daemon
+    std::unique_ptr<PathSource> source;
+    if (!pathFile.empty())
+      source = std::make_unique<FilePathSource>(pathFile);
+    else if (!topologyFile.empty())
+      source = std::make_unique<ControlServicePathSource>(topologyFile);
+    else
+      source = std::make_unique<DaemonPathSource>(sciond);
     try {
-      pathService.run();
+      pathService->init(std::move(source));
     } catch (std::exception &e) {
-      std::cerr << "An error in the Path Service has occured\n";
-      exiting = 1;
+      if (restored == 0) {
+        std::cerr << "Could not connect to path source\n";
+        return EXIT_FAILURE;
+      }
+      std::cerr << "Path source not reachable, forwarding with paths from snapshot\n";
+    }
+
+    // Pre-populate the Path Cache with known destinations
+    std::vector<scion_addr> warmDests;
+    for (const auto &file : {warmFile, hotSetFile}) {
+      if (file.empty()) continue;
+      try {
+        auto dests = PathService::readDestinations(file);
+        warmDests.insert(warmDests.end(), dests.begin(), dests.end());
+      } catch (const std::exception &e) {
+        // A missing hot set is expected on the first start
+        std::cerr << e.what() << '\n';
+      }
+    }
+    if (!warmDests.empty()) {
+      std::sort(warmDests.begin(), warmDests.end());
+      warmDests.erase(std::unique(warmDests.begin(), warmDests.end()), warmDests.end());
+      pathService->warmUp(warmDests);
+    }
+    if (!hotSetFile.empty())
+      pathService->setHotSetFile(hotSetFile);
+
+    // Failover on SCMP interface down messages seen by the ingress translator
+    if (!in_if.empty()) {
+      try {
+        pathService->watchScmp(inLoader.scmpEvents());
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+      }
+    }
+
+    if (probeConfig) {
+      try {
+        pathService->enableProbing(*probeConfig);
+      } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return EXIT_FAILURE;
+      }
     }
-  });
 
-start_loop:
+    // Attach TC program to egress interface
+    try {
+      egLoader.attach(eg_if);
+      std::cerr << "Successfully attached to egress interface " << eg_if << '\n';
+    } catch (const std::exception &e) {
+      std::cerr << "Could not attach egress translator to interface " << eg_if << '\n';
+      return EXIT_FAILURE;
+    }
+
+    policerThread = std::jthread([&policer](std::stop_token stop) { policer->run(stop); });
+
+    // Run Path Service in separate thread
+    pathServiceThread = std::jthread([&pathService]() {
+      std::cerr << "Starting Path Service\n";
+      try {
+        pathService->run();
+      } catch (std::exception &e) {
+        std::cerr << "An error in the Path Service has occured\n";
+        exiting = 1;
+      }
+    });
+  }
+
+	// Sampled packets of both translators end up in the same file
+	std::optional<PacketCapture> capture;
+	std::jthread captureThread;
+	bool capturing = !captureFile.empty();
+	auto setCaptureRate = [&](std::uint32_t rate) {
+		if (!in_if.empty())
+			inLoader.setCaptureRate(rate);
+		if (!eg_if.empty())
+			egLoader.setCaptureRate(rate);
+	};
+	if (capturing) {
+		try {
+			capture.emplace(captureFile);
+			if (!in_if.empty())
+				capture->watch(inLoader.captureBuffer());
+			if (!eg_if.empty())
+				capture->watch(egLoader.captureBuffer());
+		} catch (const std::exception &e) {
+			std::cerr << e.what() << '\n';
+			return EXIT_FAILURE;
+		}
+		captureThread = std::jthread([&capture](std::stop_token stop) {
+			while (!stop.stop_requested())
+				capture->poll(100 /*ms*/);
+		});
+		setCaptureRate(captureRate);
+		std::cerr << "Capturing one in " << captureRate << " packets to " << captureFile << '\n';
+	}
+
 	std::cout << "Successfully started! Please run `sudo cat /sys/kernel/debug/tracing/trace_pipe` "
 		     "to see output of the BPF program.\n";
 
@@ -156,6 +481,38 @@ start_loop:
 	while (!exiting) {
 		std::cerr << ".";
     std::this_thread::sleep_for(1s);
+
+    if (captureToggled && capture) {
+      captureToggled = 0;
+      capturing = !capturing;
+      setCaptureRate(capturing ? captureRate : 0);
+      std::cerr << (capturing ? "Resumed" : "Paused") << " packet capture\n";
+    }
+
+    if (tableRequested && pathService) {
+      tableRequested = 0;
+      printPathTable(pathService->table());
+    }
+
+    // Unreachable destinations may have become reachable, look them up again
+    if (topologyChanged && pathService) {
+      topologyChanged = 0;
+      pathService->onTopologyChange();
+      if (addressMap) {
+        try {
+          std::cerr << "Reloaded " << addressMap->load(addrMapFile) << " address mappings\n";
+        } catch (const std::exception &e) {
+          std::cerr << e.what() << '\n';
+        }
+      }
+      if (policer && !rateLimitFile.empty()) {
+        try {
+          std::cerr << "Reloaded " << policer->load(rateLimitFile) << " rate limits\n";
+        } catch (const std::exception &e) {
+          std::cerr << e.what() << '\n';
+        }
+      }
+    }
 	}
 
 	return EXIT_SUCCESS;
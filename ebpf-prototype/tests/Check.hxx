@@ -0,0 +1,22 @@
+#ifndef CHECK_HXX_GUARD_
+#define CHECK_HXX_GUARD_
+
+#include <iostream>
+
+/// Minimal assertions for the unit tests
+///
+/// A failed CHECK is reported but does not abort the test, main() returns
+/// TEST_RESULT() so that ctest sees the failure.
+inline int checkFailures = 0;
+
+#define CHECK(expr) \
+	do { \
+		if (!(expr)) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #expr ") failed\n"; \
+			++checkFailures; \
+		} \
+	} while (0)
+
+#define TEST_RESULT() (checkFailures == 0 ? 0 : 1)
+
+#endif // CHECK_HXX_GUARD_
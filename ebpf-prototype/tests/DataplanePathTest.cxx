@@ -0,0 +1,102 @@
+#include <cstdint>
+#include <vector>
+
+#include "DataplanePath.hxx"
+
+#include "Check.hxx"
+
+/// Encode a standard path with the given segment lengths
+///
+/// The number of info fields and hop fields can be overridden to build
+/// inconsistent paths. Hop field `i` has ingress 2i + 1 and egress 2i + 2.
+static std::vector<std::uint8_t> encode(unsigned seg0, unsigned seg1, unsigned seg2, int numInf = -1,
+	int numHops = -1, std::uint32_t timestamp = 1'700'000'000)
+{
+	if (numInf < 0)
+		numInf = (seg0 != 0) + (seg1 != 0) + (seg2 != 0);
+	if (numHops < 0)
+		numHops = seg0 + seg1 + seg2;
+
+	std::uint32_t meta = (seg0 << 12) | (seg1 << 6) | seg2;
+	std::vector<std::uint8_t> raw = {
+		std::uint8_t(meta >> 24), std::uint8_t(meta >> 16), std::uint8_t(meta >> 8), std::uint8_t(meta)
+	};
+	for (int i = 0; i < numInf; ++i) {
+		std::uint8_t ts[4] = { std::uint8_t(timestamp >> 24), std::uint8_t(timestamp >> 16),
+			std::uint8_t(timestamp >> 8), std::uint8_t(timestamp) };
+		raw.insert(raw.end(), { 0x01, 0, 0, std::uint8_t(i), ts[0], ts[1], ts[2], ts[3] });
+	}
+	for (int i = 0; i < numHops; ++i) {
+		raw.insert(raw.end(), { 0, 63, 0, std::uint8_t(2 * i + 1), 0, std::uint8_t(2 * i + 2) });
+		raw.insert(raw.end(), 6, 0xaa);
+	}
+	return raw;
+}
+
+static void testValid()
+{
+	auto path = decodePath(encode(2, 0, 0));
+	CHECK(path);
+	CHECK(path->infos.size() == 1);
+	CHECK(path->hops.size() == 2);
+	CHECK(path->infos[0].consDir);
+	CHECK(path->hops[1].consIngress == 3 && path->hops[1].consEgress == 4);
+
+	path = decodePath(encode(2, 3, 4));
+	CHECK(path);
+	CHECK(path->infos.size() == 3);
+	CHECK(path->hops.size() == 9);
+	CHECK(path->infoIndex(0) == 0 && path->infoIndex(1) == 0);
+	CHECK(path->infoIndex(2) == 1 && path->infoIndex(4) == 1);
+	CHECK(path->infoIndex(5) == 2 && path->infoIndex(8) == 2);
+}
+
+static void testEmpty()
+{
+	auto path = decodePath({});
+	CHECK(path);
+	CHECK(path->hops.empty());
+	CHECK(path->expiry() == std::chrono::system_clock::time_point::max());
+
+	// A path meta header without segments is not an empty path
+	CHECK(!decodePath(encode(0, 0, 0)));
+}
+
+static void testSegmentGaps()
+{
+	// Sized for the segments in front of the gap
+	CHECK(!decodePath(encode(5, 0, 3, 1, 5)));
+	// Sized for all segments
+	CHECK(!decodePath(encode(5, 0, 3, 2, 8)));
+	CHECK(!decodePath(encode(0, 3, 0, 1, 3)));
+	CHECK(!decodePath(encode(0, 0, 3, 1, 3)));
+	CHECK(!decodePath(encode(0, 2, 3, 2, 5)));
+}
+
+static void testLength()
+{
+	auto raw = encode(2, 2, 0);
+	raw.pop_back();
+	CHECK(!decodePath(raw));
+	CHECK(!decodePath(encode(2, 2, 0, 2, 3)));
+	CHECK(!decodePath(encode(2, 2, 0, 1, 4)));
+	CHECK(!decodePath(std::vector<std::uint8_t>{ 0, 0 }));
+}
+
+static void testExpiry()
+{
+	// expTime 63 is (1 + 63) * 337.5 s = 6 h after the info field timestamp
+	auto path = decodePath(encode(2, 0, 0, -1, -1, 1000));
+	CHECK(path);
+	CHECK(path->expiry() == std::chrono::system_clock::time_point(std::chrono::seconds(1000 + 6 * 3600)));
+}
+
+int main()
+{
+	testValid();
+	testEmpty();
+	testSegmentGaps();
+	testLength();
+	testExpiry();
+	return TEST_RESULT();
+}
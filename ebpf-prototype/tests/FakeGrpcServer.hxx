@@ -0,0 +1,116 @@
+#ifndef FAKE_GRPC_SERVER_HXX_GUARD_
+#define FAKE_GRPC_SERVER_HXX_GUARD_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <grpcpp/generic/async_generic_service.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/server.h>
+#include <grpcpp/server_builder.h>
+#include <grpcpp/support/byte_buffer.h>
+
+/// gRPC server on localhost answering unary calls with canned protobuf responses
+///
+/// Handlers are registered by full method name, e.g.
+/// "/proto.daemon.v1.DaemonService/Paths", and receive the serialized request.
+class FakeGrpcServer {
+    public:
+	using Handler = std::function<std::string(const std::string &request)>;
+
+	explicit FakeGrpcServer(std::map<std::string, Handler> handlers)
+		: service(std::move(handlers), calls, mutex)
+	{
+		grpc::ServerBuilder builder;
+		builder.AddListeningPort("127.0.0.1:0", grpc::InsecureServerCredentials(), &port);
+		builder.RegisterCallbackGenericService(&service);
+		server = builder.BuildAndStart();
+	}
+
+	~FakeGrpcServer() { server->Shutdown(); }
+
+	/// Stop answering, later calls fail as if the server was unreachable
+	void shutdown() { server->Shutdown(); }
+
+	std::string address() const { return "127.0.0.1:" + std::to_string(port); }
+
+	/// Methods called so far
+	std::vector<std::string> called()
+	{
+		std::lock_guard lock(mutex);
+		return calls;
+	}
+
+    private:
+	class Reactor : public grpc::ServerGenericBidiReactor {
+	    public:
+		Reactor(const std::string &method, const Handler *handler)
+			: handler(handler)
+		{
+			if (!handler)
+				Finish(grpc::Status(grpc::StatusCode::UNIMPLEMENTED, method));
+			else
+				StartRead(&request);
+		}
+
+		void OnReadDone(bool ok) override
+		{
+			if (!ok) {
+				Finish(grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "no request"));
+				return;
+			}
+			std::vector<grpc::Slice> slices;
+			request.Dump(&slices);
+			std::string raw;
+			for (const auto &slice : slices)
+				raw.append(reinterpret_cast<const char *>(slice.begin()), slice.size());
+
+			grpc::Slice slice((*handler)(raw));
+			response = grpc::ByteBuffer(&slice, 1);
+			StartWriteAndFinish(&response, grpc::WriteOptions(), grpc::Status::OK);
+		}
+
+		void OnDone() override { delete this; }
+
+	    private:
+		const Handler *handler;
+		grpc::ByteBuffer request, response;
+	};
+
+	class Service : public grpc::CallbackGenericService {
+	    public:
+		Service(std::map<std::string, FakeGrpcServer::Handler> handlers, std::vector<std::string> &calls, std::mutex &mutex)
+			: handlers(std::move(handlers))
+			, calls(calls)
+			, mutex(mutex)
+		{
+		}
+
+		grpc::ServerGenericBidiReactor *CreateReactor(grpc::GenericCallbackServerContext *ctx) override
+		{
+			{
+				std::lock_guard lock(mutex);
+				calls.push_back(ctx->method());
+			}
+			auto handler = handlers.find(ctx->method());
+			return new Reactor(ctx->method(), handler == handlers.end() ? nullptr : &handler->second);
+		}
+
+	    private:
+		std::map<std::string, FakeGrpcServer::Handler> handlers;
+		std::vector<std::string> &calls;
+		std::mutex &mutex;
+	};
+
+	std::vector<std::string> calls;
+	std::mutex mutex;
+	Service service;
+	int port = 0;
+	std::unique_ptr<grpc::Server> server;
+};
+
+#endif // FAKE_GRPC_SERVER_HXX_GUARD_
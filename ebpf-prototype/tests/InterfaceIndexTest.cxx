@@ -0,0 +1,102 @@
+#include <cstdint>
+#include <vector>
+
+#include "InterfaceIndex.hxx"
+
+#include "Check.hxx"
+
+static constexpr std::uint64_t A = 0x0001'ff00'0000'0111;
+static constexpr std::uint64_t C1 = 0x0001'ff00'0000'0110;
+static constexpr std::uint64_t C2 = 0x0002'ff00'0000'0210;
+static constexpr std::uint64_t D = 0x0002'ff00'0000'0211;
+
+/// Single segment path of `hops` hop fields, hop field `i` has ingress 2i + 1 and egress 2i + 2
+static PathInfo rawPath(std::uint64_t dst, unsigned hops)
+{
+	PathInfo path;
+	path.src = A;
+	path.dst = dst;
+	path.dp = { 0, 0, std::uint8_t(hops << 4), 0 };
+	path.dp.insert(path.dp.end(), { 0x01, 0, 0, 0, 0x65, 0x53, 0xf1, 0x00 });
+	for (unsigned i = 0; i < hops; ++i) {
+		path.dp.insert(path.dp.end(), { 0, 63, 0, std::uint8_t(2 * i + 1), 0, std::uint8_t(2 * i + 2) });
+		path.dp.insert(path.dp.end(), 6, 0xaa);
+	}
+	return path;
+}
+
+/// Path A 1 -> 6 C1 5 -> 2 C2 3 -> 11 D with interface metadata
+static PathInfo metaPath()
+{
+	PathInfo path;
+	path.src = A;
+	path.dst = D;
+	path.interfaces = { { A, 1 }, { C1, 6 }, { C1, 5 }, { C2, 2 }, { C2, 3 }, { D, 11 } };
+	return path;
+}
+
+static void testMetadata()
+{
+	InterfaceIndex index;
+	auto dst = toScionAddr(D);
+	index.add(dst, metaPath());
+
+	CHECK(index.lookup(C1, 6) == std::vector<scion_addr>{ dst });
+	CHECK(index.lookup(D, 11) == std::vector<scion_addr>{ dst });
+	CHECK(index.lookup(C2, 6).empty());
+	CHECK(index.lookup(C1, 1).empty());
+
+	CHECK(InterfaceIndex::traverses(metaPath(), C1, 5));
+	CHECK(InterfaceIndex::traverses(metaPath(), C1, 6, 5));
+	CHECK(InterfaceIndex::traverses(metaPath(), C1, 5, 6));
+	CHECK(!InterfaceIndex::traverses(metaPath(), C1, 6, 7));
+	CHECK(!InterfaceIndex::traverses(metaPath(), C2, 6));
+}
+
+static void testDataplaneOnly()
+{
+	// Only the first and last AS of a path without metadata are known
+	InterfaceIndex index;
+	auto dst = toScionAddr(D);
+	auto path = rawPath(D, 3);
+	index.add(dst, path);
+
+	CHECK(index.lookup(A, 2) == std::vector<scion_addr>{ dst });
+	CHECK(index.lookup(D, 5) == std::vector<scion_addr>{ dst });
+	CHECK(InterfaceIndex::traverses(path, A, 2));
+	CHECK(InterfaceIndex::traverses(path, D, 5));
+
+	// Interface IDs of intermediate hops are meaningless without their AS
+	CHECK(index.lookup(C1, 3).empty());
+	CHECK(index.lookup(0, 3).empty());
+	CHECK(!InterfaceIndex::traverses(path, C1, 3));
+	CHECK(!InterfaceIndex::traverses(path, C1, 3, 4));
+	CHECK(!InterfaceIndex::traverses(path, 0, 4));
+}
+
+static void testRemove()
+{
+	InterfaceIndex index;
+	auto d = toScionAddr(D), c2 = toScionAddr(C2);
+	index.add(d, metaPath());
+	index.add(c2, rawPath(C2, 2));
+	CHECK(index.size() == 2);
+	CHECK(index.lookup(A, 1).size() == 2);
+	CHECK(index.lookup(A, 2) == std::vector<scion_addr>{ c2 });
+
+	index.remove(d);
+	CHECK(index.size() == 1);
+	CHECK(index.lookup(C1, 6).empty());
+	CHECK(index.lookup(A, 2) == std::vector<scion_addr>{ c2 });
+	index.remove(d);
+	index.remove(c2);
+	CHECK(index.size() == 0 && index.lookup(A, 2).empty());
+}
+
+int main()
+{
+	testMetadata();
+	testDataplaneOnly();
+	testRemove();
+	return TEST_RESULT();
+}
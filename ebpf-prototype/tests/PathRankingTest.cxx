@@ -0,0 +1,213 @@
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "PathRanking.hxx"
+
+#include "Check.hxx"
+
+using namespace std::chrono_literals;
+
+static constexpr std::uint64_t A = 0x0001'ff00'0000'0111;
+static constexpr std::uint64_t B = 0x0001'ff00'0000'0110;
+static constexpr std::uint64_t D = 0x0002'ff00'0000'0211;
+
+static const auto NOW = std::chrono::system_clock::time_point(1'700'000'000s);
+
+static bool near(double a, double b)
+{
+	return std::abs(a - b) < 1e-9;
+}
+
+/// Path with `hops` hop fields in a single segment through the given interfaces
+static PathInfo path(unsigned hops, std::vector<std::uint64_t> ifids)
+{
+	PathInfo info;
+	info.src = A;
+	info.dst = D;
+	info.dp = { 0, 0, 0, static_cast<std::uint8_t>(hops) };
+	for (auto ifid : ifids)
+		info.interfaces.push_back({ A, ifid });
+	return info;
+}
+
+static void testScore()
+{
+	PathRanking ranking;
+	RankingPolicy policy;
+
+	// Without metadata only the hop count counts
+	auto p = path(4, { 1, 2 });
+	CHECK(near(*ranking.score(p, policy, NOW), -4.0));
+
+	p.mtu = 1400;
+	p.expiry = NOW + 2h;
+	p.latency = { 1000us, 3000us };
+	p.bandwidth = { 2'000'000, 0, 500'000 };
+	// -4 hops + 1.4 MTU + 0.2 lifetime - 0.04 latency + 0.05 bottleneck bandwidth
+	CHECK(near(*ranking.score(p, policy, NOW), -4.0 + 1.4 + 0.2 - 0.04 + 0.05));
+
+	// Partially known latency is ignored
+	p.latency = { 1000us, -1us };
+	CHECK(near(*ranking.score(p, policy, NOW), -4.0 + 1.4 + 0.2 + 0.05));
+
+	// Measurements are matched by fingerprint
+	ranking.measured(PathRanking::fingerprint(p), { 10ms, 0.02 });
+	CHECK(near(*ranking.score(p, policy, NOW), -4.0 + 1.4 + 0.2 + 0.05 - 0.2 - 1.0));
+	ranking.clearMeasurements();
+	CHECK(near(*ranking.score(p, policy, NOW), -4.0 + 1.4 + 0.2 + 0.05));
+
+	// Policy limits rule paths out
+	policy.minMtu = 1472;
+	CHECK(!ranking.score(p, policy, NOW));
+	p.mtu = 0;
+	CHECK(ranking.score(p, policy, NOW));
+	p.expiry = NOW + 5s;
+	CHECK(!ranking.score(p, policy, NOW));
+}
+
+static void testSelect()
+{
+	PathRanking ranking;
+	PathInfoVec paths = { path(6, { 1, 2, 3 }), path(3, { 4, 5 }), path(5, { 6, 7 }) };
+	CHECK(ranking.select(D, 0, paths, NOW) == 1u);
+
+	// Ties are broken by fingerprint independently of the order
+	PathInfoVec tied = { path(3, { 1, 2 }), path(3, { 3, 4 }) };
+	auto first = ranking.select(D, 0, tied, NOW);
+	CHECK(first);
+	auto chosen = tied[first.value_or(0)].interfaces[0].ifid;
+	std::swap(tied[0], tied[1]);
+	auto second = ranking.select(D, 0, tied, NOW);
+	CHECK(second && tied[*second].interfaces[0].ifid == chosen);
+
+	// Bad measurements move traffic to a longer path
+	ranking.measured(PathRanking::fingerprint(paths[1]), { 200ms, 0.1 });
+	CHECK(ranking.select(D, 0, paths, NOW) == 2u);
+
+	paths[0].expiry = paths[1].expiry = paths[2].expiry = NOW;
+	CHECK(!ranking.select(D, 0, paths, NOW));
+	CHECK(!ranking.select(D, 0, {}, NOW));
+}
+
+static void testPolicyLookup()
+{
+	PathRanking ranking;
+	RankingPolicy any, dst, tc, exact;
+	any.hops = -1;
+	dst.hops = -2;
+	tc.hops = -3;
+	exact.hops = -4;
+	ranking.setPolicy(PathRanking::ANY_DST, PathRanking::ANY_CLASS, any);
+	ranking.setPolicy(D, PathRanking::ANY_CLASS, dst);
+	ranking.setPolicy(PathRanking::ANY_DST, 46, tc);
+	ranking.setPolicy(D, 46, exact);
+
+	CHECK(ranking.policy(D, 46).hops == -4);
+	CHECK(ranking.policy(D, 0).hops == -2);
+	CHECK(ranking.policy(B, 46).hops == -3);
+	CHECK(ranking.policy(B, 0).hops == -1);
+}
+
+static std::filesystem::path writePolicies(const std::string &content)
+{
+	auto file = std::filesystem::temp_directory_path() / ("policies." + std::to_string(getpid()));
+	std::ofstream(file) << content;
+	return file;
+}
+
+static bool loadFails(const std::string &content)
+{
+	PathRanking ranking;
+	auto file = writePolicies(content);
+	bool failed = false;
+	try {
+		ranking.loadPolicies(file);
+	} catch (const std::runtime_error &) {
+		failed = true;
+	}
+	std::filesystem::remove(file);
+	return failed;
+}
+
+static void testLoadPolicies()
+{
+	PathRanking ranking;
+	RankingPolicy old;
+	old.hops = -9;
+	ranking.setPolicy(B, 1, old);
+
+	auto file = writePolicies("# dst class weights\n"
+				  "\n"
+				  "*            *   hops=-2 latency=-0.05\n"
+				  "2-ff00:0:211 *   bandwidth=1 minMtu=1400\n"
+				  "*            46  rtt=-1 loss=-2 minLifetime=60\n");
+	ranking.loadPolicies(file);
+	std::filesystem::remove(file);
+
+	CHECK(ranking.policy(A, 0).hops == -2 && ranking.policy(A, 0).latency == -0.05);
+	// Weights not given are the built-in defaults, not those of the '*' line
+	CHECK(ranking.policy(D, 0).bandwidth == 1 && ranking.policy(D, 0).minMtu == 1400);
+	CHECK(ranking.policy(D, 0).hops == RankingPolicy().hops);
+	CHECK(ranking.policy(A, 46).rtt == -1 && ranking.policy(A, 46).minLifetime == 60s);
+	// Loading replaces existing policies
+	CHECK(ranking.policy(B, 1).hops == -2);
+
+	CHECK(loadFails("1-ff00:0:110\n"));
+	CHECK(loadFails("not-an-ia * hops=1\n"));
+	CHECK(loadFails("* 64 hops=1\n"));
+	CHECK(loadFails("* * hops\n"));
+	CHECK(loadFails("* * hops=x\n"));
+	CHECK(loadFails("* 12abc hops=1\n"));
+	CHECK(loadFails("* * hops=0.5x\n"));
+	CHECK(loadFails("* * hops=\n"));
+	CHECK(loadFails("* * hops=nan\n"));
+	CHECK(loadFails("* * minMtu=-1\n"));
+	CHECK(loadFails("* * minMtu=65536\n"));
+	CHECK(loadFails("* * minLifetime=-60\n"));
+	CHECK(!loadFails("* * minMtu=65535 hops=-1.5e-1\n"));
+	CHECK(loadFails("* * jitter=1\n"));
+
+	bool failed = false;
+	try {
+		ranking.loadPolicies("/nonexistent/policies");
+	} catch (const std::runtime_error &) {
+		failed = true;
+	}
+	CHECK(failed);
+}
+
+static void testFingerprint()
+{
+	auto p = path(4, { 1, 2 });
+	auto fp = PathRanking::fingerprint(p);
+
+	// Refreshed paths have new hop fields but traverse the same interfaces
+	auto refreshed = p;
+	refreshed.dp.push_back(0x42);
+	CHECK(PathRanking::fingerprint(refreshed) == fp);
+
+	CHECK(PathRanking::fingerprint(path(4, { 2, 1 })) != fp);
+	auto otherAs = p;
+	otherAs.interfaces[1].ia = B;
+	CHECK(PathRanking::fingerprint(otherAs) != fp);
+
+	// Without interfaces the dataplane path identifies the path
+	auto raw = path(4, {});
+	auto rawFp = PathRanking::fingerprint(raw);
+	CHECK(rawFp != fp);
+	raw.dp.push_back(0x42);
+	CHECK(PathRanking::fingerprint(raw) != rawFp);
+}
+
+int main()
+{
+	testScore();
+	testSelect();
+	testPolicyLookup();
+	testLoadPolicies();
+	testFingerprint();
+	return TEST_RESULT();
+}
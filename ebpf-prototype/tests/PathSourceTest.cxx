@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <unistd.h>
+
+#include "proto/control_plane/v1/seg.pb.h"
+#include "proto/crypto/v1/signed.pb.h"
+#include "proto/daemon/v1/daemon.pb.h"
+
+#include "Address.hxx"
+#include "ControlServicePathSource.hxx"
+#include "DataplanePath.hxx"
+#include "PathSource.hxx"
+
+#include "Check.hxx"
+#include "FakeGrpcServer.hxx"
+
+using namespace std::chrono_literals;
+namespace cp = proto::control_plane::v1;
+namespace daemon_pb = proto::daemon::v1;
+
+static constexpr std::uint64_t A = 0x0001'ff00'0000'0111;
+static constexpr std::uint64_t C1 = 0x0001'ff00'0000'0110;
+static constexpr std::uint64_t C2 = 0x0002'ff00'0000'0210;
+static constexpr std::uint64_t D = 0x0002'ff00'0000'0211;
+static constexpr std::uint64_t ISD1 = 0x0001'0000'0000'0000;
+static constexpr std::uint64_t ISD2 = 0x0002'0000'0000'0000;
+
+/// Temporary file removed at the end of the test
+struct TempFile {
+	std::filesystem::path path;
+
+	TempFile(const std::string &name, const std::string &content)
+		: path(std::filesystem::temp_directory_path() / (name + "." + std::to_string(getpid())))
+	{
+		std::ofstream(path) << content;
+	}
+
+	~TempFile() { std::filesystem::remove(path); }
+};
+
+static void testFileSource()
+{
+	TempFile file("paths", "# dst src next-hop mtu expiry path latency bandwidth\n"
+			       "1-ff00:0:2 1-ff00:0:1 [fc00:10fc::1]:30042 1472 1767225600 - 1000,2000 100000,50000\n"
+			       "1-ff00:0:2 1-ff00:0:1 192.0.2.1:30043 1400 1767225600 -\n"
+			       "1-ff00:0:3 1-ff00:0:1 [fc00:10fc::1]:30042 1472 1767225600 -\n"
+			       "1-ff00:0:4 1-ff00:0:1 not-an-address 1472 1767225600 -\n");
+	FilePathSource source(file.path);
+	CHECK(source.connect());
+
+	auto result = source.query(*parseIsdAsn("1-ff00:0:2"));
+	CHECK(result && result->size() == 2);
+	if (!result || result->size() != 2)
+		return;
+	const auto &paths = *result;
+	CHECK(paths[0].mtu == 1472 && paths[0].nextHopPort == 30042);
+	CHECK(paths[0].latency == std::vector<std::chrono::microseconds>({ 1000us, 2000us }));
+	CHECK(paths[0].bandwidth == std::vector<std::uint64_t>({ 100000, 50000 }));
+	CHECK(paths[0].expiry == std::chrono::system_clock::time_point(std::chrono::seconds(1767225600)));
+	// IPv4 next hops are IPv4-mapped
+	std::array<std::uint8_t, 16> mapped = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 192, 0, 2, 1 };
+	CHECK(paths[1].nextHop == mapped && paths[1].latency.empty());
+
+	result = source.query(*parseIsdAsn("1-ff00:0:4"));
+	CHECK(result && result->empty());
+	CHECK(!FilePathSource("/nonexistent/paths").connect());
+}
+
+static void testDaemonSource()
+{
+	FakeGrpcServer daemon({
+		{ "/proto.daemon.v1.DaemonService/AS",
+			[](const std::string &) {
+				daemon_pb::ASResponse response;
+				response.set_isd_as(A);
+				return response.SerializeAsString();
+			} },
+		{ "/proto.daemon.v1.DaemonService/Paths",
+			[](const std::string &raw) {
+				daemon_pb::PathsRequest request;
+				request.ParseFromString(raw);
+				daemon_pb::PathsResponse response;
+				if (request.destination_isd_as() != D)
+					return response.SerializeAsString();
+				auto *path = response.add_paths();
+				path->set_raw(std::string("\x00\x00\x20\x00", 4));
+				path->mutable_interface()->mutable_address()->set_address("10.0.0.1:30042");
+				path->set_mtu(1400);
+				path->mutable_expiration()->set_seconds(1767225600);
+				for (auto [ia, id] : { std::pair(A, 41), std::pair(D, 11) }) {
+					auto *iface = path->add_interfaces();
+					iface->set_isd_as(ia);
+					iface->set_id(id);
+				}
+				// Unknown latencies are negative
+				path->add_latency()->set_nanos(-1);
+				path->add_bandwidth(100000);
+				return response.SerializeAsString();
+			} },
+	});
+
+	DaemonPathSource source(daemon.address());
+	CHECK(source.connect());
+	auto result = source.query(D);
+	CHECK(result && result->size() == 1);
+	if (!result || result->empty())
+		return;
+	const auto &paths = *result;
+	CHECK(paths[0].src == A && paths[0].dst == D);
+	CHECK(paths[0].mtu == 1400 && paths[0].nextHopPort == 30042);
+	CHECK(paths[0].nextHop[10] == 0xff && paths[0].nextHop[12] == 10 && paths[0].nextHop[15] == 1);
+	CHECK(paths[0].interfaces.size() == 2 && paths[0].interfaces[1].ifid == 11);
+	CHECK(paths[0].latency == std::vector<std::chrono::microseconds>({ -1us }));
+	CHECK(paths[0].bandwidth == std::vector<std::uint64_t>({ 100000 }));
+	CHECK(paths[0].expiry == std::chrono::system_clock::time_point(std::chrono::seconds(1767225600)));
+
+	// No paths is an answer, an unreachable daemon is not
+	result = source.query(C2);
+	CHECK(result && result->empty());
+	CHECK(!DaemonPathSource("127.0.0.1:1").connect());
+	daemon.shutdown();
+	CHECK(!source.query(D));
+}
+
+/// Encode a segment like the control service, entries are (ISD-AS, ingress, egress)
+static cp::PathSegment encodeSegment(std::uint16_t segId,
+	std::initializer_list<std::tuple<std::uint64_t, std::uint16_t, std::uint16_t>> entries)
+{
+	cp::PathSegment seg;
+	cp::SegmentInformation info;
+	info.set_timestamp(std::chrono::duration_cast<std::chrono::seconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count());
+	info.set_segment_id(segId);
+	seg.set_segment_info(info.SerializeAsString());
+
+	for (auto [ia, ingress, egress] : entries) {
+		cp::ASEntrySignedBody body;
+		body.set_isd_as(ia);
+		body.set_mtu(1472);
+		auto *hf = body.mutable_hop_entry()->mutable_hop_field();
+		hf->set_ingress(ingress);
+		hf->set_egress(egress);
+		hf->set_exp_time(63);
+		hf->set_mac(std::string(6, '\x42'));
+		(*body.mutable_extensions()->mutable_static_info()->mutable_latency()->mutable_inter())[egress] = 1000;
+
+		proto::crypto::v1::HeaderAndBodyInternal signedPart;
+		signedPart.set_body(body.SerializeAsString());
+		seg.add_as_entries()->mutable_signed_()->set_header_and_body(signedPart.SerializeAsString());
+	}
+	return seg;
+}
+
+static void testControlServiceSource()
+{
+	std::mutex mutex;
+	std::set<std::pair<std::uint64_t, std::uint64_t>> lookups;
+	FakeGrpcServer cs({
+		{ "/proto.control_plane.v1.SegmentLookupService/Segments",
+			[&](const std::string &raw) {
+				cp::SegmentsRequest request;
+				request.ParseFromString(raw);
+				{
+					std::lock_guard lock(mutex);
+					lookups.emplace(request.src_isd_as(), request.dst_isd_as());
+				}
+
+				cp::SegmentsResponse response;
+				auto &segs = *response.mutable_segments();
+				auto key = std::pair(request.src_isd_as(), request.dst_isd_as());
+				if (key == std::pair(A, ISD1))
+					*segs[cp::SEGMENT_TYPE_UP].add_segments() = encodeSegment(1, { { C1, 0, 1 }, { A, 41, 0 } });
+				else if (key == std::pair(ISD2, D))
+					*segs[cp::SEGMENT_TYPE_DOWN].add_segments() = encodeSegment(2, { { C2, 0, 2 }, { D, 11, 0 } });
+				else if (key == std::pair(C1, C2))
+					*segs[cp::SEGMENT_TYPE_CORE].add_segments() = encodeSegment(3, { { C2, 0, 5 }, { C1, 6, 0 } });
+				return response.SerializeAsString();
+			} },
+	});
+
+	TempFile topology("topology.json", R"({
+		"isd_as": "1-ff00:0:111",
+		"mtu": 1472,
+		"attributes": [],
+		"border_routers": {
+			"br1-ff00_0_111-1": {
+				"internal_addr": "[fd00::11]:31002",
+				"interfaces": {
+					"41": { "underlay": { "local": "10.0.0.1:50000" }, "isd_as": "1-ff00:0:110", "link_to": "parent", "mtu": 1472 }
+				}
+			}
+		},
+		"control_service": {
+			"cs1-ff00_0_111-1": { "addr": ")" + cs.address() + R"(" }
+		}
+	})");
+
+	ControlServicePathSource source(topology.path);
+	CHECK(source.connect());
+	auto paths = source.query(D);
+	CHECK(paths && paths->size() == 1);
+	if (!paths || paths->empty())
+		return;
+
+	const auto &path = (*paths)[0];
+	CHECK(path.src == A && path.dst == D);
+	CHECK(path.interfaces.size() == 6 && path.interfaces.front().ifid == 41 && path.interfaces.back().ifid == 11);
+	CHECK(path.nextHopPort == 31002 && path.nextHop[0] == 0xfd && path.nextHop[15] == 0x11);
+	CHECK(path.mtu == 1472);
+	CHECK(path.latency.size() == 5 && path.latency[0] == 1000us && path.latency[1] == -1us);
+	auto decoded = decodePath(path.dp);
+	CHECK(decoded && decoded->hops.size() == 6);
+
+	std::set<std::pair<std::uint64_t, std::uint64_t>> expected = { { A, ISD1 }, { ISD2, D }, { C1, C2 } };
+	CHECK(lookups == expected);
+
+	// Destinations without segments
+	paths = source.query(0x0003'ff00'0000'0311);
+	CHECK(paths && paths->empty());
+}
+
+int main()
+{
+	testFileSource();
+	testDaemonSource();
+	testControlServiceSource();
+	return TEST_RESULT();
+}
@@ -0,0 +1,99 @@
+#include <atomic>
+#include <thread>
+
+#include "PathTable.hxx"
+
+#include "Check.hxx"
+
+static PathInfo pathWithMtu(std::uint16_t mtu)
+{
+	PathInfo path;
+	path.mtu = mtu;
+	return path;
+}
+
+static void testPublish()
+{
+	PathTable table;
+	auto a = toScionAddr(0x0001'ff00'0000'0001), b = toScionAddr(0x0001'ff00'0000'0002);
+
+	table.set(a, pathWithMtu(1400));
+	CHECK(!table.find(a));
+	CHECK(table.pending(a) && table.pending(a)->path.mtu == 1400);
+	table.publish();
+	CHECK(table.find(a) && table.find(a)->path.mtu == 1400);
+
+	// Snapshots taken earlier are not affected by later changes
+	auto before = table.snapshot();
+	table.set(a, pathWithMtu(1280));
+	table.set(b, pathWithMtu(1500));
+	table.publish();
+	CHECK(before->size() == 1 && before->find(a)->path.mtu == 1400 && !before->find(b));
+	CHECK(table.snapshot()->size() == 2 && table.find(a)->path.mtu == 1280);
+
+	table.erase(a);
+	table.erase(toScionAddr(0x0001'ff00'0000'0003));
+	table.publish();
+	CHECK(!table.find(a) && table.find(b) && !table.pending(a));
+
+	std::size_t visited = 0;
+	table.snapshot()->forEach([&](scion_addr addr, const PathTable::Entry &entry) {
+		CHECK(addr == b && entry.path.mtu == 1500);
+		++visited;
+	});
+	CHECK(visited == 1);
+}
+
+static void testUnchangedShardsShared()
+{
+	PathTable table;
+	for (std::uint64_t i = 0; i < 10'000; ++i)
+		table.set(toScionAddr(i), pathWithMtu(1400));
+	table.publish();
+	auto before = table.snapshot();
+
+	// Publishing without changes keeps the snapshot
+	table.publish();
+	CHECK(table.snapshot() == before);
+
+	// Only the shard of the changed destination is copied, entries are shared
+	table.set(toScionAddr(0), pathWithMtu(1280));
+	table.publish();
+	auto after = table.snapshot();
+	CHECK(after != before && after->size() == before->size());
+	CHECK(after->find(toScionAddr(1)) == before->find(toScionAddr(1)));
+	CHECK(after->find(toScionAddr(0))->path.mtu == 1280);
+}
+
+static void testConcurrentReaders()
+{
+	PathTable table;
+	auto addr = toScionAddr(0x0001'ff00'0000'0001);
+	std::atomic<bool> done = false, consistent = true;
+
+	// Readers always see a complete entry of some published version
+	std::thread reader([&] {
+		while (!done) {
+			auto entry = table.find(addr);
+			if (entry && entry->path.mtu != entry->path.interfaces.size())
+				consistent = false;
+		}
+	});
+	for (std::uint16_t i = 0; i < 2000; ++i) {
+		auto path = pathWithMtu(i % 16);
+		path.interfaces.resize(i % 16);
+		table.set(addr, path);
+		table.publish();
+	}
+	done = true;
+	reader.join();
+	CHECK(consistent);
+}
+
+int main()
+{
+	testPublish();
+	testUnchangedShardsShared();
+	testConcurrentReaders();
+	return TEST_RESULT();
+}
@@ -0,0 +1,113 @@
+#include <cstdint>
+#include <vector>
+
+#include "bpf/police.h"
+
+#include "Policer.hxx"
+
+#include "Check.hxx"
+
+static constexpr std::uint64_t MS = 1000 * 1000;
+static constexpr std::uint64_t SECOND = 1000 * MS;
+
+static void testRemainder()
+{
+	// Less than a byte of credit per packet, the fractions must add up
+	struct police_share share = { .rate = 1000, .burst = 1500 };
+	struct police_bucket bucket = {};
+	std::uint64_t start = 10 * SECOND, passed = 0;
+	for (std::uint64_t now = start; now < start + 10 * SECOND; now += 700 * 1000) {
+		if (police_take(&bucket, &share, now, 100) == 0)
+			passed += 100;
+	}
+	// A new bucket starts with a second worth of tokens, plus 10 s of the rate
+	CHECK(passed >= 1000 + 10 * 1000 - 200);
+	CHECK(passed <= 1000 + 10 * 1000);
+	CHECK(bucket.offered - bucket.dropped == passed);
+}
+
+static void testShares()
+{
+	RateLimit limit = { .rate = 12'500'000, .burst = 1'000'000 };
+	auto shares = Policer::shares(limit, { 1000, 0, 0, 3000 });
+	std::uint64_t sum = 0;
+	for (const auto &share : shares)
+		sum += share.rate;
+	CHECK(sum <= limit.rate && sum + shares.size() >= limit.rate);
+	CHECK(shares[1].rate == Policer::MAX_RESERVE && shares[2].rate == Policer::MAX_RESERVE);
+	CHECK(shares[3].rate > 2 * shares[0].rate);
+	CHECK(shares[1].burst == Policer::MIN_BURST);
+
+	// Small rates are not eaten up by the reserves
+	shares = Policer::shares({ .rate = 10'000, .burst = 1500 }, { 1, 0, 0, 0, 0, 0, 0, 0 });
+	CHECK(shares[0].rate >= 10'000 - 10'000 / Policer::RESERVE_DIVISOR);
+	CHECK(shares[1].burst == 1500);
+}
+
+/// Simulate the per-CPU buckets of a destination with reconciliation rounds
+///
+/// cpuOf: CPU a packet sent at the given time is processed on
+/// Returns the bytes that passed within `duration`.
+template <typename CpuOf>
+static std::uint64_t simulate(RateLimit limit, unsigned ncpus, std::uint64_t offeredRate, std::uint64_t duration,
+	CpuOf &&cpuOf)
+{
+	static constexpr std::uint32_t PACKET = 1500;
+	std::vector<struct police_share> shares(ncpus);
+	for (auto &share : shares) {
+		share.rate = limit.rate / ncpus;
+		share.burst = std::max(limit.burst / ncpus, std::min(limit.burst, Policer::MIN_BURST));
+	}
+	std::vector<struct police_bucket> buckets(ncpus);
+	std::vector<std::uint64_t> offered(ncpus), demand(ncpus);
+
+	std::uint64_t start = 10 * SECOND, interval = SECOND * PACKET / offeredRate, passed = 0;
+	std::uint64_t nextRound = start + 100 * MS;
+	for (std::uint64_t now = start; now < start + duration; now += interval) {
+		if (now >= nextRound) {
+			std::uint64_t total = 0;
+			for (unsigned cpu = 0; cpu < ncpus; ++cpu) {
+				demand[cpu] = buckets[cpu].offered - offered[cpu];
+				offered[cpu] = buckets[cpu].offered;
+				total += demand[cpu];
+			}
+			if (total)
+				shares = Policer::shares(limit, demand);
+			nextRound += 100 * MS;
+		}
+		auto cpu = cpuOf(now - start);
+		if (police_take(&buckets[cpu], &shares[cpu], now, PACKET) == 0)
+			passed += PACKET;
+	}
+	return passed;
+}
+
+static void testAggregateRate()
+{
+	// 100 Mbit/s, offered twice as fast for 10 s
+	RateLimit limit = { .rate = 12'500'000, .burst = 1'000'000 };
+	auto expected = limit.rate * 10;
+
+	// A single flow stays on one CPU
+	auto passed = simulate(limit, 8, 2 * limit.rate, 10 * SECOND, [](std::uint64_t) { return 3u; });
+	CHECK(passed >= expected * 98 / 100);
+	CHECK(passed <= expected + limit.burst);
+
+	// The flow moves to another CPU every second, it runs on the reserve until the next round
+	passed = simulate(limit, 8, 2 * limit.rate, 10 * SECOND, [](std::uint64_t t) { return unsigned(t / SECOND) % 8; });
+	CHECK(passed >= expected * 85 / 100);
+	CHECK(passed <= expected + limit.burst + 8 * Policer::MIN_BURST);
+
+	// Flows on all CPUs together
+	passed = simulate(limit, 8, 2 * limit.rate, 10 * SECOND, [](std::uint64_t t) { return unsigned(t / 1000) % 8; });
+	CHECK(passed >= expected * 98 / 100);
+	CHECK(passed <= expected + limit.burst + 8 * Policer::MIN_BURST);
+}
+
+int main()
+{
+	testRemainder();
+	testShares();
+	testAggregateRate();
+	return TEST_RESULT();
+}
@@ -0,0 +1,208 @@
+/// Differential fuzz test of bpf/scion_mapping.h against the Python scion2ip
+///
+/// Random SCION addresses are mapped to IPv6 by scion_mapping_prefix() and by
+/// scion2ip, and mapped back by scion_mapping_ia()/scion_mapping_subnet() and
+/// ip2scion. Any difference is reported with the seed to reproduce it.
+///
+/// Usage: test_scion_mapping_fuzz python3 path/to/scion2ip-directory [seed]
+
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "bpf/scion_mapping.h"
+
+#include "Address.hxx"
+
+#include "Check.hxx"
+
+// Must come after the UAPI headers included by the BPF headers above,
+// otherwise glibc's definition of in6_addr takes precedence.
+#include <arpa/inet.h>
+
+// Addresses per subnet length
+static constexpr std::size_t SAMPLES = 500;
+
+struct Sample {
+	std::uint64_t ia;
+	std::uint32_t localPrefix;
+	std::uint32_t subnet;
+	std::uint64_t iface;
+};
+
+/// Hexadecimal number in colon-separated 16 bit groups, the format of scion2ip
+static std::string formatHex(std::uint64_t n)
+{
+	std::string groups;
+	for (int shift = 48; shift >= 0; shift -= 16) {
+		if ((n >> shift) == 0 && shift > 0)
+			continue;
+		char group[8];
+		std::snprintf(group, sizeof(group), groups.empty() ? "%x" : ":%x", unsigned((n >> shift) & 0xffff));
+		groups += group;
+	}
+	return groups;
+}
+
+static std::optional<std::uint64_t> parseHex(const std::string &raw)
+{
+	std::uint64_t n = 0;
+	std::istringstream groups(raw);
+	for (std::string group; std::getline(groups, group, ':');) {
+		std::uint64_t value;
+		auto [ptr, ec] = std::from_chars(group.data(), group.data() + group.size(), value, 16);
+		if (ec != std::errc() || ptr != group.data() + group.size() || value > 0xffff)
+			return std::nullopt;
+		n = (n << 16) | value;
+	}
+	return n;
+}
+
+/// Run a scion2ip tool with `input` on stdin, returns its output lines
+static std::vector<std::string> run(const std::string &command, const std::string &input)
+{
+	auto file = std::filesystem::temp_directory_path() / ("scion2ip-input." + std::to_string(getpid()));
+	std::ofstream(file) << input;
+
+	std::vector<std::string> lines;
+	auto pipe = popen((command + " < " + file.string()).c_str(), "r");
+	if (pipe) {
+		char line[256];
+		while (std::fgets(line, sizeof(line), pipe)) {
+			std::string str(line);
+			if (!str.empty() && str.back() == '\n')
+				str.pop_back();
+			lines.push_back(str);
+		}
+		pclose(pipe);
+	}
+	std::filesystem::remove(file);
+	return lines;
+}
+
+/// Random ISD-AS, mostly ones with a SCION-mapped address
+static std::uint64_t randomIa(std::mt19937_64 &rng)
+{
+	std::uint64_t isd = rng() % 0x1000;
+	switch (rng() % 4) {
+	case 0:
+		return (isd << 48) | (rng() % SCION_MAPPING_ENCODED_FLAG);
+	case 1:
+		return (isd << 48) | (SCION_MAPPING_SCION_ASN_BASE + rng() % SCION_MAPPING_ENCODED_FLAG);
+	case 2:
+		// Boundaries of the encodable ranges
+		return (isd << 48) | (rng() % 2 ? SCION_MAPPING_ENCODED_FLAG - 1 : SCION_MAPPING_SCION_ASN_BASE);
+	default:
+		return (isd << 48) | (rng() & 0xffff'ffff'ffff);
+	}
+}
+
+static void checkSubnetBits(const std::string &tools, unsigned bits, std::mt19937_64 &rng)
+{
+	std::vector<Sample> samples;
+	std::string input;
+	while (samples.size() < SAMPLES) {
+		Sample s = {
+			.ia = randomIa(rng),
+			.localPrefix = static_cast<std::uint32_t>(rng() & ((1u << (24 - bits)) - 1)),
+			.subnet = static_cast<std::uint32_t>(bits ? rng() & ((1u << bits) - 1) : 0),
+			.iface = rng(),
+		};
+		// Unrepresentable addresses make scion2ip stop, they are checked separately
+		if (!scion_mapping_representable(s.ia))
+			continue;
+		samples.push_back(s);
+		input += formatIsdAsn(s.ia) + " " + formatHex(s.localPrefix) + " " + formatHex(s.subnet) + " "
+			+ formatHex(s.iface) + "\n";
+	}
+
+	auto mapped = run(tools + "/scion2ip -p -s " + std::to_string(bits), input);
+	CHECK(mapped.size() == samples.size());
+	if (mapped.size() != samples.size())
+		return;
+
+	std::string ips;
+	for (std::size_t i = 0; i < samples.size(); ++i) {
+		const auto &s = samples[i];
+		auto hi = scion_mapping_prefix(s.ia, s.localPrefix, s.subnet, bits);
+		std::array<std::uint8_t, 16> expected, actual;
+		for (int b = 0; b < 8; ++b) {
+			expected[b] = hi >> (56 - 8 * b);
+			expected[8 + b] = s.iface >> (56 - 8 * b);
+		}
+		if (inet_pton(AF_INET6, mapped[i].c_str(), actual.data()) != 1 || actual != expected) {
+			std::cerr << "Mapping of " << formatIsdAsn(s.ia) << " " << formatHex(s.localPrefix) << " "
+				  << formatHex(s.subnet) << " with " << bits << " subnet bits differs, scion2ip: "
+				  << mapped[i] << "\n";
+			++checkFailures;
+		}
+		ips += mapped[i] + "\n";
+	}
+
+	// Mapped back by ip2scion as "ISD-AS local-prefix subnet interface"
+	auto back = run(tools + "/ip2scion -p -s " + std::to_string(bits), ips);
+	CHECK(back.size() == samples.size());
+	if (back.size() != samples.size())
+		return;
+	for (std::size_t i = 0; i < samples.size(); ++i) {
+		std::istringstream fields(back[i]);
+		std::string ia, localPrefix, subnet;
+		fields >> ia >> localPrefix >> subnet;
+
+		std::uint64_t hi = 0;
+		std::array<std::uint8_t, 16> addr;
+		inet_pton(AF_INET6, mapped[i].c_str(), addr.data());
+		for (int b = 0; b < 8; ++b)
+			hi = (hi << 8) | addr[b];
+		if (parseIsdAsn(ia) != scion_mapping_ia(hi) || parseHex(subnet) != scion_mapping_subnet(hi, bits)) {
+			std::cerr << "Decoding of " << mapped[i] << " with " << bits << " subnet bits differs, ip2scion: "
+				  << back[i] << "\n";
+			++checkFailures;
+		}
+	}
+}
+
+static void checkUnrepresentable(const std::string &tools, std::mt19937_64 &rng)
+{
+	// scion2ip rejects ASNs it cannot encode, one process per address as it stops at the first error
+	for (int i = 0; i < 10; ++i) {
+		std::uint64_t ia;
+		do
+			ia = randomIa(rng);
+		while (scion_mapping_representable(ia));
+		auto out = run(tools + "/scion2ip -p -s 8 2>/dev/null", formatIsdAsn(ia) + " 0 0 1\n");
+		if (!out.empty()) {
+			std::cerr << formatIsdAsn(ia) << " is not representable but scion2ip mapped it to " << out[0] << "\n";
+			++checkFailures;
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 3) {
+		std::cerr << "usage: " << argv[0] << " python3 scion2ip-directory [seed]\n";
+		return 2;
+	}
+	std::string tools = std::string(argv[1]) + " " + argv[2];
+	auto seed = argc > 3 ? std::stoull(argv[3]) : std::random_device()();
+	std::mt19937_64 rng(seed);
+
+	for (unsigned bits : { 0u, 8u, 13u, 24u })
+		checkSubnetBits(tools, bits, rng);
+	checkUnrepresentable(tools, rng);
+
+	if (checkFailures)
+		std::cerr << "Reproduce with seed " << seed << "\n";
+	return TEST_RESULT();
+}
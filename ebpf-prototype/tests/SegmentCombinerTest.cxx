@@ -0,0 +1,186 @@
+#include <cstdint>
+#include <vector>
+
+#include "DataplanePath.hxx"
+#include "SegmentCombiner.hxx"
+
+#include "Check.hxx"
+
+using namespace std::chrono_literals;
+
+// Local AS A below core AS C1, destination D below core AS C2 of another ISD,
+// destination E below C1.
+static constexpr std::uint64_t A = 0x0001'ff00'0000'0111;
+static constexpr std::uint64_t C1 = 0x0001'ff00'0000'0110;
+static constexpr std::uint64_t E = 0x0001'ff00'0000'0112;
+static constexpr std::uint64_t C2 = 0x0002'ff00'0000'0210;
+static constexpr std::uint64_t D = 0x0002'ff00'0000'0211;
+
+static constexpr std::uint32_t TIMESTAMP = 1'700'000'000;
+
+static PathSegment::ASEntry entry(std::uint64_t ia, std::uint16_t ingress, std::uint16_t egress,
+	std::uint8_t mac = 0)
+{
+	return {
+		.ia = ia,
+		.mtu = 1500,
+		.ingressMtu = 1472,
+		.hop = { ingress, egress, 63, { mac, std::uint8_t(mac + 1), 0, 0, 0, 0 } },
+		.intraLatency = {},
+		.interLatency = {},
+		.intraBandwidth = {},
+		.interBandwidth = {},
+	};
+}
+
+static PathSegment segment(PathSegment::Type type, std::uint16_t segId, std::vector<PathSegment::ASEntry> entries,
+	std::uint32_t timestamp = TIMESTAMP)
+{
+	return { type, timestamp, segId, std::move(entries) };
+}
+
+static std::vector<PathInfo::Interface> ifaces(std::initializer_list<std::pair<std::uint64_t, std::uint64_t>> list)
+{
+	std::vector<PathInfo::Interface> result;
+	for (auto [ia, ifid] : list)
+		result.push_back({ ia, ifid });
+	return result;
+}
+
+static bool operator==(const PathInfo::Interface &a, const PathInfo::Interface &b)
+{
+	return a.ia == b.ia && a.ifid == b.ifid;
+}
+
+static PathSegment up()
+{
+	auto c1 = entry(C1, 0, 1, 0xa0);
+	c1.interLatency[1] = 5000us;
+	c1.intraLatency[6] = 200us;
+	c1.interBandwidth[1] = 1'000'000;
+	return segment(PathSegment::Type::Up, 0x1234, { c1, entry(A, 41, 0, 0xa2) });
+}
+
+static PathSegment core()
+{
+	auto c2 = entry(C2, 0, 5, 0xb0);
+	c2.interLatency[5] = 30000us;
+	c2.mtu = 1400;
+	return segment(PathSegment::Type::Core, 0x5678, { c2, entry(C1, 6, 0, 0xb2) });
+}
+
+static PathSegment down()
+{
+	auto c2 = entry(C2, 0, 2, 0xc0);
+	c2.intraLatency[5] = 100us;
+	c2.interLatency[2] = 7000us;
+	return segment(PathSegment::Type::Down, 0x9abc, { c2, entry(D, 11, 0, 0xc2) });
+}
+
+static void testUpCoreDown()
+{
+	auto paths = combineSegments(A, D, { up(), core(), down() });
+	CHECK(paths.size() == 1);
+	if (paths.empty())
+		return;
+	const auto &path = paths[0];
+	CHECK(path.src == A && path.dst == D);
+	CHECK(path.interfaces == ifaces({ { A, 41 }, { C1, 1 }, { C1, 6 }, { C2, 5 }, { C2, 2 }, { D, 11 } }));
+	CHECK(path.mtu == 1400);
+
+	// Up and core segments are traversed against construction direction
+	auto decoded = decodePath(path.dp);
+	CHECK(decoded);
+	if (!decoded)
+		return;
+	CHECK((decoded->segLen == std::array<std::uint8_t, 3>{ 2, 2, 2 }));
+	CHECK(!decoded->infos[0].consDir && !decoded->infos[1].consDir && decoded->infos[2].consDir);
+	CHECK(decoded->hops[0].consIngress == 41 && decoded->hops[1].consEgress == 1);
+	CHECK(decoded->hops[2].consIngress == 6 && decoded->hops[3].consEgress == 5);
+	CHECK(decoded->hops[4].consEgress == 2 && decoded->hops[5].consIngress == 11);
+	CHECK(path.expiry == std::chrono::system_clock::time_point(std::chrono::seconds(TIMESTAMP + 24 * 3600 / 4)));
+
+	// The SegID of reversed segments includes the MACs of all but the last traversed hop
+	CHECK(decoded->infos[0].segId == (0x1234 ^ 0xa0a1));
+	CHECK(decoded->infos[1].segId == (0x5678 ^ 0xb0b1));
+	CHECK(decoded->infos[2].segId == 0x9abc);
+
+	// The crossover latency at C2 is taken from the down segment, C1 -> C2 link from the core segment
+	std::vector<std::chrono::microseconds> latency = { 5000us, 200us, 30000us, 100us, 7000us };
+	CHECK(path.latency == latency);
+	std::vector<std::uint64_t> bandwidth = { 1'000'000, 0, 0, 0, 0 };
+	CHECK(path.bandwidth == bandwidth);
+}
+
+static void testUpDown()
+{
+	auto toE = segment(PathSegment::Type::Down, 0x4242, { entry(C1, 0, 2), entry(E, 51, 0) });
+	auto paths = combineSegments(A, E, { up(), core(), toE });
+	CHECK(paths.size() == 1);
+	if (paths.empty())
+		return;
+	CHECK(paths[0].interfaces == ifaces({ { A, 41 }, { C1, 1 }, { C1, 2 }, { E, 51 } }));
+	CHECK(paths[0].latency == std::vector<std::chrono::microseconds>({ 5000us, -1us, -1us }));
+	auto decoded = decodePath(paths[0].dp);
+	CHECK(decoded && (decoded->segLen == std::array<std::uint8_t, 3>{ 2, 2, 0 }));
+}
+
+static void testCore()
+{
+	// From a core AS only the core and down segments are needed
+	auto paths = combineSegments(C1, D, { core(), down() });
+	CHECK(paths.size() == 1);
+	if (!paths.empty())
+		CHECK(paths[0].interfaces == ifaces({ { C1, 6 }, { C2, 5 }, { C2, 2 }, { D, 11 } }));
+
+	paths = combineSegments(C1, C2, { core() });
+	CHECK(paths.size() == 1);
+	if (!paths.empty())
+		CHECK(paths[0].interfaces == ifaces({ { C1, 6 }, { C2, 5 } }));
+}
+
+static void testInvalid()
+{
+	// Segments that do not connect
+	CHECK(combineSegments(A, D, { up(), down() }).empty());
+	CHECK(combineSegments(E, D, { up(), core(), down() }).empty());
+
+	// Paths through an AS twice
+	auto loop = segment(PathSegment::Type::Down, 1, { entry(C2, 0, 3), entry(A, 7, 8), entry(D, 12, 0) });
+	CHECK(combineSegments(A, D, { up(), core(), loop }).empty());
+
+	// Segments too long for the path header
+	std::vector<PathSegment::ASEntry> entries = { entry(C2, 0, 1) };
+	for (std::uint16_t i = 0; i < 63; ++i)
+		entries.push_back(entry(0x0002'ff00'0000'1000 + i, 1, 2));
+	entries.push_back(entry(D, 1, 0));
+	CHECK(combineSegments(A, D, { up(), core(), segment(PathSegment::Type::Down, 1, entries) }).empty());
+}
+
+static void testDuplicates()
+{
+	// The same up segment from an older beacon expires earlier
+	auto old = up();
+	old.timestamp -= 3600;
+	auto paths = combineSegments(A, D, { old, up(), core(), down() });
+	CHECK(paths.size() == 1);
+	if (!paths.empty())
+		CHECK(decodePath(paths[0].dp)->infos[0].timestamp == TIMESTAMP);
+
+	// Shorter paths come first
+	auto direct = segment(PathSegment::Type::Down, 2, { entry(C1, 0, 2), entry(D, 13, 0) });
+	paths = combineSegments(A, D, { up(), core(), down(), direct });
+	CHECK(paths.size() == 2);
+	if (paths.size() == 2)
+		CHECK(paths[0].interfaces.size() < paths[1].interfaces.size());
+}
+
+int main()
+{
+	testUpCoreDown();
+	testUpDown();
+	testCore();
+	testInvalid();
+	testDuplicates();
+	return TEST_RESULT();
+}
@@ -0,0 +1,96 @@
+// Copyright (c) 2024 Lars-Christian Schulz
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Request rate of the synchronous and the pipelined asynchronous mode of
+// Dataplane. Sends a cheap read-only request (the FIB table of local0) to a
+// VPP API socket. Any VPP instance serves as endpoint, the translator plugin
+// is not required, e.g.
+//   vpp "unix { nodaemon cli-listen /tmp/cli.sock } socksvr { socket-name /tmp/api.sock }
+//        plugins { plugin default { disable } }"
+//   dataplane-bench /tmp/api.sock 100000
+
+#include "dataplane.hpp"
+
+#include <vapi/interface.api.vapi.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+using Clock = std::chrono::steady_clock;
+
+static void fill(vapi_payload_sw_interface_get_table& mp)
+{
+    mp.sw_if_index = 0;
+    mp.is_ipv6 = false;
+}
+
+static double syncRate(Dataplane& dp, unsigned long count)
+{
+    auto start = Clock::now();
+    for (unsigned long i = 0; i < count; ++i) {
+        vapi::Sw_interface_get_table req(dp.getCon());
+        fill(req.get_request().get_payload());
+        dp.execAndWait(req);
+    }
+    return count / std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static double asyncRate(Dataplane& dp, unsigned long count, unsigned long& failed)
+{
+    asio::io_context ioCtx;
+    dp.enableAsync(ioCtx);
+    unsigned long done = 0;
+    auto start = Clock::now();
+    for (unsigned long i = 0; i < count; ++i) {
+        dp.asyncExec<vapi::Sw_interface_get_table>(fill,
+            [&](std::error_code ec, vapi::Sw_interface_get_table& req) {
+                if (ec || req.get_response().get_payload().retval != 0) ++failed;
+                if (++done == count) ioCtx.stop();
+            });
+    }
+    ioCtx.run();
+    auto rate = count / std::chrono::duration<double>(Clock::now() - start).count();
+    dp.disableAsync();
+    return rate;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* socket = argc > 1 ? argv[1] : Dataplane::DEFAULT_API_SOCKET;
+    unsigned long count = argc > 2 ? std::stoul(argv[2]) : 100000;
+
+    try {
+        Dataplane dp(socket);
+        std::printf("%10s %14s\n", "mode", "requests/s");
+        std::printf("%10s %14.0f\n", "sync", syncRate(dp, count));
+        unsigned long failed = 0;
+        std::printf("%10s %14.0f\n", "async", asyncRate(dp, count, failed));
+        if (failed) {
+            std::fprintf(stderr, "%lu asynchronous requests failed\n", failed);
+            return 1;
+        }
+    }
+    catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2024 Lars-Christian Schulz
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Path query rate of the SCION daemon depending on the number of connections
+// queried in parallel, the [sciond_connection] connections setting of the path
+// manager. Queries the given destinations round-robin, like a refresh of all
+// destinations.
+//   sciond-bench 127.0.0.1:30255 10000 1-64513 1-64514
+
+#include <scion/addr/isd_asn.hpp>
+#include <snet/snet.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+int main(int argc, char* argv[])
+{
+    if (argc < 4) {
+        std::fprintf(stderr, "usage: %s sciond-address queries destination...\n", argv[0]);
+        return 2;
+    }
+    const char* sciond = argv[1];
+    unsigned long queries = std::stoul(argv[2]);
+    std::vector<scion::IsdAsn> dsts;
+    for (int i = 3; i < argc; ++i) {
+        auto ia = scion::IsdAsn::Parse(argv[i]);
+        if (std::holds_alternative<std::error_code>(ia)) {
+            std::fprintf(stderr, "invalid destination %s\n", argv[i]);
+            return 2;
+        }
+        dsts.push_back(std::get<scion::IsdAsn>(ia));
+    }
+
+    std::printf("%12s %14s %10s\n", "connections", "queries/s", "failed");
+    for (unsigned int connections : {1u, 2u, 4u, 8u, 16u, 32u}) {
+        std::vector<scion::HostCtx> ctxs(connections);
+        for (auto& ctx : ctxs) {
+            if (ctx.init(sciond, 1s) != scion::Status::Success) {
+                std::fprintf(stderr, "cannot connect to %s\n", sciond);
+                return 1;
+            }
+        }
+
+        std::atomic<unsigned long> next = 0, failed = 0;
+        auto start = Clock::now();
+        std::vector<std::thread> threads;
+        for (auto& ctx : ctxs) {
+            threads.emplace_back([&]() {
+                for (auto i = next++; i < queries; i = next++) {
+                    auto dst = dsts[i % dsts.size()];
+                    auto [paths, status] = ctx.queryPaths(scion::IA{static_cast<std::uint64_t>(dst)}, 0, 100ms);
+                    if (status != scion::Status::Success || paths.empty()) ++failed;
+                }
+            });
+        }
+        for (auto& thread : threads) thread.join();
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        std::printf("%12u %14.0f %10lu\n", connections, queries / seconds, failed.load());
+    }
+    return 0;
+}
@@ -21,28 +21,53 @@ bpf_trace_printk(_fmt, sizeof(_fmt), ##__VA_ARGS__); \
 #define printf(...)
 #endif
 
+// Receive queues with a socket and counters, XDP_MAX_QUEUES in src/ebpf.hpp
 #define DEFAULT_QUEUE_IDS 64
+#define MAX_SCION_ADDRS 64
+#define PORT_BITMAP_WORDS (65536 / 64)
 #define VLAN_MAX_DEPTH 4
 #define IPV6_MAX_ESTENSIONS 6
-#define MIN_SCION_HDR_SIZE (8 + 12 + 48)
-#define MIN_PACKET_SIZE (sizeof(struct ethhdr) + sizeof(struct iphdr) + sizeof(struct udphdr) + MIN_SCION_HDR_SIZE)
+// Smallest packet that can match, an IPv4 ICMP message without payload
+#define MIN_PACKET_SIZE (sizeof(struct ethhdr) + sizeof(struct iphdr) + 8)
+// Address header with 4 byte host addresses
+#define SCION_MIN_ADDR_HDR_SIZE (16 + 4 + 4)
+
+// Fragment fields of the IPv4 header and the IPv6 fragment header, host byte order
+#define IP_FRAG_MF 0x2000
+#define IP_FRAG_OFFSET 0x1fff
+#define IP6_FRAG_MF 0x0001
+#define IP6_FRAG_OFFSET 0xfff8
 
 #define proto_is_vlan(proto) (proto == bpf_htons(ETH_P_8021Q) || proto == bpf_htons(ETH_P_8021AD))
 
-struct filter_config
+// Local addresses of the translator, the values are unused
+struct
 {
-    __u32 ipv4;
-    struct in6_addr ipv6;
-};
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(key_size, sizeof(__u32));
+    __uint(value_size, sizeof(__u8));
+    __uint(max_entries, MAX_SCION_ADDRS);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} scion_ip4 SEC(".maps");
 
+struct
+{
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(key_size, sizeof(struct in6_addr));
+    __uint(value_size, sizeof(__u8));
+    __uint(max_entries, MAX_SCION_ADDRS);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} scion_ip6 SEC(".maps");
+
+// SCION underlay ports as a bitmap, bit (port % 64) of word (port / 64)
 struct
 {
     __uint(type, BPF_MAP_TYPE_ARRAY);
     __uint(key_size, sizeof(__u32));
-    __uint(value_size, sizeof(struct filter_config));
-    __uint(max_entries, 1);
+    __uint(value_size, sizeof(__u64));
+    __uint(max_entries, PORT_BITMAP_WORDS);
     __uint(pinning, LIBBPF_PIN_BY_NAME);
-} scion_ip SEC(".maps");
+} scion_ports SEC(".maps");
 
 struct
 {
@@ -52,20 +77,106 @@ struct
     __uint(max_entries, DEFAULT_QUEUE_IDS);
 } xsks_map SEC(".maps");
 
+// Decisions counted in xdp_stats, keep in sync with src/ebpf.hpp
+enum xdp_decision
+{
+    XDP_STAT_REDIRECTED, // handed to VPP
+    XDP_STAT_NO_SOCKET,  // SCION, but no AF_XDP socket bound to the queue
+    XDP_STAT_NOT_SCION,  // passed to the kernel
+    XDP_STAT_MALFORMED,  // headers could not be parsed
+    XDP_STAT_INVALID,    // to a SCION port, but not a valid SCION packet (dropped)
+    XDP_STAT_DECISIONS,
+};
+
+// Packet counters indexed by rx_queue_index * XDP_STAT_DECISIONS + decision
+struct
+{
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(key_size, sizeof(__u32));
+    __uint(value_size, sizeof(__u64));
+    __uint(max_entries, DEFAULT_QUEUE_IDS * XDP_STAT_DECISIONS);
+    __uint(pinning, LIBBPF_PIN_BY_NAME);
+} xdp_stats SEC(".maps");
+
+// SCION common header
+struct scion_hdr
+{
+    __u8 version_qos;
+    __u8 qos_flow;
+    __be16 flow;
+    __u8 next_hdr;
+    __u8 hdr_len; // in multiples of 4 bytes
+    __be16 payload_len;
+    __u8 path_type;
+    __u8 addr_type; // DT, DL, ST, SL, 2 bits each
+    __be16 rsv;
+};
+
 struct vlan_hdr
 {
     __be16 tci;
     __be16 proto;
 };
 
+struct ipv6_frag_hdr
+{
+    __u8 nexthdr;
+    __u8 reserved;
+    __be16 frag_off;
+    __be32 identification;
+};
+
 __attribute__((__always_inline__))
-inline bool comp_ipv6(struct in6_addr* a, struct in6_addr* b)
+inline int count(struct xdp_md* ctx, enum xdp_decision decision, int action)
 {
-    #pragma unroll
-    for (int i = 0; i < 4; ++i) {
-        if (a->in6_u.u6_addr32[i] != b->in6_u.u6_addr32[i]) {
-            return false;
-        }
+    __u32 key = ctx->rx_queue_index * XDP_STAT_DECISIONS + decision;
+    __u64* counter = bpf_map_lookup_elem(&xdp_stats, &key);
+    if (counter) ++*counter;
+    return action;
+}
+
+__attribute__((__always_inline__))
+inline bool match_port(void* data, void* data_end)
+{
+    struct udphdr* udp = data;
+    if ((void*)(udp + 1) > data_end) return false;
+
+    __u16 port = bpf_ntohs(udp->dest);
+    __u32 word = port / 64;
+    __u64* bits = bpf_map_lookup_elem(&scion_ports, &word);
+    return bits && (*bits & (1ull << (port % 64)));
+}
+
+// Check that the UDP payload starting at data is a plausible SCION packet. The
+// caller must have checked that the UDP header is in bounds.
+__attribute__((__always_inline__))
+inline bool valid_scion(void* data, void* data_end)
+{
+    struct udphdr* udp = data;
+    struct scion_hdr* scion = (void*)(udp + 1);
+    if ((void*)(scion + 1) > data_end) return false;
+
+    if ((scion->version_qos >> 4) != 0) {
+        printf("unknown SCION version\n");
+        return false;
+    }
+
+    __u32 hdr_len = 4 * scion->hdr_len;
+    __u32 dl = (scion->addr_type >> 4) & 0x3, sl = scion->addr_type & 0x3;
+    __u32 addr_len = 16 + 4 * (dl + 1) + 4 * (sl + 1);
+    if (hdr_len < sizeof(struct scion_hdr) + addr_len) {
+        printf("SCION header too short\n");
+        return false;
+    }
+
+    __u32 udp_len = bpf_ntohs(udp->len);
+    if (udp_len != sizeof(struct udphdr) + hdr_len + bpf_ntohs(scion->payload_len)) {
+        printf("SCION length does not match UDP length\n");
+        return false;
+    }
+    if (data + udp_len > data_end) {
+        printf("packet truncated\n");
+        return false;
     }
     return true;
 }
@@ -97,6 +208,7 @@ inline bool parse_ipv4(void** data, void* data_end, struct iphdr** hdr)
     struct iphdr* ip = *data;
 
     __u32 hdrsize = 4 * ip->ihl;
+    if (hdrsize < sizeof(struct iphdr)) return false;
     if (*data + hdrsize > data_end) return false;
     *data += hdrsize;
 
@@ -105,7 +217,7 @@ inline bool parse_ipv4(void** data, void* data_end, struct iphdr** hdr)
 }
 
 __attribute__((__always_inline__))
-inline bool parse_ipv6(void** data, void* data_end, struct ipv6hdr** hdr, __u8* next)
+inline bool parse_ipv6(void** data, void* data_end, struct ipv6hdr** hdr, __u8* next, __u16* frag)
 {
     if (*data + sizeof(struct ipv6hdr) > data_end) return false;
     struct ipv6hdr* ip = *data;
@@ -130,9 +242,14 @@ inline bool parse_ipv6(void** data, void* data_end, struct ipv6hdr** hdr, __u8*
             *data = *data + (opt->hdrlen + 1) * 4;
             break;
         case IPPROTO_FRAGMENT:
-            nh = opt->nexthdr;
-            *data = *data + 8;
+        {
+            struct ipv6_frag_hdr* fh = *data;
+            if ((void*)(fh + 1) > data_end) return false;
+            nh = fh->nexthdr;
+            *frag = bpf_ntohs(fh->frag_off);
+            *data = fh + 1;
             break;
+        }
         default:
             *hdr = ip;
             *next = nh;
@@ -151,51 +268,75 @@ int scion_filter(struct xdp_md* ctx)
 
     if ((unsigned long)(data_end - data) < MIN_PACKET_SIZE) {
         printf("packet too small\n");
-        return XDP_PASS;
+        return count(ctx, XDP_STAT_NOT_SCION, XDP_PASS);
     }
 
-    __u32 key = 0;
-    struct filter_config* filter = bpf_map_lookup_elem(&scion_ip, &key);
-    if (!filter) return XDP_PASS;
-
     __be16 proto = parse_ethernet(&data, data_end);
     printf("proto = %x\n", (int)proto);
     if (proto == bpf_ntohs(ETH_P_IP)) {
         printf("packet is IPv4\n");
         struct iphdr* ip = NULL;
-        if (!parse_ipv4(&data, data_end, &ip)) return XDP_PASS;
+        if (!parse_ipv4(&data, data_end, &ip)) return count(ctx, XDP_STAT_MALFORMED, XDP_PASS);
 
-        if (ip->daddr != filter->ipv4) {
+        if (!bpf_map_lookup_elem(&scion_ip4, &ip->daddr)) {
             printf("destination address does not match\n");
-            return XDP_PASS;
+            return count(ctx, XDP_STAT_NOT_SCION, XDP_PASS);
         }
 
-        if (ip->protocol != IPPROTO_ICMP && ip->protocol != IPPROTO_UDP) {
+        if (ip->protocol == IPPROTO_UDP) {
+            __u16 frag = bpf_ntohs(ip->frag_off);
+            // Later fragments carry no UDP header, VPP reassembles them
+            if (!(frag & IP_FRAG_OFFSET)) {
+                if (!match_port(data, data_end)) {
+                    printf("destination port does not match\n");
+                    return count(ctx, XDP_STAT_NOT_SCION, XDP_PASS);
+                }
+                // The lengths of a first fragment only add up after reassembly
+                if (!(frag & IP_FRAG_MF) && !valid_scion(data, data_end))
+                    return count(ctx, XDP_STAT_INVALID, XDP_DROP);
+            }
+        } else if (ip->protocol != IPPROTO_ICMP) {
             printf("l4 type dpes not match (%d)\n", ip->protocol);
-            return XDP_PASS;
+            return count(ctx, XDP_STAT_NOT_SCION, XDP_PASS);
         }
 
     } else if (proto == bpf_ntohs(ETH_P_IPV6)) {
         printf("packet is IPv6\n");
         struct ipv6hdr* ip = NULL;
         __u8 next_hdr = 0;
-        if (!parse_ipv6(&data, data_end, &ip, &next_hdr)) return XDP_PASS;
+        __u16 frag = 0;
+        if (!parse_ipv6(&data, data_end, &ip, &next_hdr, &frag))
+            return count(ctx, XDP_STAT_MALFORMED, XDP_PASS);
 
-        if (!comp_ipv6(&ip->daddr, &filter->ipv6)) {
+        if (!bpf_map_lookup_elem(&scion_ip6, &ip->daddr)) {
             printf("destination address does not match\n");
-            return XDP_PASS;
+            return count(ctx, XDP_STAT_NOT_SCION, XDP_PASS);
         }
 
-        if (next_hdr != IPPROTO_ICMP && next_hdr != IPPROTO_UDP) {
+        if (next_hdr == IPPROTO_UDP) {
+            // Same as for IPv4, fragments are left to VPP's reassembly
+            if (!(frag & IP6_FRAG_OFFSET)) {
+                if (!match_port(data, data_end)) {
+                    printf("destination port does not match\n");
+                    return count(ctx, XDP_STAT_NOT_SCION, XDP_PASS);
+                }
+                if (!(frag & IP6_FRAG_MF) && !valid_scion(data, data_end))
+                    return count(ctx, XDP_STAT_INVALID, XDP_DROP);
+            }
+        } else if (next_hdr != IPPROTO_ICMPV6) {
             printf("l4 type dpes not match (%d)\n", next_hdr);
-            return XDP_PASS;
+            return count(ctx, XDP_STAT_NOT_SCION, XDP_PASS);
         }
 
     } else {
         printf("not IP\n");
-        return XDP_PASS;
+        return count(ctx, XDP_STAT_NOT_SCION, XDP_PASS);
     }
 
     printf("redirecting (queue %d)\n", ctx->rx_queue_index);
-    return bpf_redirect_map(&xsks_map, ctx->rx_queue_index, XDP_PASS);
+    // Falls back to XDP_PASS if no socket is bound to the queue
+    int action = bpf_redirect_map(&xsks_map, ctx->rx_queue_index, XDP_PASS);
+    if (action == XDP_REDIRECT)
+        return count(ctx, XDP_STAT_REDIRECTED, action);
+    return count(ctx, XDP_STAT_NO_SOCKET, action);
 }
@@ -24,12 +24,29 @@
 #include <toml++/toml.hpp>
 
 #include <algorithm>
+#include <charconv>
 #include <istream>
 #include <system_error>
 #include <string_view>
 
 static const char* DEFAULT_SCIOND = "127.0.0.1:30255";
 static const char* DEFAULT_TAP_NAME = "scion";
+static const std::int64_t DEFAULT_REFRESH_MARGIN = 300;
+static const unsigned int DEFAULT_SCIOND_CONNECTIONS = 8;
+static const unsigned int MAX_SCIOND_CONNECTIONS = 64;
+static const unsigned int DEFAULT_TAP_QUEUES = 8;
+static const unsigned int DEFAULT_TAP_RING_SIZE = 256;
+static const unsigned int MAX_TAP_QUEUES = 255;
+static const unsigned int MAX_TAP_RING_SIZE = 32768;
+static const std::int64_t DEFAULT_STATS_INTERVAL = 10;
+
+static unsigned int parseRingSize(const toml::node_view<toml::node>& node, const char* name)
+{
+    unsigned int size = node.value_or(DEFAULT_TAP_RING_SIZE);
+    if (size == 0 || size > MAX_TAP_RING_SIZE || (size & (size - 1)) != 0)
+        throw ConfigError(std::string(name) + " must be a power of two up to 32768");
+    return size;
+}
 
 static asio::ip::udp::endpoint parseEndpoint(std::string_view raw)
 {
@@ -51,6 +68,27 @@ static asio::ip::udp::endpoint parseEndpoint(std::string_view raw)
     return asio::ip::udp::endpoint(asio::ip::make_address(addr), portNum);
 }
 
+// Parse a port ("30041") or an inclusive port range ("31000-31010")
+static std::pair<std::uint16_t, std::uint16_t> parsePortRange(std::string_view raw)
+{
+    auto parsePort = [](std::string_view port) {
+        std::uint16_t portNum = 0;
+        auto res = std::from_chars(port.begin(), port.end(), portNum, 10);
+        if (port.empty() || res.ec != std::errc() || res.ptr != port.end())
+            throw ConfigError("invalid port");
+        return portNum;
+    };
+    auto dash = raw.find('-');
+    if (dash == raw.npos) {
+        auto port = parsePort(raw);
+        return {port, port};
+    }
+    auto first = parsePort(raw.substr(0, dash)), last = parsePort(raw.substr(dash + 1));
+    if (first > last)
+        throw ConfigError("invalid port range");
+    return {first, last};
+}
+
 void loadConfig(const std::filesystem::path& configFile, TranslatorConfig& config)
 {
     using namespace asio;
@@ -99,10 +137,48 @@ void loadConfig(const std::filesystem::path& configFile, TranslatorConfig& confi
 
     // Section: sciond_connection
     config.sciondEp = parseEndpoint(
-        tab["sciond"]["address"].value_or<std::string_view>(DEFAULT_SCIOND));
+        tab["sciond_connection"]["address"].value_or<std::string_view>(DEFAULT_SCIOND));
+    config.sciondConnections = tab["sciond_connection"]["connections"].value_or(DEFAULT_SCIOND_CONNECTIONS);
+    if (config.sciondConnections == 0 || config.sciondConnections > MAX_SCIOND_CONNECTIONS)
+        throw ConfigError("sciond connections must be between 1 and 64");
+
+    // Section: paths
+    {
+        auto sec = tab["paths"];
+        config.destinations.clear();
+        if (auto dsts = sec["destinations"].as_array(); dsts) {
+            for (const auto& dst : *dsts) {
+                auto raw = dst.value<std::string_view>();
+                if (!raw.has_value())
+                    throw ConfigError("destinations must be strings");
+                auto ia = scion::IsdAsn::Parse(*raw);
+                if (std::holds_alternative<std::error_code>(ia))
+                    throw ConfigError("invalid destination ISD-ASN");
+                config.destinations.push_back(std::get<scion::IsdAsn>(ia));
+            }
+        }
+        config.refreshMargin = std::chrono::seconds(
+            sec["refresh_margin"].value_or(DEFAULT_REFRESH_MARGIN));
+        if (config.refreshMargin.count() < 0)
+            throw ConfigError("refresh_margin must not be negative");
+    }
 
     // Section: tap
-    config.tapName = tab["tap"]["name"].value_or<std::string_view>(DEFAULT_TAP_NAME);
+    {
+        auto sec = tab["tap"];
+        config.tapName = sec["name"].value_or<std::string_view>(DEFAULT_TAP_NAME);
+        config.tapRxQueues = sec["rx_queues"].value_or(DEFAULT_TAP_QUEUES);
+        config.tapTxQueues = sec["tx_queues"].value_or(DEFAULT_TAP_QUEUES);
+        if (config.tapRxQueues == 0 || config.tapRxQueues > MAX_TAP_QUEUES
+            || config.tapTxQueues == 0 || config.tapTxQueues > MAX_TAP_QUEUES) {
+            throw ConfigError("tap queue count must be between 1 and 255");
+        }
+        config.tapRxRingSize = parseRingSize(sec["rx_ring_size"], "rx_ring_size");
+        config.tapTxRingSize = parseRingSize(sec["tx_ring_size"], "tx_ring_size");
+        config.tapGso = sec["gso"].value_or(false);
+        config.tapCsumOffload = sec["checksum_offload"].value_or(false);
+        config.tapPackedRing = sec["packed_ring"].value_or(false);
+    }
 
     // Section: xdp
     {
@@ -112,14 +188,76 @@ void loadConfig(const std::filesystem::path& configFile, TranslatorConfig& confi
         } else {
             throw ConfigError("host interface not set");
         }
-        config.hostIfQueues = sec["rx_queues"].value_or(1);
+        if (!sec["rx_queues"] || sec["rx_queues"].value<std::string_view>() == "auto") {
+            config.hostIfQueues = 0;
+        } else if (auto v = sec["rx_queues"].value<unsigned int>(); v.has_value()) {
+            config.hostIfQueues = *v;
+        } else {
+            throw ConfigError("xdp rx_queues must be a number or \"auto\"");
+        }
+        config.hostIfRxQueueSize = sec["rx_queue_size"].value_or(0u);
+        config.hostIfTxQueueSize = sec["tx_queue_size"].value_or(0u);
+        if (config.hostIfQueues > 0xffff || config.hostIfRxQueueSize > 0xffff
+            || config.hostIfTxQueueSize > 0xffff) {
+            throw ConfigError("xdp queue parameters out of range");
+        }
+        auto mode = sec["mode"].value_or<std::string_view>("auto");
+        if (mode == "auto")
+            config.xdpZeroCopy = std::nullopt;
+        else if (mode == "copy")
+            config.xdpZeroCopy = false;
+        else if (mode == "zero-copy")
+            config.xdpZeroCopy = true;
+        else
+            throw ConfigError("xdp mode must be one of auto, copy, zero-copy");
+        // VPP does not opt its sockets into preferred busy polling, the
+        // interrupt deferral alone only added latency
+        if (sec["busy_poll"])
+            spdlog::warn("xdp.busy_poll is no longer supported and ignored");
+        config.xdpNoSyscallLock = sec["no_syscall_lock"].value_or(false);
+        config.xdpRss = sec["rss"].value_or(false);
+        config.xdpAddresses.clear();
+        if (auto addrs = sec["addresses"].as_array(); addrs) {
+            for (const auto& addr : *addrs) {
+                auto raw = addr.value<std::string_view>();
+                if (!raw.has_value())
+                    throw ConfigError("xdp addresses must be strings");
+                config.xdpAddresses.push_back(ip::make_address(*raw));
+            }
+        }
+        config.xdpPorts.clear();
+        if (auto ports = sec["ports"].as_array(); ports) {
+            for (const auto& port : *ports) {
+                if (auto num = port.value<std::int64_t>(); num.has_value()) {
+                    if (*num < 0 || *num > 0xffff)
+                        throw ConfigError("invalid port");
+                    config.xdpPorts.emplace_back(*num, *num);
+                } else if (auto raw = port.value<std::string_view>(); raw.has_value()) {
+                    config.xdpPorts.push_back(parsePortRange(*raw));
+                } else {
+                    throw ConfigError("xdp ports must be numbers or ranges");
+                }
+            }
+        }
+        config.xdpStatsInterval = std::chrono::seconds(
+            sec["stats_interval"].value_or(DEFAULT_STATS_INTERVAL));
+        if (config.xdpStatsInterval.count() < 0)
+            throw ConfigError("stats_interval must not be negative");
+        config.xdpStatsFile = sec["stats_file"].value_or<std::string_view>("");
     }
 }
 
 std::string dumpConfig(const TranslatorConfig& config)
 {
-    std::stringstream stream, ia;
+    std::stringstream stream, ia, sciond;
     ia << config.localIA;
+    sciond << config.sciondEp;
+    toml::array destinations;
+    for (auto dst : config.destinations) {
+        std::stringstream raw;
+        raw << dst;
+        destinations.push_back(raw.str());
+    }
     toml::table tab{
         {"log", toml::table{
             {"level", fmt::format("{}", spdlog::level::to_string_view(config.logLevel))},
@@ -130,14 +268,32 @@ std::string dumpConfig(const TranslatorConfig& config)
             {"host_addr", config.hostAddr.to_string()},
         }},
         {"sciond_connection", toml::table{
-            {"address", "config.sciondEp"},
+            {"address", sciond.str()},
+            {"connections", config.sciondConnections},
+        }},
+        {"paths", toml::table{
+            {"destinations", destinations},
+            {"refresh_margin", config.refreshMargin.count()},
         }},
         {"tap", toml::table{
             {"name", config.tapName},
+            {"rx_queues", config.tapRxQueues},
+            {"tx_queues", config.tapTxQueues},
+            {"rx_ring_size", config.tapRxRingSize},
+            {"tx_ring_size", config.tapTxRingSize},
+            {"gso", config.tapGso},
+            {"checksum_offload", config.tapCsumOffload},
+            {"packed_ring", config.tapPackedRing},
         }},
         {"xdp", toml::table{
             {"interface", config.hostInterface},
-            {"rx_queues", config.hostIfQueues},
+            {"rx_queue_size", config.hostIfRxQueueSize},
+            {"tx_queue_size", config.hostIfTxQueueSize},
+            {"mode", config.xdpZeroCopy ? (*config.xdpZeroCopy ? "zero-copy" : "copy") : "auto"},
+            {"no_syscall_lock", config.xdpNoSyscallLock},
+            {"rss", config.xdpRss},
+            {"stats_interval", config.xdpStatsInterval.count()},
+            {"stats_file", config.xdpStatsFile.string()},
         }},
     };
     if (config.gatewayAddr4 && config.hostAddr4) {
@@ -145,6 +301,23 @@ std::string dumpConfig(const TranslatorConfig& config)
         translator->insert_or_assign("gateway_addr4", config.gatewayAddr4->to_string());
         translator->insert_or_assign("host_addr4", config.hostAddr4->to_string());
     }
+    auto xdp = tab["xdp"].as_table();
+    toml::array addrs, ports;
+    for (const auto& addr : config.xdpAddresses) {
+        addrs.push_back(addr.to_string());
+    }
+    for (auto [first, last] : config.xdpPorts) {
+        if (first == last)
+            ports.push_back(first);
+        else
+            ports.push_back(fmt::format("{}-{}", first, last));
+    }
+    xdp->insert_or_assign("addresses", addrs);
+    xdp->insert_or_assign("ports", ports);
+    if (config.hostIfQueues == 0)
+        xdp->insert_or_assign("rx_queues", "auto");
+    else
+        xdp->insert_or_assign("rx_queues", config.hostIfQueues);
     stream << tab;
     return stream.str();
 }
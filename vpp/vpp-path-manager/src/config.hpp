@@ -24,9 +24,13 @@
 #include <spdlog/spdlog.h>
 #include <scion/addr/isd_asn.hpp>
 
+#include <chrono>
 #include <stdexcept>
 #include <filesystem>
+#include <optional>
 #include <string>
+#include <utility>
+#include <vector>
 
 
 class ConfigError : public std::runtime_error
@@ -47,11 +51,31 @@ struct TranslatorConfig
     std::optional<asio::ip::network_v4> hostAddr4;
     // sciond_connection
     asio::ip::udp::endpoint sciondEp;
+    unsigned int sciondConnections; // path queries in parallel
+    // paths
+    std::vector<scion::IsdAsn> destinations;
+    std::chrono::seconds refreshMargin;
     // tap
     std::string tapName;
+    unsigned int tapRxQueues;
+    unsigned int tapTxQueues;
+    unsigned int tapRxRingSize;
+    unsigned int tapTxRingSize;
+    bool tapGso;
+    bool tapCsumOffload;
+    bool tapPackedRing;
     // xdp
     std::string hostInterface;
-    unsigned int hostIfQueues;
+    unsigned int hostIfQueues; // 0 = all queues of the NIC
+    unsigned int hostIfRxQueueSize; // 0 = VPP default
+    unsigned int hostIfTxQueueSize;
+    std::optional<bool> xdpZeroCopy; // nullopt = let the driver decide
+    bool xdpNoSyscallLock;
+    bool xdpRss;
+    std::vector<asio::ip::address> xdpAddresses; // in addition to host_addr(4)
+    std::vector<std::pair<std::uint16_t, std::uint16_t>> xdpPorts; // empty = all
+    std::chrono::seconds xdpStatsInterval; // 0 = disabled
+    std::filesystem::path xdpStatsFile; // empty = no export
 };
 
 void loadConfig(const std::filesystem::path& configFile, TranslatorConfig& config);
@@ -97,9 +97,9 @@ std::string DataplaneError::formatMessage(int retval, const char* what)
     return stream.str();
 }
 
-Dataplane::Dataplane()
+Dataplane::Dataplane(const char* apiSocket)
 {
-    auto err = con.connect("path-manager", nullptr, 32, 32);
+    auto err = con.connect("path-manager", apiSocket, MAX_OUTSTANDING, 32, true, true);
     if (err != VAPI_OK) {
         throw VapiError(err, "connect");
     }
@@ -108,19 +108,93 @@ Dataplane::Dataplane()
 
 Dataplane::~Dataplane()
 {
+    disableAsync();
     auto err = con.disconnect();
     if (err != VAPI_OK) {
         spdlog::error("VAPI disconnect failed ({})", vapiErrorCategory.message(err));
     }
 }
 
+void Dataplane::enableAsync(asio::io_context& ioCtx)
+{
+    int fd = -1;
+    auto err = con.get_fd(&fd);
+    if (err != VAPI_OK)
+        throw VapiError(err, "get_fd");
+    events = std::make_unique<asio::posix::stream_descriptor>(ioCtx, fd);
+    wait();
+}
+
+void Dataplane::disableAsync()
+{
+    if (!events) return;
+    if (!inflight.empty() || !backlog.empty()) {
+        spdlog::warn("dropping {} pending VAPI requests", inflight.size() + backlog.size());
+    }
+    events->cancel();
+    // The descriptor belongs to the VAPI connection
+    events->release();
+    events.reset();
+    backlog.clear();
+    completed.clear();
+    inflight.clear();
+}
+
+void Dataplane::flush()
+{
+    while (!backlog.empty() && inflight.size() < static_cast<std::size_t>(MAX_OUTSTANDING)) {
+        // The send function may queue further requests, take it out first
+        auto send = std::move(backlog.front());
+        backlog.pop_front();
+        if (send() == VAPI_EAGAIN) {
+            backlog.push_front(std::move(send));
+            break;
+        }
+    }
+}
+
+void Dataplane::complete()
+{
+    // Handlers may issue new requests
+    auto handlers = std::move(completed);
+    completed.clear();
+    for (auto& handler : handlers) {
+        handler();
+    }
+}
+
+void Dataplane::wait()
+{
+    if (!events || waiting) return;
+    waiting = true;
+    events->async_wait(asio::posix::stream_descriptor::wait_read, [this](std::error_code ec) {
+        waiting = false;
+        if (ec) return;
+        // Read everything available without blocking, this also answers keepalives
+        auto err = con.dispatch(nullptr, 0);
+        if (err != VAPI_OK && err != VAPI_EAGAIN) {
+            spdlog::error("VAPI dispatch failed ({})", vapiErrorCategory.message(err));
+        }
+        complete();
+        flush();
+        wait();
+    });
+}
+
 std::uint32_t TapInterface::create(Dataplane& dp)
 {
     vapi::Tap_create_v3 tap(dp.getCon(), 0);
     auto& mp = tap.get_request().get_payload();
     mp.use_random_mac = true;
-    mp.num_rx_queues = 8;
-    mp.num_tx_queues = 8;
+    mp.num_rx_queues = static_cast<uint8_t>(rxQueues);
+    mp.num_tx_queues = static_cast<uint8_t>(txQueues);
+    mp.rx_ring_sz = rxRingSize;
+    mp.tx_ring_sz = txRingSize;
+    std::uint32_t flags = 0;
+    if (gso) flags |= TAP_API_FLAG_GSO;
+    if (csumOffload) flags |= TAP_API_FLAG_CSUM_OFFLOAD;
+    if (packedRing) flags |= TAP_API_FLAG_PACKED;
+    mp.tap_flags = static_cast<vapi_enum_tap_flags>(flags);
     mp.host_mtu_set = true;
     mp.host_mtu_size = DEFAULT_TUN_MTU;
     mp.host_ip6_prefix_set = true;
@@ -154,6 +228,14 @@ uint32_t XdpInterface::create(Dataplane& dp)
     std::memcpy(mp.host_if, hostIf.data(), std::min(hostIf.size(), sizeof(mp.host_if) - 1));
     std::memcpy(mp.name, name.data(), std::min(name.size(), sizeof(mp.name) - 1));
     mp.rxq_num = rxQueues;
+    mp.rxq_size = rxQueueSize;
+    mp.txq_size = txQueueSize;
+    if (zeroCopy.has_value())
+        mp.mode = *zeroCopy ? AF_XDP_API_MODE_ZERO_COPY : AF_XDP_API_MODE_COPY;
+    else
+        mp.mode = AF_XDP_API_MODE_AUTO;
+    if (noSyscallLock)
+        mp.flags = AF_XDP_API_FLAGS_NO_SYSCALL_LOCK;
     std::memcpy(mp.prog, program.data(), std::min(program.size(), sizeof(mp.prog) - 1));
     auto resp = dp.execAndWait(xdp);
     if (resp.retval != 0)
@@ -23,9 +23,15 @@
 #include <asio.hpp>
 #include <vapi/vapi.hpp>
 
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <stdexcept>
 #include <system_error>
 #include <optional>
+#include <unordered_map>
+#include <vector>
 
 namespace std {
 template<> struct is_error_code_enum<vapi_error_e> : true_type {};
@@ -55,11 +61,25 @@ private:
 
 class Dataplane
 {
+public:
+    // Maximum number of asynchronous requests in flight, further requests are
+    // queued until a response arrives.
+    static constexpr int MAX_OUTSTANDING = 32;
+    // VPP's binary API socket, the shared memory transport has no pollable descriptor
+    static constexpr const char* DEFAULT_API_SOCKET = "/run/vpp/api.sock";
+
 private:
     vapi::Connection con;
 
+    // State of the asynchronous mode, only valid while events is open
+    std::unique_ptr<asio::posix::stream_descriptor> events;
+    bool waiting = false;
+    std::unordered_map<const void*, std::shared_ptr<void>> inflight;
+    std::deque<std::function<vapi_error_e()>> backlog;
+    std::vector<std::function<void()>> completed;
+
 public:
-    Dataplane();
+    explicit Dataplane(const char* apiSocket = DEFAULT_API_SOCKET);
     ~Dataplane();
 
     vapi::Connection& getCon() { return con; }
@@ -81,6 +101,9 @@ public:
         } while (err == VAPI_EAGAIN);
         if (err != VAPI_OK)
             throw VapiError(err, "wait_for_response");
+        // Waiting dispatches the responses to asynchronous requests as well
+        if (events && !completed.empty())
+            asio::post(events->get_executor(), [this]() { complete(); });
         return req.get_response().get_payload();
     }
 
@@ -90,6 +113,52 @@ public:
         executeReq(req);
         return waitForResponse(req);
     }
+
+    // Receive responses from the I/O context instead of waiting for them.
+    // Required by asyncExec().
+    void enableAsync(asio::io_context& ioCtx);
+    void disableAsync();
+
+    // Send a request without waiting for the response. `fill` receives the
+    // request payload, `handler` the error code and the request once the
+    // response arrived. The response is only valid if there was no error.
+    // The handler is always called from the I/O context. `args` are passed
+    // on to the request constructor after the connection, e.g., the length
+    // of a variable length request.
+    template <typename Request, typename Fill, typename Handler, typename... Args>
+    void asyncExec(Fill fill, Handler handler, Args... args)
+    {
+        if (!events)
+            throw std::logic_error("asynchronous requests are not enabled");
+        backlog.push_back([this, fill, handler, args...]() -> vapi_error_e {
+            auto callback = [this, handler](Request& r) -> vapi_error_e {
+                std::error_code ec;
+                if (r.get_response_state() != vapi::RESPONSE_READY)
+                    ec = make_error_code(VAPI_ENORESP);
+                completed.emplace_back([owner = inflight.extract(&r).mapped(), &r, handler, ec]() {
+                    handler(ec, r);
+                });
+                return VAPI_OK;
+            };
+            auto req = std::make_shared<Request>(con, args..., callback);
+            fill(req->get_request().get_payload());
+            auto err = req->execute();
+            if (err == VAPI_OK) {
+                inflight.emplace(req.get(), req);
+            } else if (err != VAPI_EAGAIN) {
+                asio::post(events->get_executor(), [req, handler, err]() {
+                    handler(make_error_code(err), *req);
+                });
+            }
+            return err;
+        });
+        flush();
+    }
+
+private:
+    void flush();
+    void complete();
+    void wait();
 };
 
 class TapInterface
@@ -97,7 +166,9 @@ class TapInterface
 private:
     std::string name;
     asio::ip::network_v6 addr;
-    uint16_t rxQueues, txQueues;
+    uint16_t rxQueues = 8, txQueues = 8;
+    uint16_t rxRingSize = 256, txRingSize = 256;
+    bool gso = false, csumOffload = false, packedRing = false;
     std::optional<uint32_t> ifIndex = 0;
 
 public:
@@ -124,6 +195,26 @@ public:
         return *this;
     }
 
+    TapInterface& setRingSizes(uint16_t rx, uint16_t tx)
+    {
+        rxRingSize = rx;
+        txRingSize = tx;
+        return *this;
+    }
+
+    TapInterface& setOffloads(bool gso, bool csumOffload)
+    {
+        this->gso = gso;
+        this->csumOffload = csumOffload;
+        return *this;
+    }
+
+    TapInterface& setPackedRing(bool packed)
+    {
+        packedRing = packed;
+        return *this;
+    }
+
     bool isOpen() const { return ifIndex.has_value(); }
     std::uint32_t index() { return ifIndex.value(); }
 
@@ -137,7 +228,10 @@ private:
     std::string name;
     std::string hostIf;
     std::string program;
-    uint16_t rxQueues;
+    uint16_t rxQueues = 1;
+    uint16_t rxQueueSize = 0, txQueueSize = 0;
+    std::optional<bool> zeroCopy;
+    bool noSyscallLock = false;
     std::optional<uint32_t> ifIndex = 0;
 
 public:
@@ -157,9 +251,24 @@ public:
         return *this;
     }
 
-    XdpInterface& setQueueParams(uint16_t rxQueueCount)
+    XdpInterface& setQueueParams(uint16_t rxQueueCount, uint16_t rxSize = 0, uint16_t txSize = 0)
     {
         rxQueues = rxQueueCount;
+        rxQueueSize = rxSize;
+        txQueueSize = txSize;
+        return *this;
+    }
+
+    // Force zero-copy (true) or copy mode (false), the driver decides if unset
+    XdpInterface& setZeroCopy(std::optional<bool> zc)
+    {
+        zeroCopy = zc;
+        return *this;
+    }
+
+    XdpInterface& setNoSyscallLock(bool noLock)
+    {
+        noSyscallLock = noLock;
         return *this;
     }
 
@@ -22,9 +22,15 @@
 
 #include "ebpf.hpp"
 #include "bpf.h"
+#include "libbpf.h"
 
 #include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
 #include <utility>
+#include <vector>
 
 // File descriptor
 class FD
@@ -59,59 +65,201 @@ public:
     int release() { return std::exchange(fd, -1); }
 };
 
-static const char* SCION_IP_MAP = "/sys/fs/bpf/scion_ip";
-static FD scionIpMap;
+// Maps pinned by the XDP program in bpf/af_xdp.c
+static const char* SCION_IP4_MAP = "/sys/fs/bpf/scion_ip4";
+static const char* SCION_IP6_MAP = "/sys/fs/bpf/scion_ip6";
+static const char* SCION_PORTS_MAP = "/sys/fs/bpf/scion_ports";
+static const char* XDP_STATS_MAP = "/sys/fs/bpf/xdp_stats";
+static constexpr uint32_t PORT_BITMAP_WORDS = 65536 / 64;
 
-static bool updateScionIpMap(const TranslatorConfig& config)
+static FD scionIp4Map, scionIp6Map, scionPortsMap, xdpStatsMap;
+
+static const char* XDP_DECISION_NAMES[] = {
+    "redirected", "no_socket", "not_scion", "malformed", "invalid_scion",
+};
+
+static bool checkMap(const FD& map, uint32_t keySize, uint32_t valueSize)
 {
-    if (!scionIpMap) return false;
     bpf_map_info info = {};
     unsigned int infoLen = sizeof(info);
-    if (bpf_map_get_info_by_fd(*scionIpMap, &info, &infoLen) != 0) {
+    if (bpf_map_get_info_by_fd(*map, &info, &infoLen) != 0) {
         return false;
     }
+    return info.key_size == keySize && info.value_size == valueSize;
+}
+
+// Remove the keys of a hash map that are not in `keep`
+template <std::size_t KeySize>
+static void pruneMap(const FD& map, const std::vector<std::array<uint8_t, KeySize>>& keep)
+{
+    std::vector<std::array<uint8_t, KeySize>> stale;
+    std::array<uint8_t, KeySize> key;
+    const void* prev = nullptr;
+    while (bpf_map_get_next_key(*map, prev, key.data()) == 0) {
+        if (std::find(keep.begin(), keep.end(), key) == keep.end())
+            stale.push_back(key);
+        prev = key.data();
+    }
+    for (const auto& k : stale) {
+        bpf_map_delete_elem(*map, k.data());
+    }
+}
 
-    uint32_t key = 0;
-    std::array<uint8_t, 20> value = {};
-    if (info.max_entries != 1 || info.key_size != sizeof(key) || info.value_size != sizeof(value)) {
+static bool updateScionIpMap(const TranslatorConfig& config)
+{
+    if (!scionIp4Map || !scionIp6Map || !scionPortsMap) return false;
+    if (!checkMap(scionIp4Map, 4, 1) || !checkMap(scionIp6Map, 16, 1)
+        || !checkMap(scionPortsMap, sizeof(uint32_t), sizeof(uint64_t))) {
+        spdlog::error("unexpected eBPF map layout");
         return false;
     }
 
-    auto ipv4 = config.hostAddr4->address().to_bytes();
-    auto i = std::copy(ipv4.begin(), ipv4.end(), value.begin());
-    auto ipv6 = config.hostAddr.address().to_bytes();
-    std::copy(ipv6.begin(), ipv6.end(), i);
+    std::vector<asio::ip::address> addrs = config.xdpAddresses;
+    addrs.push_back(config.hostAddr.address());
+    if (config.hostAddr4) addrs.push_back(config.hostAddr4->address());
 
-    if (bpf_map_update_elem(*scionIpMap, &key, value.data(), 0) != 0) {
-        return false;
+    uint8_t present = 1;
+    std::vector<std::array<uint8_t, 4>> keys4;
+    std::vector<std::array<uint8_t, 16>> keys6;
+    for (const auto& addr : addrs) {
+        int err = 0;
+        if (addr.is_v4()) {
+            auto key = addr.to_v4().to_bytes();
+            err = bpf_map_update_elem(*scionIp4Map, key.data(), &present, 0);
+            keys4.push_back(key);
+        } else {
+            auto key = addr.to_v6().to_bytes();
+            err = bpf_map_update_elem(*scionIp6Map, key.data(), &present, 0);
+            keys6.push_back(key);
+        }
+        if (err != 0) {
+            spdlog::error("cannot add {} to eBPF filter", addr.to_string());
+            return false;
+        }
+    }
+    // Addresses from a previous configuration
+    pruneMap(scionIp4Map, keys4);
+    pruneMap(scionIp6Map, keys6);
+
+    std::array<uint64_t, PORT_BITMAP_WORDS> ports = {};
+    if (config.xdpPorts.empty()) {
+        ports.fill(~uint64_t(0));
+    }
+    for (auto [first, last] : config.xdpPorts) {
+        for (uint32_t port = first; port <= last; ++port) {
+            ports[port / 64] |= uint64_t(1) << (port % 64);
+        }
+    }
+    for (uint32_t word = 0; word < PORT_BITMAP_WORDS; ++word) {
+        if (bpf_map_update_elem(*scionPortsMap, &word, &ports[word], 0) != 0) {
+            spdlog::error("cannot update eBPF port filter");
+            return false;
+        }
     }
     return true;
 }
 
 bool initScionIpMap(const TranslatorConfig& config)
 {
-    scionIpMap = bpf_obj_get(SCION_IP_MAP);
-    if (!scionIpMap) {
-        spdlog::error("cannot open pinned map {}", SCION_IP_MAP);
-        return false;
-    } else {
-        if (!updateScionIpMap(config)) {
-            spdlog::error("updating eBPF maps failed");
+    std::pair<FD*, const char*> maps[] = {
+        {&scionIp4Map, SCION_IP4_MAP},
+        {&scionIp6Map, SCION_IP6_MAP},
+        {&scionPortsMap, SCION_PORTS_MAP},
+        {&xdpStatsMap, XDP_STATS_MAP},
+    };
+    for (auto [map, path] : maps) {
+        *map = bpf_obj_get(path);
+        if (!*map) {
+            spdlog::error("cannot open pinned map {}", path);
             return false;
         }
     }
+    if (!updateScionIpMap(config)) {
+        spdlog::error("updating eBPF maps failed");
+        return false;
+    }
+    return true;
+}
+
+bool reloadScionIpMap(const TranslatorConfig& config)
+{
+    if (!scionIp4Map) return false;
+    if (!updateScionIpMap(config)) {
+        spdlog::error("updating eBPF maps failed");
+        return false;
+    }
     return true;
 }
 
 void unpinScionIpMap()
 {
-    if (scionIpMap) {
-        spdlog::info("unpinning map {}", SCION_IP_MAP);
+    std::pair<FD*, const char*> maps[] = {
+        {&scionIp4Map, SCION_IP4_MAP},
+        {&scionIp6Map, SCION_IP6_MAP},
+        {&scionPortsMap, SCION_PORTS_MAP},
+        {&xdpStatsMap, XDP_STATS_MAP},
+    };
+    for (auto [map, path] : maps) {
+        if (!*map) continue;
+        spdlog::info("unpinning map {}", path);
         try {
-            std::filesystem::remove(SCION_IP_MAP);
+            std::filesystem::remove(path);
         } catch (const std::system_error& e) {
             spdlog::error("cannot unpin map ({})", e.what());
         }
-        scionIpMap.release();
+        *map = FD();
+    }
+}
+
+std::vector<XdpQueueStats> readXdpStats()
+{
+    constexpr auto decisions = static_cast<uint32_t>(XdpDecision::Count_);
+    if (!xdpStatsMap) return {};
+    int ncpus = libbpf_num_possible_cpus();
+    if (ncpus <= 0) return {};
+
+    std::vector<XdpQueueStats> stats(XDP_MAX_QUEUES);
+    std::vector<uint64_t> values(ncpus);
+    for (uint32_t key = 0; key < XDP_MAX_QUEUES * decisions; ++key) {
+        if (bpf_map_lookup_elem(*xdpStatsMap, &key, values.data()) != 0) {
+            return {};
+        }
+        for (auto value : values) {
+            stats[key / decisions][key % decisions] += value;
+        }
     }
+
+    // Drop the queues that never saw a packet from the end
+    while (!stats.empty() && stats.back() == XdpQueueStats{}) {
+        stats.pop_back();
+    }
+    return stats;
+}
+
+bool writeXdpStats(const std::vector<XdpQueueStats>& stats, const std::filesystem::path& file)
+{
+    auto tmp = file;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        out << "# HELP scion_xdp_packets_total Packets seen by the SCION XDP filter.\n";
+        out << "# TYPE scion_xdp_packets_total counter\n";
+        for (std::size_t queue = 0; queue < stats.size(); ++queue) {
+            for (std::size_t decision = 0; decision < stats[queue].size(); ++decision) {
+                out << "scion_xdp_packets_total{queue=\"" << queue << "\",decision=\""
+                    << XDP_DECISION_NAMES[decision] << "\"} " << stats[queue][decision] << '\n';
+            }
+        }
+        if (!out.flush()) {
+            spdlog::error("cannot write {}", tmp.string());
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, file, ec);
+    if (ec) {
+        spdlog::error("cannot replace {} ({})", file.string(), ec.message());
+        return false;
+    }
+    return true;
 }
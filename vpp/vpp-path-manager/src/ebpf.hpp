@@ -20,7 +20,39 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
 struct TranslatorConfig;
 
+// Receive queues the XDP filter has socket and counter slots for, DEFAULT_QUEUE_IDS in bpf/af_xdp.c
+constexpr unsigned int XDP_MAX_QUEUES = 64;
+
+// Decisions of the XDP filter, same order as enum xdp_decision in bpf/af_xdp.c
+enum class XdpDecision
+{
+    Redirected,
+    NoSocket,
+    NotScion,
+    Malformed,
+    Invalid,
+    Count_,
+};
+
+// Packet counters of one receive queue, indexed by XdpDecision
+using XdpQueueStats = std::array<std::uint64_t, static_cast<std::size_t>(XdpDecision::Count_)>;
+
 bool initScionIpMap(const TranslatorConfig& config);
+// Apply a changed configuration to the maps opened by initScionIpMap()
+bool reloadScionIpMap(const TranslatorConfig& config);
 void unpinScionIpMap();
+
+// Read the packet counters of the XDP filter summed over all CPUs, one entry
+// per receive queue. Empty if the counters are not available.
+std::vector<XdpQueueStats> readXdpStats();
+
+// Write the counters in the Prometheus text format to `file`, replacing it
+// atomically so that node_exporter's textfile collector never sees half of it.
+bool writeXdpStats(const std::vector<XdpQueueStats>& stats, const std::filesystem::path& file);
@@ -22,17 +22,27 @@
 #include "dataplane.hpp"
 #include "netlink.hpp"
 #include "ebpf.hpp"
+#include "path_manager.hpp"
+#include "rss.hpp"
 
 #include <CLI/CLI.hpp>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <chrono>
+#include <csignal>
 #include <filesystem>
+#include <functional>
 #include <memory>
+#include <optional>
 
 std::unique_ptr<Dataplane> dp;
 TapInterface tap;
 XdpInterface xdp;
 
+// Time VPP has to acknowledge the removal of the paths on shutdown
+constexpr auto SHUTDOWN_TIMEOUT = std::chrono::seconds(5);
+
 static struct Arguments
 {
     std::filesystem::path config = "/etc/vpp/scion.toml";
@@ -53,7 +63,79 @@ void parseCommandLine(int argc, char* argv[])
     }
 }
 
-void initDataplane(const TranslatorConfig& config)
+// Number of receive queues of a NIC, 0 if unknown
+unsigned int detectRxQueues(const std::string& iface)
+{
+    try {
+        auto channels = NetLinkEthtool().getChannels(iface.c_str());
+        spdlog::debug("{} has {} combined, {} rx, {} tx channels", iface,
+            channels.combined, channels.rx, channels.tx);
+        return channels.rxQueues();
+    }
+    catch (const std::exception& e) {
+        spdlog::warn("cannot query channels of {} ({})", iface, e.what());
+        return 0;
+    }
+}
+
+void createTap(const TranslatorConfig& config)
+{
+    spdlog::info("creating tap interface");
+    tap.setName(config.tapName).setAddress(config.hostAddr)
+        .setNumQueues(config.tapRxQueues, config.tapTxQueues)
+        .setRingSizes(config.tapRxRingSize, config.tapTxRingSize)
+        .setOffloads(config.tapGso, config.tapCsumOffload)
+        .setPackedRing(config.tapPackedRing)
+        .create(*dp);
+    if (setVppInterfaceUp(*dp, tap.index())) {
+        spdlog::error("error bringing tap interface up");
+    }
+}
+
+// RSS settings of the host interface before tuneHostInterface() changed them
+static std::optional<RssSnapshot> savedRss;
+
+// Undo tuneHostInterface(). Returns false if the original settings could not be
+// written back, they are tried again on the next call.
+bool restoreHostInterface()
+{
+    if (!savedRss) return true;
+    try {
+        restoreRss(*savedRss);
+    }
+    catch (const std::exception& e) {
+        spdlog::warn("cannot restore the RSS settings of {} ({})", savedRss->iface, e.what());
+        return false;
+    }
+    savedRss.reset();
+    return true;
+}
+
+// Settings of the host interface that are applied without recreating the xdp
+// interface. Disabled settings are reverted to what they were before. Returns
+// false if the settings could not be applied.
+bool tuneHostInterface(const TranslatorConfig& config, unsigned int rxQueues)
+{
+    if (!config.xdpRss) return restoreHostInterface();
+    try {
+        if (!savedRss) savedRss = saveRss(config.hostInterface);
+        setUdpRssHash(config.hostInterface);
+        setRssQueues(config.hostInterface, rxQueues);
+    }
+    catch (const std::exception& e) {
+        spdlog::warn("cannot configure RSS on {} ({})", config.hostInterface, e.what());
+        return false;
+    }
+    return true;
+}
+
+// Number of host interface queues the xdp interface was created with
+static unsigned int xdpRxQueues = 0;
+
+// Packets per statistics interval below which the queue spread is not checked
+static constexpr std::uint64_t RSS_CHECK_MIN_PACKETS = 10000;
+
+void createXdp(const TranslatorConfig& config)
 {
     namespace fs = std::filesystem;
     bool customBpf = false;
@@ -69,14 +151,25 @@ void initDataplane(const TranslatorConfig& config)
         customBpf = true;
     }
 
-    spdlog::info("creating tap interface");
-    tap.setName(config.tapName).setAddress(config.hostAddr).create(*dp);
-    if (setVppInterfaceUp(*dp, tap.index())) {
-        spdlog::error("error bringing tap interface up");
-    }
-
     spdlog::info("attaching to host interface");
-    xdp.setName("xdp").setHostIf(config.hostInterface).setQueueParams(config.hostIfQueues);
+    xdpRxQueues = config.hostIfQueues;
+    if (xdpRxQueues == 0) {
+        xdpRxQueues = detectRxQueues(config.hostInterface);
+        if (xdpRxQueues == 0) xdpRxQueues = 1;
+        spdlog::info("using {} queues of {}", xdpRxQueues, config.hostInterface);
+    }
+    // Packets on further queues would find no socket in the filter's maps
+    if (customBpf && xdpRxQueues > XDP_MAX_QUEUES) {
+        spdlog::warn("the XDP filter supports at most {} queues, attaching to the first {} of {}",
+            XDP_MAX_QUEUES, XDP_MAX_QUEUES, config.hostInterface);
+        xdpRxQueues = XDP_MAX_QUEUES;
+    }
+    tuneHostInterface(config, xdpRxQueues);
+    xdp.setName("xdp").setHostIf(config.hostInterface)
+        .setQueueParams(static_cast<uint16_t>(xdpRxQueues),
+            config.hostIfRxQueueSize, config.hostIfTxQueueSize)
+        .setZeroCopy(config.xdpZeroCopy)
+        .setNoSyscallLock(config.xdpNoSyscallLock);
     xdp.create(*dp);
     if (setVppInterfaceUp(*dp, xdp.index())) {
         spdlog::error("error bringing xdp interface up");
@@ -87,6 +180,12 @@ void initDataplane(const TranslatorConfig& config)
     }
 }
 
+void initDataplane(const TranslatorConfig& config)
+{
+    createTap(config);
+    createXdp(config);
+}
+
 void cleanDataplane()
 {
     spdlog::info("detachhing from host interface");
@@ -94,13 +193,20 @@ void cleanDataplane()
     spdlog::info("deleting tap interface");
     tap.destroy(*dp);
     unpinScionIpMap();
+    restoreHostInterface();
 }
 
 void configureRoutes(const TranslatorConfig& config)
 {
     NetLinkRoute nl;
 
-    nl.addRoute(asio::ip::make_network_v6("fc00::/8"), config.tapName.c_str());
+    try {
+        nl.addRoute(asio::ip::make_network_v6("fc00::/8"), config.tapName.c_str());
+    }
+    catch (const std::system_error& e) {
+        // Still in place when reloading with the same tap interface
+        if (e.code() != std::errc::file_exists) throw;
+    }
 
     try {
         nl.delRoute(config.hostAddr, config.hostInterface.c_str());
@@ -114,9 +220,62 @@ void configureRoutes(const TranslatorConfig& config)
     }
 }
 
-bool init()
+// Periodically read the counters of the XDP filter, log the queues that saw
+// SCION traffic without an AF_XDP socket and export all counters if configured.
+// With RSS enabled, also warn if a single queue received almost all SCION
+// traffic. RSS cannot help then, e.g. because there is only one border router.
+void reportXdpStats(asio::steady_timer& timer, const TranslatorConfig& config,
+    std::vector<XdpQueueStats>& last)
+{
+    timer.expires_after(config.xdpStatsInterval);
+    timer.async_wait([&](std::error_code ec) {
+        if (ec) return;
+        auto stats = readXdpStats();
+        std::uint64_t redirected = 0, busiest = 0;
+        std::size_t busiestQueue = 0;
+        for (std::size_t queue = 0; queue < stats.size(); ++queue) {
+            XdpQueueStats delta = stats[queue];
+            // The counters start over if the xdp interface was recreated
+            if (queue < last.size()) {
+                for (std::size_t i = 0; i < delta.size(); ++i) {
+                    if (delta[i] >= last[queue][i]) delta[i] -= last[queue][i];
+                }
+            }
+            auto noSocket = delta[static_cast<std::size_t>(XdpDecision::NoSocket)];
+            if (noSocket > 0) {
+                spdlog::warn("queue {}: {} SCION packets without AF_XDP socket", queue, noSocket);
+            }
+            spdlog::debug("queue {}: redirected {}, no socket {}, not SCION {}, malformed {}, "
+                "invalid SCION {}", queue, delta[0], delta[1], delta[2], delta[3], delta[4]);
+            auto queueRedirected = delta[static_cast<std::size_t>(XdpDecision::Redirected)];
+            redirected += queueRedirected;
+            if (queueRedirected > busiest) {
+                busiest = queueRedirected;
+                busiestQueue = queue;
+            }
+        }
+        // Warn once until the traffic spreads again
+        static bool unspread = false;
+        if (config.xdpRss && xdpRxQueues > 1 && redirected >= RSS_CHECK_MIN_PACKETS
+            && busiest > redirected / 10 * 9) {
+            if (!unspread) {
+                spdlog::warn("queue {} received {} of {} SCION packets, RSS does not spread "
+                    "the traffic", busiestQueue, busiest, redirected);
+            }
+            unspread = true;
+        } else if (redirected >= RSS_CHECK_MIN_PACKETS) {
+            unspread = false;
+        }
+        if (!config.xdpStatsFile.empty()) {
+            writeXdpStats(stats, config.xdpStatsFile);
+        }
+        last = std::move(stats);
+        reportXdpStats(timer, config, last);
+    });
+}
+
+bool init(TranslatorConfig& config)
 {
-    TranslatorConfig config;
     try {
         loadConfig(args.config, config);
     }
@@ -148,6 +307,153 @@ bool init()
     return true;
 }
 
+// Settings the tap interface is created with
+static void keepTapConfig(TranslatorConfig& next, const TranslatorConfig& config)
+{
+    next.tapName = config.tapName;
+    next.hostAddr = config.hostAddr;
+    next.tapRxQueues = config.tapRxQueues;
+    next.tapTxQueues = config.tapTxQueues;
+    next.tapRxRingSize = config.tapRxRingSize;
+    next.tapTxRingSize = config.tapTxRingSize;
+    next.tapGso = config.tapGso;
+    next.tapCsumOffload = config.tapCsumOffload;
+    next.tapPackedRing = config.tapPackedRing;
+}
+
+// Settings the xdp interface and the filter's maps are created with
+static void keepXdpConfig(TranslatorConfig& next, const TranslatorConfig& config)
+{
+    next.hostInterface = config.hostInterface;
+    next.hostIfQueues = config.hostIfQueues;
+    next.hostIfRxQueueSize = config.hostIfRxQueueSize;
+    next.hostIfTxQueueSize = config.hostIfTxQueueSize;
+    next.xdpZeroCopy = config.xdpZeroCopy;
+    next.xdpNoSyscallLock = config.xdpNoSyscallLock;
+    next.xdpRss = config.xdpRss;
+    next.hostAddr4 = config.hostAddr4;
+    next.xdpAddresses = config.xdpAddresses;
+    next.xdpPorts = config.xdpPorts;
+}
+
+// Apply the configuration file again, touching only what changed. The tap and
+// xdp interfaces are only recreated if one of their creation parameters changed.
+void reload(TranslatorConfig& config, PathManager& pm)
+{
+    TranslatorConfig next;
+    try {
+        loadConfig(args.config, next);
+    }
+    catch (const std::exception& e) {
+        spdlog::error("reload failed, keeping the current configuration ({})", e.what());
+        return;
+    }
+    spdlog::info("reloading configuration");
+
+    if (next.logLevel != config.logLevel) {
+        spdlog::set_level(next.logLevel);
+    }
+
+    if (next.localIA != config.localIA || next.gatewayAddr != config.gatewayAddr
+        || next.gatewayAddr4 != config.gatewayAddr4 || next.sciondEp != config.sciondEp
+        || next.sciondConnections != config.sciondConnections) {
+        spdlog::warn("changes to the local AS, gateway or SCION daemon connection require a restart");
+        next.localIA = config.localIA;
+        next.gatewayAddr = config.gatewayAddr;
+        next.gatewayAddr4 = config.gatewayAddr4;
+        next.sciondEp = config.sciondEp;
+        next.sciondConnections = config.sciondConnections;
+    }
+
+    bool newTap = next.tapName != config.tapName || next.hostAddr != config.hostAddr
+        || next.tapRxQueues != config.tapRxQueues || next.tapTxQueues != config.tapTxQueues
+        || next.tapRxRingSize != config.tapRxRingSize || next.tapTxRingSize != config.tapTxRingSize
+        || next.tapGso != config.tapGso || next.tapCsumOffload != config.tapCsumOffload
+        || next.tapPackedRing != config.tapPackedRing;
+    bool newXdp = next.hostInterface != config.hostInterface
+        || next.hostIfQueues != config.hostIfQueues
+        || next.hostIfRxQueueSize != config.hostIfRxQueueSize
+        || next.hostIfTxQueueSize != config.hostIfTxQueueSize
+        || next.xdpZeroCopy != config.xdpZeroCopy
+        || next.xdpNoSyscallLock != config.xdpNoSyscallLock;
+
+    // Each part is applied on its own. A part that fails keeps its old values,
+    // so that the next reload tries again.
+    // The kernel removes the routes of a destroyed tap interface, they must be
+    // added again even if the old tap interface is restored.
+    bool tapDestroyed = false;
+    if (newTap) {
+        try {
+            spdlog::info("recreating tap interface");
+            tap.destroy(*dp);
+            tapDestroyed = true;
+            createTap(next);
+        }
+        catch (const std::exception& e) {
+            spdlog::error("recreating the tap interface failed ({})", e.what());
+            keepTapConfig(next, config);
+            try {
+                createTap(next);
+            }
+            catch (const std::exception& err) {
+                spdlog::error("restoring the tap interface failed ({})", err.what());
+            }
+        }
+    }
+    if (newXdp) {
+        try {
+            spdlog::info("recreating xdp interface");
+            xdp.destroy(*dp);
+            unpinScionIpMap();
+            restoreHostInterface();
+            createXdp(next);
+        }
+        catch (const std::exception& e) {
+            spdlog::error("recreating the xdp interface failed ({})", e.what());
+            keepXdpConfig(next, config);
+            try {
+                createXdp(next);
+            }
+            catch (const std::exception& err) {
+                spdlog::error("restoring the xdp interface failed ({})", err.what());
+            }
+        }
+    } else {
+        if (next.xdpRss != config.xdpRss && !tuneHostInterface(next, xdpRxQueues)) {
+            next.xdpRss = config.xdpRss;
+        }
+        if (next.hostAddr != config.hostAddr || next.hostAddr4 != config.hostAddr4
+            || next.xdpAddresses != config.xdpAddresses || next.xdpPorts != config.xdpPorts) {
+            if (!reloadScionIpMap(next)) {
+                // The tap interface may already use the new host_addr
+                next.hostAddr4 = config.hostAddr4;
+                next.xdpAddresses = config.xdpAddresses;
+                next.xdpPorts = config.xdpPorts;
+            }
+        }
+    }
+    if (tapDestroyed || next.hostInterface != config.hostInterface) {
+        try {
+            configureRoutes(next);
+        }
+        catch (const std::exception& e) {
+            spdlog::error("configuring the routes failed ({})", e.what());
+        }
+    }
+
+    for (auto dst : config.destinations) {
+        if (std::ranges::find(next.destinations, dst) == next.destinations.end())
+            pm.removeDestination(dst);
+    }
+    for (auto dst : next.destinations) {
+        pm.addDestination(dst);
+    }
+    pm.setRefreshMargin(next.refreshMargin);
+
+    config = std::move(next);
+    spdlog::debug("Config:\n\"\"\"\n{}\n\"\"\"", dumpConfig(config));
+}
+
 void cleanup()
 {
     cleanDataplane();
@@ -157,10 +463,65 @@ int main(int argc, char* argv[])
 {
     parseCommandLine(argc, argv);
 
-    if (!init()) {
+    TranslatorConfig config;
+    if (!init(config)) {
         cleanup();
         return -1;
     }
 
+    asio::io_context ioCtx;
+    dp->enableAsync(ioCtx);
+    PathManager pm(ioCtx, *dp, config);
+
+    asio::steady_timer statsTimer(ioCtx);
+    std::vector<XdpQueueStats> stats;
+    if (config.xdpStatsInterval.count() > 0) {
+        reportXdpStats(statsTimer, config, stats);
+    }
+
+    // Reload the configuration on SIGHUP
+    asio::signal_set hangup(ioCtx, SIGHUP);
+    std::function<void(std::error_code, int)> onHangup = [&](std::error_code ec, int) {
+        if (ec) return;
+        bool statsEnabled = config.xdpStatsInterval.count() > 0;
+        reload(config, pm);
+        if (!statsEnabled && config.xdpStatsInterval.count() > 0) {
+            reportXdpStats(statsTimer, config, stats);
+        } else if (statsEnabled && config.xdpStatsInterval.count() == 0) {
+            statsTimer.cancel();
+        }
+        hangup.async_wait(onHangup);
+    };
+    hangup.async_wait(onHangup);
+
+    // Remove the installed paths and the interfaces before exiting. Gives up
+    // on the paths after SHUTDOWN_TIMEOUT or on a second signal.
+    asio::signal_set signals(ioCtx, SIGINT, SIGTERM);
+    asio::steady_timer shutdownTimer(ioCtx);
+    signals.async_wait([&](std::error_code ec, int signal) {
+        if (ec) return;
+        spdlog::info("received signal {}, shutting down", signal);
+        hangup.cancel();
+        statsTimer.cancel();
+        pm.stop([&]() { ioCtx.stop(); });
+
+        shutdownTimer.expires_after(SHUTDOWN_TIMEOUT);
+        shutdownTimer.async_wait([&](std::error_code ec) {
+            if (ec) return;
+            spdlog::warn("paths not removed after {}s, exiting anyway", SHUTDOWN_TIMEOUT.count());
+            ioCtx.stop();
+        });
+        signals.async_wait([&](std::error_code ec, int signal) {
+            if (ec) return;
+            spdlog::warn("received signal {} again, exiting without removing the paths", signal);
+            ioCtx.stop();
+        });
+    });
+
+    pm.start();
+    ioCtx.run();
+    dp->disableAsync();
+
+    cleanup();
     return 0;
 }
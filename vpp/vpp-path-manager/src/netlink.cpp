@@ -21,6 +21,8 @@
 #include "netlink.hpp"
 #include <spdlog/spdlog.h>
 #include <linux/rtnetlink.h>
+#include <linux/genetlink.h>
+#include <linux/ethtool_netlink.h>
 #include <memory>
 
 using asio::ip::network_v4;
@@ -153,3 +155,131 @@ void NetLinkRoute::execute(nlmsghdr* nlh, char* buf, size_t bufsize)
 template void NetLinkRoute::addRoute<network_v6>(network_v6 dst, const char* dev);
 // template void NetLinkRoute::delRoute<network_v4>(network_v4 dst, const char* dev);
 template void NetLinkRoute::delRoute<network_v6>(network_v6 dst, const char* dev);
+
+NetLinkEthtool::NetLinkEthtool()
+    : seq(time(NULL))
+{
+    nl = mnl_socket_open(NETLINK_GENERIC);
+    if (!nl) throw std::runtime_error("cannot open netlink socket to generic bus");
+    if (mnl_socket_bind(nl, 0, MNL_SOCKET_AUTOPID) < 0) {
+        mnl_socket_close(nl);
+        throw std::system_error(errno, std::generic_category(), "mnl_socket_bind");
+    }
+
+    // Resolve the ID of the ethtool family
+    size_t bufsize = MNL_SOCKET_BUFFER_SIZE;
+    auto buf = std::make_unique<char[]>(bufsize);
+
+    nlmsghdr* nlh = mnl_nlmsg_put_header(buf.get());
+    nlh->nlmsg_type = GENL_ID_CTRL;
+    nlh->nlmsg_flags = NLM_F_REQUEST;
+    nlh->nlmsg_seq = ++seq;
+
+    auto genl = (genlmsghdr*)mnl_nlmsg_put_extra_header(nlh, sizeof(genlmsghdr));
+    genl->cmd = CTRL_CMD_GETFAMILY;
+    genl->version = 1;
+    mnl_attr_put_strz(nlh, CTRL_ATTR_FAMILY_NAME, ETHTOOL_GENL_NAME);
+
+    auto parse = [](const nlmsghdr* nlh, void* data) -> int {
+        auto attr = [](const nlattr* attr, void* data) -> int {
+            if (mnl_attr_get_type(attr) == CTRL_ATTR_FAMILY_ID
+                && mnl_attr_validate(attr, MNL_TYPE_U16) >= 0) {
+                *static_cast<uint16_t*>(data) = mnl_attr_get_u16(attr);
+            }
+            return MNL_CB_OK;
+        };
+        return mnl_attr_parse(nlh, sizeof(genlmsghdr), attr, data);
+    };
+    try {
+        execute(nlh, buf.get(), bufsize, parse, &family);
+    }
+    catch (...) {
+        mnl_socket_close(nl);
+        throw;
+    }
+    if (family == 0) {
+        mnl_socket_close(nl);
+        throw std::runtime_error("ethtool netlink family not available");
+    }
+}
+
+NetLinkEthtool::~NetLinkEthtool()
+{
+    if (nl) mnl_socket_close(nl);
+}
+
+NetLinkEthtool::Channels NetLinkEthtool::getChannels(const char* dev)
+{
+    size_t bufsize = MNL_SOCKET_BUFFER_SIZE;
+    auto buf = std::make_unique<char[]>(bufsize);
+
+    nlmsghdr* nlh = mnl_nlmsg_put_header(buf.get());
+    nlh->nlmsg_type = family;
+    nlh->nlmsg_flags = NLM_F_REQUEST;
+    nlh->nlmsg_seq = ++seq;
+
+    auto genl = (genlmsghdr*)mnl_nlmsg_put_extra_header(nlh, sizeof(genlmsghdr));
+    genl->cmd = ETHTOOL_MSG_CHANNELS_GET;
+    genl->version = ETHTOOL_GENL_VERSION;
+    nlattr* header = mnl_attr_nest_start(nlh, ETHTOOL_A_CHANNELS_HEADER);
+    mnl_attr_put_strz(nlh, ETHTOOL_A_HEADER_DEV_NAME, dev);
+    mnl_attr_nest_end(nlh, header);
+
+    auto parse = [](const nlmsghdr* nlh, void* data) -> int {
+        auto attr = [](const nlattr* attr, void* data) -> int {
+            auto& ch = *static_cast<Channels*>(data);
+            if (mnl_attr_validate(attr, MNL_TYPE_U32) < 0)
+                return MNL_CB_OK;
+            switch (mnl_attr_get_type(attr)) {
+            case ETHTOOL_A_CHANNELS_RX_MAX:
+                ch.maxRx = mnl_attr_get_u32(attr);
+                break;
+            case ETHTOOL_A_CHANNELS_TX_MAX:
+                ch.maxTx = mnl_attr_get_u32(attr);
+                break;
+            case ETHTOOL_A_CHANNELS_OTHER_MAX:
+                ch.maxOther = mnl_attr_get_u32(attr);
+                break;
+            case ETHTOOL_A_CHANNELS_COMBINED_MAX:
+                ch.maxCombined = mnl_attr_get_u32(attr);
+                break;
+            case ETHTOOL_A_CHANNELS_RX_COUNT:
+                ch.rx = mnl_attr_get_u32(attr);
+                break;
+            case ETHTOOL_A_CHANNELS_TX_COUNT:
+                ch.tx = mnl_attr_get_u32(attr);
+                break;
+            case ETHTOOL_A_CHANNELS_OTHER_COUNT:
+                ch.other = mnl_attr_get_u32(attr);
+                break;
+            case ETHTOOL_A_CHANNELS_COMBINED_COUNT:
+                ch.combined = mnl_attr_get_u32(attr);
+                break;
+            default:
+                break;
+            }
+            return MNL_CB_OK;
+        };
+        return mnl_attr_parse(nlh, sizeof(genlmsghdr), attr, data);
+    };
+
+    Channels channels;
+    execute(nlh, buf.get(), bufsize, parse, &channels);
+    return channels;
+}
+
+void NetLinkEthtool::execute(nlmsghdr* nlh, char* buf, size_t bufsize, mnl_cb_t cb, void* data)
+{
+    auto portid = mnl_socket_get_portid(nl);
+    auto reqSeq = nlh->nlmsg_seq;
+    if (mnl_socket_sendto(nl, nlh, nlh->nlmsg_len) < 0) {
+        throw std::system_error(errno, std::generic_category(), "mnl_socket_sendto");
+    }
+    ssize_t numbytes = mnl_socket_recvfrom(nl, buf, bufsize);
+    if (numbytes < 0) {
+        throw std::system_error(errno, std::generic_category(), "mnl_socket_recvfrom");
+    }
+    if (mnl_cb_run(buf, numbytes, reqSeq, portid, cb, data) < 0) {
+        throw std::system_error(errno, std::generic_category(), "mnl_cb_run");
+    }
+}
@@ -52,3 +52,34 @@ public:
 private:
     void execute(nlmsghdr* nlh, char* buf, size_t bufsize);
 };
+
+// Queries NIC settings via the ethtool generic netlink family (Linux 5.6+)
+class NetLinkEthtool
+{
+public:
+    struct Channels
+    {
+        uint32_t rx = 0, tx = 0, other = 0, combined = 0;
+        uint32_t maxRx = 0, maxTx = 0, maxOther = 0, maxCombined = 0;
+
+        // Number of queues that receive packets
+        uint32_t rxQueues() const { return combined + rx; }
+    };
+
+private:
+    mnl_socket* nl = nullptr;
+    uint32_t seq;
+    uint16_t family = 0;
+
+public:
+    NetLinkEthtool();
+    NetLinkEthtool(const NetLinkEthtool& other) = delete;
+    NetLinkEthtool& operator=(const NetLinkEthtool& other) = delete;
+
+    ~NetLinkEthtool();
+
+    Channels getChannels(const char* dev);
+
+private:
+    void execute(nlmsghdr* nlh, char* buf, size_t bufsize, mnl_cb_t cb, void* data);
+};
@@ -0,0 +1,396 @@
+// Copyright (c) 2024 Lars-Christian Schulz
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "path_manager.hpp"
+
+#include <vapi/scion_ip_translator.api.vapi.hpp>
+#include <snet/snet.hpp>
+#include <spdlog/spdlog.h>
+#include <spdlog/fmt/ostr.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <sstream>
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::system_clock;
+
+// Connection to the SCION daemon, kept out of the header to not mix the
+// address types of the SCION bindings with our own. Used by one query at a
+// time, queries in parallel take different connections.
+class SciondConnection
+{
+public:
+    std::mutex mutex;
+    scion::HostCtx hostCtx;
+};
+
+// Expiration time of a standard SCION path, the earliest expiration of its hop fields
+static Clock::time_point pathExpiry(std::span<const std::uint8_t> dp)
+{
+    constexpr std::size_t META_LEN = 4, INFO_LEN = 8, HOP_LEN = 12;
+    constexpr auto EXP_TIME_UNIT = std::chrono::milliseconds(24 * 60 * 60 * 1000) / 256;
+
+    auto expiry = Clock::time_point::max();
+    if (dp.size() < META_LEN) return expiry;
+
+    std::uint32_t meta = (dp[0] << 24) | (dp[1] << 16) | (dp[2] << 8) | dp[3];
+    std::size_t segLen[3] = {(meta >> 12) & 0x3f, (meta >> 6) & 0x3f, meta & 0x3f};
+    std::size_t numInf = segLen[2] ? 3 : (segLen[1] ? 2 : (segLen[0] ? 1 : 0));
+
+    std::size_t hop = META_LEN + numInf * INFO_LEN;
+    for (std::size_t i = 0; i < numInf; ++i) {
+        std::size_t info = META_LEN + i * INFO_LEN;
+        if (info + INFO_LEN > dp.size()) return Clock::time_point::min();
+        std::uint32_t timestamp = (dp[info + 4] << 24) | (dp[info + 5] << 16)
+            | (dp[info + 6] << 8) | dp[info + 7];
+        for (std::size_t j = 0; j < segLen[i]; ++j, hop += HOP_LEN) {
+            if (hop + HOP_LEN > dp.size()) return Clock::time_point::min();
+            auto exp = Clock::time_point(std::chrono::seconds(timestamp))
+                + (1 + dp[hop + 1]) * EXP_TIME_UNIT;
+            expiry = std::min(expiry, std::chrono::time_point_cast<Clock::duration>(exp));
+        }
+    }
+    return expiry;
+}
+
+// Size of a path record in scion_ip_translator_add_paths
+static std::size_t recordSize(const PathEntry& path)
+{
+    return 8 + 4 + 16 + 2 + 2 + 2 + path.dp.size();
+}
+
+template <typename T>
+static std::uint8_t* putBigEndian(std::uint8_t* out, T value)
+{
+    for (std::size_t i = sizeof(T); i > 0; --i) {
+        *out++ = static_cast<std::uint8_t>(value >> (8 * (i - 1)));
+    }
+    return out;
+}
+
+static std::uint8_t* putRecord(std::uint8_t* out, scion::IsdAsn dst, const PathEntry& path)
+{
+    auto expiry = std::chrono::duration_cast<std::chrono::seconds>(path.expiry.time_since_epoch());
+    out = putBigEndian<std::uint64_t>(out, dst);
+    out = putBigEndian(out, static_cast<std::uint32_t>(std::min<std::chrono::seconds::rep>(
+        expiry.count(), std::numeric_limits<std::uint32_t>::max())));
+    out = std::copy(path.nextHop.begin(), path.nextHop.end(), out);
+    out = putBigEndian(out, path.nextHopPort);
+    out = putBigEndian(out, path.mtu);
+    out = putBigEndian(out, static_cast<std::uint16_t>(path.dp.size()));
+    return std::copy(path.dp.begin(), path.dp.end(), out);
+}
+
+PathManager::PathManager(asio::io_context& ioCtx, Dataplane& dp, const TranslatorConfig& config)
+    : ioCtx(ioCtx)
+    , dp(dp)
+    , connections(config.sciondConnections)
+    , queryPool(config.sciondConnections)
+    , connectTimer(ioCtx)
+    , refreshMargin(config.refreshMargin)
+    , batchTimer(ioCtx)
+{
+    std::stringstream ep;
+    ep << config.sciondEp;
+    sciondAddr = ep.str();
+    for (auto dst : config.destinations) {
+        addDestination(dst);
+    }
+}
+
+PathManager::~PathManager()
+{
+    queryPool.join();
+}
+
+void PathManager::start()
+{
+    connect();
+}
+
+void PathManager::connect()
+{
+    // Fresh contexts, queries still in flight keep using the old ones
+    asio::post(queryPool, [this]() {
+        auto cons = std::make_shared<std::vector<SciondConnection>>(connections);
+        for (auto& con : *cons) {
+            if (con.hostCtx.init(sciondAddr.c_str(), 1s) != scion::Status::Success) {
+                cons.reset();
+                break;
+            }
+        }
+        asio::post(ioCtx, [this, cons]() { onConnect(cons); });
+    });
+}
+
+void PathManager::onConnect(std::shared_ptr<std::vector<SciondConnection>> cons)
+{
+    if (stopped) return;
+    if (!cons) {
+        spdlog::warn("cannot connect to SCION daemon at {}, retrying", sciondAddr);
+        connectTimer.expires_after(RETRY_INTERVAL);
+        connectTimer.async_wait([this](std::error_code ec) {
+            if (!ec && !stopped) connect();
+        });
+        return;
+    }
+    spdlog::info("connected to SCION daemon at {}", sciondAddr);
+    sciond = std::move(cons);
+    connected = true;
+    failedQueries = 0;
+    // After a reconnect, installed paths are left to their refresh timers
+    for (const auto& [dst, entry] : destinations) {
+        if (!entry->installed || entry->deferred) {
+            entry->deferred = false;
+            entry->timer.cancel();
+            query(dst);
+        }
+    }
+}
+
+void PathManager::addDestination(scion::IsdAsn dst)
+{
+    if (destinations.contains(dst)) return;
+    destinations.emplace(dst, std::make_unique<Destination>(ioCtx));
+    if (connected) query(dst);
+}
+
+void PathManager::removeDestination(scion::IsdAsn dst)
+{
+    auto i = destinations.find(dst);
+    if (i == destinations.end()) return;
+    bool installed = i->second->installed;
+    // Destroying the timer cancels a pending refresh
+    destinations.erase(i);
+    if (auto update = updates.find(dst); update != updates.end()) {
+        updateBytes -= recordSize(update->second);
+        updates.erase(update);
+    }
+    if (installed) remove(dst, [] {});
+}
+
+void PathManager::query(scion::IsdAsn dst)
+{
+    // Queried again once the daemon is back
+    if (!connected) {
+        if (auto i = destinations.find(dst); i != destinations.end())
+            i->second->deferred = true;
+        return;
+    }
+
+    // Queries block for up to their timeout, keep them off the I/O context
+    auto index = nextConnection++ % sciond->size();
+    asio::post(queryPool, [this, dst, cons = sciond, index]() {
+        auto& con = (*cons)[index];
+        scion::Status status;
+        scion::PathVec paths;
+        {
+            std::lock_guard lock(con.mutex);
+            std::tie(paths, status) = con.hostCtx.queryPaths(
+                scion::IA{static_cast<std::uint64_t>(dst)}, 0, 100ms);
+        }
+
+        std::vector<PathEntry> result;
+        if (status == scion::Status::Success) {
+            for (const auto& path : paths) {
+                PathEntry entry;
+                entry.dp.assign(path->dp.begin(), path->dp.end());
+                auto nextHop = path->nextHop.getIPv6();
+                std::copy_n(nextHop.data(), std::min(nextHop.size(), entry.nextHop.size()),
+                    entry.nextHop.begin());
+                entry.nextHopPort = path->nextHop.getPort();
+                entry.mtu = path->mtu;
+                entry.expiry = pathExpiry(entry.dp);
+                result.push_back(std::move(entry));
+            }
+        } else {
+            spdlog::warn("path query to {} failed ({})", fmt::streamed(dst), fmt::streamed(status));
+        }
+        bool failed = status != scion::Status::Success;
+        asio::post(ioCtx, [this, dst, failed, result = std::move(result)]() mutable {
+            onPaths(dst, failed, std::move(result));
+        });
+    });
+}
+
+void PathManager::onPaths(scion::IsdAsn dst, bool failed, std::vector<PathEntry> paths)
+{
+    if (stopped) return;
+    if (!failed) {
+        failedQueries = 0;
+    } else if (connected && ++failedQueries >= RECONNECT_AFTER_FAILURES) {
+        spdlog::warn("SCION daemon at {} does not answer, reconnecting", sciondAddr);
+        connected = false;
+        connect();
+    }
+    if (!destinations.contains(dst)) return;
+
+    // The daemon returns the paths in order of preference, take the first one
+    // that stays valid long enough to be worth installing
+    auto now = Clock::now();
+    auto path = std::find_if(paths.begin(), paths.end(), [&](const PathEntry& p) {
+        return p.expiry > now + refreshMargin;
+    });
+    if (path == paths.end()) {
+        spdlog::warn("no usable path to {}", fmt::streamed(dst));
+        schedule(dst, RETRY_INTERVAL);
+        return;
+    }
+
+    install(dst, *path);
+    auto refresh = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        path->expiry - now - refreshMargin);
+    schedule(dst, std::clamp<std::chrono::steady_clock::duration>(
+        refresh, MIN_REFRESH_INTERVAL, MAX_REFRESH_INTERVAL));
+}
+
+void PathManager::schedule(scion::IsdAsn dst, std::chrono::steady_clock::duration delay)
+{
+    auto i = destinations.find(dst);
+    if (i == destinations.end()) return;
+    auto& timer = i->second->timer;
+    timer.expires_after(delay);
+    timer.async_wait([this, dst](std::error_code ec) {
+        if (!ec && !stopped) query(dst);
+    });
+}
+
+void PathManager::install(scion::IsdAsn dst, const PathEntry& path)
+{
+    // Requests are processed in order, so marking the path as installed right
+    // away makes stop() remove it even if it is still queued.
+    destinations[dst]->installed = true;
+
+    if (auto i = updates.find(dst); i != updates.end()) {
+        updateBytes -= recordSize(i->second);
+        i->second = path;
+    } else {
+        updates.emplace(dst, path);
+    }
+    updateBytes += recordSize(path);
+    if (updateBytes >= MAX_BATCH_BYTES) {
+        sendUpdates();
+    } else if (!batchPending) {
+        batchPending = true;
+        batchTimer.expires_after(COALESCE_DELAY);
+        batchTimer.async_wait([this](std::error_code ec) {
+            if (!ec) sendUpdates();
+        });
+    }
+}
+
+void PathManager::sendUpdates()
+{
+    batchPending = false;
+    batchTimer.cancel();
+
+    while (!updates.empty()) {
+        std::vector<scion::IsdAsn> batch;
+        std::vector<std::uint8_t> data;
+        data.reserve(std::min(updateBytes, MAX_BATCH_BYTES + 1024));
+        while (!updates.empty() && data.size() < MAX_BATCH_BYTES) {
+            auto node = updates.extract(updates.begin());
+            auto offset = data.size();
+            data.resize(offset + recordSize(node.mapped()));
+            putRecord(data.data() + offset, node.key(), node.mapped());
+            batch.push_back(node.key());
+        }
+        updateBytes = updates.empty() ? 0 : updateBytes - data.size();
+
+        auto count = static_cast<std::uint32_t>(batch.size());
+        auto size = data.size();
+        auto fill = [count, data = std::make_shared<std::vector<std::uint8_t>>(std::move(data))](auto& mp) {
+            mp.count = count;
+            mp.data_len = static_cast<std::uint32_t>(data->size());
+            std::memcpy(mp.data, data->data(), data->size());
+        };
+        auto done = [this, batch](std::error_code ec, vapi::Scion_ip_translator_add_paths& req) {
+            int retval = ec ? 0 : req.get_response().get_payload().retval;
+            if (!ec && retval == 0) {
+                spdlog::debug("installed {} paths", batch.size());
+                for (auto dst : batch) {
+                    auto i = destinations.find(dst);
+                    if (i == destinations.end()) continue;
+                    i->second->installed = true;
+                    i->second->acknowledged = true;
+                }
+                return;
+            }
+            if (ec)
+                spdlog::error("cannot install {} paths ({})", batch.size(), ec.message());
+            else
+                spdlog::error("cannot install {} paths (returned {})", batch.size(), retval);
+            // The batch is applied all or nothing, the plugin keeps the
+            // previous path of a destination that was only refreshed
+            for (auto dst : batch) {
+                auto i = destinations.find(dst);
+                if (i == destinations.end()) continue;
+                if (!updates.contains(dst))
+                    i->second->installed = i->second->acknowledged;
+                if (!stopped) schedule(dst, RETRY_INTERVAL);
+            }
+        };
+        dp.asyncExec<vapi::Scion_ip_translator_add_paths>(fill, done, size);
+    }
+}
+
+void PathManager::remove(scion::IsdAsn dst, std::function<void()> done)
+{
+    auto fill = [dst](auto& mp) {
+        mp.dst_ia = static_cast<std::uint64_t>(dst);
+    };
+    auto handler = [dst, done](std::error_code ec, vapi::Scion_ip_translator_del_path& req) {
+        if (ec)
+            spdlog::error("cannot remove path to {} ({})", fmt::streamed(dst), ec.message());
+        else if (auto retval = req.get_response().get_payload().retval; retval != 0)
+            spdlog::error("cannot remove path to {} (returned {})", fmt::streamed(dst), retval);
+        done();
+    };
+    dp.asyncExec<vapi::Scion_ip_translator_del_path>(fill, handler);
+}
+
+void PathManager::stop(std::function<void()> done)
+{
+    if (stopped) return;
+    stopped = true;
+    connectTimer.cancel();
+    batchTimer.cancel();
+    queryPool.stop();
+    updates.clear();
+
+    auto pending = std::make_shared<std::size_t>(1);
+    auto removed = [pending, done]() {
+        if (--*pending == 0) done();
+    };
+    for (auto& [dst, entry] : destinations) {
+        entry->timer.cancel();
+        if (entry->installed) {
+            ++*pending;
+            remove(dst, removed);
+            entry->installed = false;
+            entry->acknowledged = false;
+        }
+    }
+    asio::post(ioCtx, removed);
+}
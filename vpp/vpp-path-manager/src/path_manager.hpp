@@ -0,0 +1,137 @@
+// Copyright (c) 2024 Lars-Christian Schulz
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include "config.hpp"
+#include "dataplane.hpp"
+
+#include <asio.hpp>
+#include <scion/addr/isd_asn.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class SciondConnection;
+
+// Forwarding information of a path as installed in the translator plugin
+struct PathEntry
+{
+    std::vector<std::uint8_t> dp;
+    std::array<std::uint8_t, 16> nextHop = {};
+    std::uint16_t nextHopPort = 0;
+    std::uint16_t mtu = 0;
+    std::chrono::system_clock::time_point expiry = std::chrono::system_clock::time_point::max();
+};
+
+// Keeps the translator plugin supplied with paths to the configured destinations.
+// The SCION daemon is queried from a pool of threads, as the queries block, each
+// with a connection of its own. Paths are installed asynchronously from the I/O
+// context, which owns the VAPI connection.
+// Every path is replaced before it expires. If several queries in a row fail,
+// the daemon is assumed to be gone and the connection is established anew.
+// Installed paths stay in place in the meantime.
+class PathManager
+{
+private:
+    struct Destination
+    {
+        explicit Destination(asio::io_context& ioCtx) : timer(ioCtx) {}
+        asio::steady_timer timer;
+        // The plugin may hold a path, it has to be removed on stop
+        bool installed = false;
+        // The plugin confirmed a path, it keeps it if a later update fails
+        bool acknowledged = false;
+        // A query was due while the daemon was not connected
+        bool deferred = false;
+    };
+
+    asio::io_context& ioCtx;
+    Dataplane& dp;
+    // Shared with the queries in flight, replaced on reconnect
+    std::shared_ptr<std::vector<SciondConnection>> sciond;
+    std::size_t nextConnection = 0;
+    std::string sciondAddr;
+    unsigned int connections;
+    asio::thread_pool queryPool;
+    asio::steady_timer connectTimer;
+    std::chrono::seconds refreshMargin;
+    std::map<scion::IsdAsn, std::unique_ptr<Destination>> destinations;
+
+    // Paths waiting to be installed in the next batch
+    std::map<scion::IsdAsn, PathEntry> updates;
+    std::size_t updateBytes = 0;
+    asio::steady_timer batchTimer;
+    bool batchPending = false;
+
+    bool connected = false;
+    bool stopped = false;
+    unsigned failedQueries = 0;
+
+public:
+    static constexpr auto RETRY_INTERVAL = std::chrono::seconds(10);
+    // Failed queries in a row after which the daemon is reconnected
+    static constexpr unsigned RECONNECT_AFTER_FAILURES = 3;
+    static constexpr auto MIN_REFRESH_INTERVAL = std::chrono::seconds(10);
+    // Paths to the local AS never expire, but better ones may appear.
+    static constexpr auto MAX_REFRESH_INTERVAL = std::chrono::hours(1);
+    // Time to wait for more paths before installing a partial batch.
+    static constexpr auto COALESCE_DELAY = std::chrono::milliseconds(10);
+    // Size a batch of paths is sent at. Together with the limit on outstanding
+    // requests, this bounds the memory VPP has to buffer for us.
+    static constexpr std::size_t MAX_BATCH_BYTES = 64 * 1024;
+
+    PathManager(asio::io_context& ioCtx, Dataplane& dp, const TranslatorConfig& config);
+    PathManager(const PathManager& other) = delete;
+    PathManager& operator=(const PathManager& other) = delete;
+    ~PathManager();
+
+    // Connect to the SCION daemon and start resolving the destinations.
+    void start();
+
+    // Keep a path to dst installed from now on.
+    void addDestination(scion::IsdAsn dst);
+
+    // Stop refreshing the path to dst and remove it from the plugin.
+    void removeDestination(scion::IsdAsn dst);
+
+    // Takes effect with the next refresh of each path.
+    void setRefreshMargin(std::chrono::seconds margin) { refreshMargin = margin; }
+
+    // Stop all activity and remove the installed paths from the plugin. `done`
+    // is called once the plugin acknowledged the removals.
+    void stop(std::function<void()> done);
+
+private:
+    void connect();
+    void onConnect(std::shared_ptr<std::vector<SciondConnection>> cons);
+    void query(scion::IsdAsn dst);
+    void onPaths(scion::IsdAsn dst, bool failed, std::vector<PathEntry> paths);
+    void schedule(scion::IsdAsn dst, std::chrono::steady_clock::duration delay);
+    void install(scion::IsdAsn dst, const PathEntry& path);
+    void sendUpdates();
+    void remove(scion::IsdAsn dst, std::function<void()> done);
+};
@@ -0,0 +1,162 @@
+// Copyright (c) 2024 Lars-Christian Schulz
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "rss.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <vector>
+
+// Socket to issue ethtool ioctls on
+class EthtoolSocket
+{
+private:
+    int fd;
+    std::string iface;
+
+public:
+    explicit EthtoolSocket(const std::string& iface)
+        : fd(socket(AF_INET, SOCK_DGRAM, 0)), iface(iface)
+    {
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), "socket");
+    }
+    EthtoolSocket(const EthtoolSocket& other) = delete;
+    EthtoolSocket& operator=(const EthtoolSocket& other) = delete;
+
+    ~EthtoolSocket() { close(fd); }
+
+    void ioctl(void* cmd, const char* what)
+    {
+        ifreq ifr = {};
+        std::strncpy(ifr.ifr_name, iface.c_str(), IFNAMSIZ - 1);
+        ifr.ifr_data = static_cast<char*>(cmd);
+        if (::ioctl(fd, SIOCETHTOOL, &ifr) < 0)
+            throw std::system_error(errno, std::generic_category(), what);
+    }
+};
+
+static std::uint64_t getRssHash(EthtoolSocket& sock, std::uint32_t flowType)
+{
+    ethtool_rxnfc nfc = {};
+    nfc.cmd = ETHTOOL_GRXFH;
+    nfc.flow_type = flowType;
+    sock.ioctl(&nfc, "ETHTOOL_GRXFH");
+    return nfc.data;
+}
+
+static void setRssHash(EthtoolSocket& sock, std::uint32_t flowType, std::uint64_t fields)
+{
+    ethtool_rxnfc nfc = {};
+    nfc.cmd = ETHTOOL_SRXFH;
+    nfc.flow_type = flowType;
+    nfc.data = fields;
+    sock.ioctl(&nfc, "ETHTOOL_SRXFH");
+}
+
+// Write the indirection table, the ethtool header is followed by the entries
+static void setRssIndirection(EthtoolSocket& sock, const std::vector<std::uint32_t>& table)
+{
+    auto bytes = sizeof(ethtool_rxfh_indir) + table.size() * sizeof(std::uint32_t);
+    std::vector<std::uint64_t> buf((bytes + 7) / 8);
+    auto indir = reinterpret_cast<ethtool_rxfh_indir*>(buf.data());
+    indir->cmd = ETHTOOL_SRXFHINDIR;
+    indir->size = static_cast<std::uint32_t>(table.size());
+    std::copy(table.begin(), table.end(), indir->ring_index);
+    sock.ioctl(indir, "ETHTOOL_SRXFHINDIR");
+}
+
+static std::vector<std::uint32_t> getRssIndirection(EthtoolSocket& sock)
+{
+    // A request with size 0 returns the size of the table
+    ethtool_rxfh_indir query = {};
+    query.cmd = ETHTOOL_GRXFHINDIR;
+    sock.ioctl(&query, "ETHTOOL_GRXFHINDIR");
+    std::uint32_t size = query.size;
+    if (size == 0)
+        throw std::runtime_error("NIC has no RSS indirection table");
+
+    auto bytes = sizeof(ethtool_rxfh_indir) + size * sizeof(std::uint32_t);
+    std::vector<std::uint64_t> buf((bytes + 7) / 8);
+    auto indir = reinterpret_cast<ethtool_rxfh_indir*>(buf.data());
+    indir->cmd = ETHTOOL_GRXFHINDIR;
+    indir->size = size;
+    sock.ioctl(indir, "ETHTOOL_GRXFHINDIR");
+    return std::vector<std::uint32_t>(indir->ring_index, indir->ring_index + size);
+}
+
+RssSnapshot saveRss(const std::string& iface)
+{
+    EthtoolSocket sock(iface);
+    RssSnapshot snapshot;
+    snapshot.iface = iface;
+    snapshot.udp4Fields = getRssHash(sock, UDP_V4_FLOW);
+    snapshot.udp6Fields = getRssHash(sock, UDP_V6_FLOW);
+    snapshot.indirection = getRssIndirection(sock);
+    return snapshot;
+}
+
+void restoreRss(const RssSnapshot& snapshot)
+{
+    EthtoolSocket sock(snapshot.iface);
+    setRssHash(sock, UDP_V4_FLOW, snapshot.udp4Fields);
+    setRssHash(sock, UDP_V6_FLOW, snapshot.udp6Fields);
+    setRssIndirection(sock, snapshot.indirection);
+    spdlog::info("restored the RSS settings of {}", snapshot.iface);
+}
+
+void setUdpRssHash(const std::string& iface)
+{
+    constexpr std::uint64_t fields = RXH_IP_SRC | RXH_IP_DST | RXH_L4_B_0_1 | RXH_L4_B_2_3;
+    EthtoolSocket sock(iface);
+
+    for (std::uint32_t flowType : {UDP_V4_FLOW, UDP_V6_FLOW}) {
+        setRssHash(sock, flowType, fields);
+        if (getRssHash(sock, flowType) != fields) {
+            throw std::runtime_error("NIC does not hash UDP flows on addresses and ports");
+        }
+    }
+    spdlog::info("RSS on {} hashes UDP flows on addresses and ports", iface);
+}
+
+void setRssQueues(const std::string& iface, std::uint32_t queues)
+{
+    if (queues == 0) return;
+    EthtoolSocket sock(iface);
+
+    auto table = getRssIndirection(sock);
+    for (std::uint32_t i = 0; i < table.size(); ++i)
+        table[i] = i % queues;
+    setRssIndirection(sock, table);
+    if (getRssIndirection(sock) != table)
+        throw std::runtime_error("RSS indirection table reads back differently");
+    spdlog::info("RSS on {} spreads {} table entries over {} queues", iface, table.size(), queues);
+}
@@ -0,0 +1,54 @@
+// Copyright (c) 2024 Lars-Christian Schulz
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// RSS settings of a NIC as found before they were changed
+struct RssSnapshot
+{
+    std::string iface;
+    std::uint64_t udp4Fields = 0;
+    std::uint64_t udp6Fields = 0;
+    std::vector<std::uint32_t> indirection;
+};
+
+// Read the UDP hash fields and the indirection table of iface. Throws if the
+// NIC does not report them.
+RssSnapshot saveRss(const std::string& iface);
+
+// Write back settings read by saveRss(). Throws if the NIC rejects them.
+void restoreRss(const RssSnapshot& snapshot);
+
+// Hash UDP over IPv4 and IPv6 on source and destination address and port, so
+// that the flows from different border routers and sockets land on different
+// receive queues. Throws if the NIC rejects the setting or does not report it
+// back.
+// This does not spread the traffic of a single border router: it sends all
+// packets from the same address and port to the same address and port, so
+// they form a single flow and hash to a single queue.
+void setUdpRssHash(const std::string& iface);
+
+// Spread the RSS indirection table of iface evenly over the first `queues`
+// receive queues. Throws if the table cannot be set or reads back differently.
+void setRssQueues(const std::string& iface, std::uint32_t queues);
@@ -0,0 +1,342 @@
+// Copyright (c) 2024 Lars-Christian Schulz
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// Runs the XDP filter in bpf/af_xdp.c on handcrafted packets with
+// BPF_PROG_TEST_RUN and checks the action and the counted decision. The maps
+// are not pinned, a running path manager is not affected. Requires root, e.g.
+//   xdp-filter-test bpf/af_xdp.c.o
+
+#include "ebpf.hpp"
+#include "bpf.h"
+#include "libbpf.h"
+
+#include <arpa/inet.h>
+#include <linux/bpf.h>
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+static constexpr std::uint32_t LOCAL_IP4 = 0x0a000001;  // 10.0.0.1
+static constexpr std::uint32_t OTHER_IP4 = 0x0a000002;
+static const std::array<std::uint8_t, 16> LOCAL_IP6 = {0xfd, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+static const std::array<std::uint8_t, 16> OTHER_IP6 = {0xfd, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2};
+static constexpr std::uint16_t SCION_PORT = 30041;
+static constexpr std::uint16_t OTHER_PORT = 30042;
+
+static constexpr std::uint16_t ETH_IP4 = 0x0800, ETH_IP6 = 0x86dd, ETH_ARP = 0x0806;
+static constexpr std::uint16_t ETH_8021Q = 0x8100, ETH_8021AD = 0x88a8;
+static constexpr std::uint8_t PROTO_HOPOPTS = 0, PROTO_ICMP = 1, PROTO_UDP = 17,
+    PROTO_FRAGMENT = 44, PROTO_ICMPV6 = 58, PROTO_DSTOPTS = 60;
+
+// Builds a packet header by header
+class Packet
+{
+private:
+    std::vector<std::uint8_t> buf;
+
+    void put8(std::uint8_t v) { buf.push_back(v); }
+    void put16(std::uint16_t v) { put8(v >> 8); put8(v & 0xff); }
+    void put32(std::uint32_t v) { put16(v >> 16); put16(v & 0xffff); }
+    void putBytes(const std::uint8_t* p, std::size_t n) { buf.insert(buf.end(), p, p + n); }
+    void pad(std::size_t n) { buf.insert(buf.end(), n, 0); }
+
+public:
+    Packet& eth(std::uint16_t proto)
+    {
+        pad(12);
+        put16(proto);
+        return *this;
+    }
+    Packet& vlan(std::uint16_t proto)
+    {
+        put16(100);
+        put16(proto);
+        return *this;
+    }
+    // `len` is the length of everything after the IPv4 header
+    Packet& ip4(std::uint32_t dst, std::uint8_t proto, std::uint16_t len, std::uint16_t frag = 0)
+    {
+        put8(0x45); put8(0); put16(20 + len);
+        put16(1); put16(frag); put8(64); put8(proto); put16(0);
+        put32(0x0a000063); put32(dst);
+        return *this;
+    }
+    Packet& ip6(const std::array<std::uint8_t, 16>& dst, std::uint8_t next, std::uint16_t len)
+    {
+        put32(0x60000000); put16(len); put8(next); put8(64);
+        pad(15); put8(0x63);
+        putBytes(dst.data(), dst.size());
+        return *this;
+    }
+    // Hop-by-hop, destination options and fragment headers are 8 bytes here
+    Packet& ext6(std::uint8_t next)
+    {
+        put8(next);
+        pad(7);
+        return *this;
+    }
+    Packet& frag6(std::uint8_t next, std::uint16_t frag)
+    {
+        put8(next); put8(0); put16(frag); put32(1);
+        return *this;
+    }
+    Packet& udp(std::uint16_t dst, std::uint16_t len)
+    {
+        put16(50000); put16(dst); put16(len); put16(0);
+        return *this;
+    }
+    // Common and address header with 4 byte host addresses and an empty path
+    Packet& scion(std::uint16_t payload, std::uint8_t version = 0, std::uint8_t hdrLen = 9)
+    {
+        put8(version << 4); put8(0); put16(0);
+        put8(PROTO_UDP); put8(hdrLen); put16(payload);
+        put8(0); put8(0); put16(0);
+        pad(16 + 4 + 4);
+        return *this;
+    }
+    Packet& payload(std::size_t n)
+    {
+        pad(n);
+        return *this;
+    }
+    std::vector<std::uint8_t>& data() { return buf; }
+};
+
+static constexpr std::uint16_t SCION_HDR = 12 + 16 + 4 + 4;
+static constexpr std::uint16_t PAYLOAD = 32;
+static constexpr std::uint16_t UDP_LEN = 8 + SCION_HDR + PAYLOAD;
+
+// Fragment fields, the offset is in units of 8 bytes
+static constexpr std::uint16_t IP4_MF = 0x2000, IP6_MF = 0x0001;
+static constexpr std::uint16_t ip4Offset(std::uint16_t bytes) { return bytes / 8; }
+static constexpr std::uint16_t ip6Offset(std::uint16_t bytes) { return bytes; }
+
+// A valid SCION packet after the IP header
+static Packet& scionUdp(Packet& p, std::uint16_t port = SCION_PORT)
+{
+    return p.udp(port, UDP_LEN).scion(PAYLOAD).payload(PAYLOAD);
+}
+
+struct Case
+{
+    const char* name;
+    Packet packet;
+    std::uint32_t action;
+    XdpDecision decision;
+};
+
+static std::vector<Case> cases()
+{
+    std::vector<Case> c;
+    auto add = [&](const char* name, Packet p, std::uint32_t action, XdpDecision decision) {
+        c.push_back({name, std::move(p), action, decision});
+    };
+    // No AF_XDP socket is bound, accepted SCION packets fall back to XDP_PASS
+    Packet p;
+    add("IPv4 SCION", std::move(scionUdp(p.eth(ETH_IP4).ip4(LOCAL_IP4, PROTO_UDP, UDP_LEN))),
+        XDP_PASS, XdpDecision::NoSocket);
+    p = {};
+    add("IPv6 SCION", std::move(scionUdp(p.eth(ETH_IP6).ip6(LOCAL_IP6, PROTO_UDP, UDP_LEN))),
+        XDP_PASS, XdpDecision::NoSocket);
+    p = {};
+    add("VLAN IPv6 SCION", std::move(scionUdp(
+        p.eth(ETH_8021Q).vlan(ETH_IP6).ip6(LOCAL_IP6, PROTO_UDP, UDP_LEN))),
+        XDP_PASS, XdpDecision::NoSocket);
+    p = {};
+    add("QinQ IPv4 SCION", std::move(scionUdp(
+        p.eth(ETH_8021AD).vlan(ETH_8021Q).vlan(ETH_IP4).ip4(LOCAL_IP4, PROTO_UDP, UDP_LEN))),
+        XDP_PASS, XdpDecision::NoSocket);
+    p = {};
+    add("IPv6 extension headers SCION", std::move(scionUdp(
+        p.eth(ETH_IP6).ip6(LOCAL_IP6, PROTO_HOPOPTS, 24 + UDP_LEN)
+        .ext6(PROTO_DSTOPTS).ext6(PROTO_FRAGMENT).ext6(PROTO_UDP))),
+        XDP_PASS, XdpDecision::NoSocket);
+    // The first fragment has the UDP header, but the lengths do not add up yet
+    p = {};
+    add("IPv4 first fragment", std::move(p.eth(ETH_IP4).ip4(LOCAL_IP4, PROTO_UDP, UDP_LEN - 16, IP4_MF)
+        .udp(SCION_PORT, UDP_LEN).scion(PAYLOAD).payload(PAYLOAD - 16)),
+        XDP_PASS, XdpDecision::NoSocket);
+    p = {};
+    add("IPv4 first fragment other port", std::move(
+        p.eth(ETH_IP4).ip4(LOCAL_IP4, PROTO_UDP, UDP_LEN - 16, IP4_MF)
+        .udp(OTHER_PORT, UDP_LEN).scion(PAYLOAD).payload(PAYLOAD - 16)),
+        XDP_PASS, XdpDecision::NotScion);
+    // A later fragment starts with payload that must not be read as UDP header
+    p = {};
+    add("IPv4 later fragment", std::move(
+        p.eth(ETH_IP4).ip4(LOCAL_IP4, PROTO_UDP, 16, ip4Offset(UDP_LEN - 16)).payload(16)),
+        XDP_PASS, XdpDecision::NoSocket);
+    p = {};
+    add("IPv6 first fragment", std::move(
+        p.eth(ETH_IP6).ip6(LOCAL_IP6, PROTO_FRAGMENT, 8 + UDP_LEN - 16).frag6(PROTO_UDP, IP6_MF)
+        .udp(SCION_PORT, UDP_LEN).scion(PAYLOAD).payload(PAYLOAD - 16)),
+        XDP_PASS, XdpDecision::NoSocket);
+    p = {};
+    add("IPv6 later fragment", std::move(
+        p.eth(ETH_IP6).ip6(LOCAL_IP6, PROTO_FRAGMENT, 8 + 16).frag6(PROTO_UDP, ip6Offset(UDP_LEN - 16))
+        .payload(16)),
+        XDP_PASS, XdpDecision::NoSocket);
+    p = {};
+    add("IPv6 truncated fragment header", std::move(
+        p.eth(ETH_IP6).ip6(LOCAL_IP6, PROTO_FRAGMENT, 4).payload(4)),
+        XDP_PASS, XdpDecision::Malformed);
+    p = {};
+    scionUdp(p.eth(ETH_IP4).ip4(LOCAL_IP4, PROTO_UDP, UDP_LEN));
+    p.data()[14] = 0x44;
+    add("IPv4 header length below 5", std::move(p), XDP_PASS, XdpDecision::Malformed);
+    p = {};
+    add("IPv4 ICMP", std::move(p.eth(ETH_IP4).ip4(LOCAL_IP4, PROTO_ICMP, 8).payload(8)),
+        XDP_PASS, XdpDecision::NoSocket);
+    p = {};
+    add("IPv6 ICMPv6", std::move(p.eth(ETH_IP6).ip6(LOCAL_IP6, PROTO_ICMPV6, 8).payload(8)),
+        XDP_PASS, XdpDecision::NoSocket);
+    p = {};
+    add("IPv6 with ICMP next header", std::move(p.eth(ETH_IP6).ip6(LOCAL_IP6, PROTO_ICMP, 8).payload(8)),
+        XDP_PASS, XdpDecision::NotScion);
+    p = {};
+    add("IPv4 other port", std::move(scionUdp(p.eth(ETH_IP4).ip4(LOCAL_IP4, PROTO_UDP, UDP_LEN), OTHER_PORT)),
+        XDP_PASS, XdpDecision::NotScion);
+    p = {};
+    add("IPv6 other port", std::move(scionUdp(p.eth(ETH_IP6).ip6(LOCAL_IP6, PROTO_UDP, UDP_LEN), OTHER_PORT)),
+        XDP_PASS, XdpDecision::NotScion);
+    p = {};
+    add("IPv4 other address", std::move(scionUdp(p.eth(ETH_IP4).ip4(OTHER_IP4, PROTO_UDP, UDP_LEN))),
+        XDP_PASS, XdpDecision::NotScion);
+    p = {};
+    add("IPv6 other address", std::move(scionUdp(p.eth(ETH_IP6).ip6(OTHER_IP6, PROTO_UDP, UDP_LEN))),
+        XDP_PASS, XdpDecision::NotScion);
+    p = {};
+    add("ARP", std::move(p.eth(ETH_ARP).payload(28)), XDP_PASS, XdpDecision::NotScion);
+    p = {};
+    add("truncated extension header", std::move(
+        p.eth(ETH_IP6).ip6(LOCAL_IP6, PROTO_HOPOPTS, 4).payload(4)),
+        XDP_PASS, XdpDecision::Malformed);
+    p = {};
+    add("SCION version 1", std::move(p.eth(ETH_IP6).ip6(LOCAL_IP6, PROTO_UDP, UDP_LEN)
+        .udp(SCION_PORT, UDP_LEN).scion(PAYLOAD, 1).payload(PAYLOAD)),
+        XDP_DROP, XdpDecision::Invalid);
+    p = {};
+    add("SCION header too short", std::move(p.eth(ETH_IP4).ip4(LOCAL_IP4, PROTO_UDP, UDP_LEN)
+        .udp(SCION_PORT, UDP_LEN).scion(PAYLOAD + 4, 0, 8).payload(PAYLOAD)),
+        XDP_DROP, XdpDecision::Invalid);
+    p = {};
+    add("SCION length mismatch", std::move(p.eth(ETH_IP4).ip4(LOCAL_IP4, PROTO_UDP, UDP_LEN)
+        .udp(SCION_PORT, UDP_LEN).scion(PAYLOAD + 1).payload(PAYLOAD)),
+        XDP_DROP, XdpDecision::Invalid);
+    p = {};
+    add("SCION truncated", std::move(p.eth(ETH_IP6).ip6(LOCAL_IP6, PROTO_UDP, UDP_LEN)
+        .udp(SCION_PORT, UDP_LEN).scion(PAYLOAD).payload(PAYLOAD / 2)),
+        XDP_DROP, XdpDecision::Invalid);
+    p = {};
+    add("SCION header cut off", std::move(p.eth(ETH_IP4).ip4(LOCAL_IP4, PROTO_UDP, UDP_LEN)
+        .udp(SCION_PORT, UDP_LEN).payload(8)),
+        XDP_DROP, XdpDecision::Invalid);
+    return c;
+}
+
+// Counters of queue 0 summed over all CPUs
+static XdpQueueStats readStats(int map)
+{
+    XdpQueueStats stats = {};
+    int ncpus = libbpf_num_possible_cpus();
+    std::vector<std::uint64_t> values(ncpus);
+    for (std::uint32_t key = 0; key < stats.size(); ++key) {
+        if (bpf_map_lookup_elem(map, &key, values.data()) != 0) continue;
+        for (auto v : values) stats[key] += v;
+    }
+    return stats;
+}
+
+static bool setupMaps(bpf_object* obj)
+{
+    std::uint32_t ip4 = htonl(LOCAL_IP4);
+    std::uint8_t one = 1;
+    std::uint32_t word = SCION_PORT / 64;
+    std::uint64_t bits = 1ull << (SCION_PORT % 64);
+    return bpf_map__update_elem(bpf_object__find_map_by_name(obj, "scion_ip4"),
+            &ip4, sizeof(ip4), &one, sizeof(one), BPF_ANY) == 0
+        && bpf_map__update_elem(bpf_object__find_map_by_name(obj, "scion_ip6"),
+            LOCAL_IP6.data(), LOCAL_IP6.size(), &one, sizeof(one), BPF_ANY) == 0
+        && bpf_map__update_elem(bpf_object__find_map_by_name(obj, "scion_ports"),
+            &word, sizeof(word), &bits, sizeof(bits), BPF_ANY) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* file = argc > 1 ? argv[1] : "bpf/af_xdp.c.o";
+
+    bpf_object* obj = bpf_object__open_file(file, nullptr);
+    if (!obj) {
+        std::fprintf(stderr, "cannot open %s\n", file);
+        return 1;
+    }
+    // Keep the maps of a running path manager in /sys/fs/bpf untouched
+    bpf_map* map = nullptr;
+    bpf_object__for_each_map(map, obj) {
+        bpf_map__set_pin_path(map, nullptr);
+    }
+    bpf_program* prog = bpf_object__find_program_by_name(obj, "scion_filter");
+    if (!prog) {
+        std::fprintf(stderr, "no program scion_filter in %s\n", file);
+        bpf_object__close(obj);
+        return 1;
+    }
+    bpf_program__set_type(prog, BPF_PROG_TYPE_XDP);
+    if (bpf_object__load(obj) != 0 || !setupMaps(obj)) {
+        std::fprintf(stderr, "cannot load %s\n", file);
+        bpf_object__close(obj);
+        return 1;
+    }
+    int progFd = bpf_program__fd(prog);
+    int statsFd = bpf_map__fd(bpf_object__find_map_by_name(obj, "xdp_stats"));
+
+    int failures = 0;
+    for (auto& c : cases()) {
+        auto before = readStats(statsFd);
+        auto& data = c.packet.data();
+        bpf_test_run_opts opts = {};
+        opts.sz = sizeof(opts);
+        opts.data_in = data.data();
+        opts.data_size_in = static_cast<std::uint32_t>(data.size());
+        if (bpf_prog_test_run_opts(progFd, &opts) != 0) {
+            std::fprintf(stderr, "%s: BPF_PROG_TEST_RUN failed\n", c.name);
+            ++failures;
+            continue;
+        }
+        auto after = readStats(statsFd);
+        bool counted = true;
+        for (std::size_t i = 0; i < after.size(); ++i) {
+            auto expected = before[i] + (i == static_cast<std::size_t>(c.decision) ? 1 : 0);
+            if (after[i] != expected) counted = false;
+        }
+        bool ok = opts.retval == c.action && counted;
+        std::printf("%-32s %s\n", c.name, ok ? "ok" : "FAILED");
+        if (!ok) {
+            std::fprintf(stderr, "%s: action %u (expected %u), decision %s\n", c.name, opts.retval,
+                c.action, counted ? "counted" : "miscounted");
+            ++failures;
+        }
+    }
+    bpf_object__close(obj);
+    return failures ? 1 : 0;
+}